@@ -17,104 +17,430 @@ along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "jcdp_audio_playback.h"
 #include "reaper_plugin_functions.h"
+#include <cmath>
+#include <limits>
 
-juce_audio_preview::juce_audio_preview(AudioFormatManager* afm) : m_format_manager(afm)
+extern std::unique_ptr<PropertiesFile> g_propsfile;
+
+void memory_audio_source::getNextAudioBlock(const AudioSourceChannelInfo& info)
 {
-    m_buffer.setSize(2,4096,false);
-    m_transport_source=new AudioTransportSource();
-    m_manager=jcdp::make_unique<AudioDeviceManager>();
-    m_manager->initialise(0,2,nullptr,true);
-    m_manager->addAudioCallback(this);
-    if (m_manager->getCurrentAudioDevice()!=nullptr)
+    const int64 len=m_buffer->getNumSamples();
+    const int numchans=info.buffer->getNumChannels();
+    int done=0;
+    while (done<info.numSamples)
     {
-        m_manager->getCurrentAudioDevice()->start(this);
+        int64 pos=m_pos;
+        if (m_looping==true && len>0)
+            pos%=len;
+        if (pos>=len)
+        {
+            info.buffer->clear(info.startSample+done,info.numSamples-done);
+            m_pos+=info.numSamples-done;
+            return;
+        }
+        int n=(int)jmin<int64>(info.numSamples-done,len-pos);
+        for (int i=0;i<numchans;++i)
+        {
+            if (i<m_buffer->getNumChannels())
+                info.buffer->copyFrom(i,info.startSample+done,*m_buffer,i,(int)pos,n);
+            else info.buffer->clear(i,info.startSample+done,n);
+        }
+        m_pos=pos+n;
+        done+=n;
     }
 }
 
-juce_audio_preview::~juce_audio_preview()
+int64 memory_audio_source::getNextReadPosition() const
 {
-    m_manager->removeAudioCallback(this);
-    delete m_transport_source;
-    if (m_audio_file.get_file()!=nullptr)
+    const int64 len=m_buffer->getNumSamples();
+    if (m_looping==true && len>0)
+        return m_pos % len;
+    return m_pos;
+}
+
+class juce_audio_preview::load_job : public ThreadPoolJob
+{
+public:
+    load_job(juce_audio_preview* owner, String fn, load_mode mode, int generation, int64 budget, channel_layout layout) :
+        ThreadPoolJob("preview load"), m_owner(owner), m_fn(fn), m_mode(mode), m_generation(generation),
+        m_budget(budget), m_layout(layout) {}
+    JobStatus runJob()
     {
-        String fn=m_audio_file.get_file()->getFullPathName();
-        m_audio_file.reset();
-		remove_file_if_exists(fn);
+        m_owner->load_file(m_fn,m_mode,m_generation,m_budget,m_layout,*this);
+        return jobHasFinished;
     }
+private:
+    juce_audio_preview* m_owner=nullptr;
+    String m_fn;
+    load_mode m_mode=load_mode::play;
+    int m_generation=0;
+    int64 m_budget=0;
+    channel_layout m_layout=channel_layout::automatic;
+};
+
+juce_audio_preview::juce_audio_preview(AudioFormatManager* afm) : m_format_manager(afm)
+{
+    // The audio device is opened when something is first played, see open_device
+    m_read_ahead_thread.startThread();
+    startTimer(100);
+}
+
+juce_audio_preview::~juce_audio_preview()
+{
+    stopTimer();
+    cancelPendingUpdate();
+    // The loads use this object, so they are waited for however long they take. They check
+    // shouldExit between chunks, so that is not long.
+    m_loader_pool.removeAllJobs(true,-1);
+    // After this the audio thread no longer runs the callback, so all states can be freed here
+    if (m_manager!=nullptr)
+        m_manager->removeAudioCallback(this);
+    delete m_current_state;
+    delete m_pending_state.exchange(nullptr);
+    delete m_retired_state.exchange(nullptr);
+    m_read_ahead_thread.stopThread(1000);
 }
 
 void juce_audio_preview::set_audio_file(String fn)
 {
-    juce_audio_file tempaudiofile(fn,m_format_manager);
-    if (tempaudiofile.get_source()!=nullptr)
+    start_load(fn,load_mode::play);
+}
+
+void juce_audio_preview::switch_audio_file(String fn)
+{
+    start_load(fn,load_mode::switch_file);
+}
+
+void juce_audio_preview::preload(String fn)
+{
+    start_load(fn,load_mode::preload);
+}
+
+void juce_audio_preview::release_preload(String fn)
+{
+    ScopedLock locker(m_decoded_files_mutex);
+    m_decoded_files.remove_if([&fn](const decoded_file& f) { return f.m_filename==fn; });
+}
+
+void juce_audio_preview::start_load(String fn, load_mode mode)
+{
+    int64 budget=512;
+    channel_layout layout=channel_layout::automatic;
+    if (g_propsfile!=nullptr)
     {
-        m_mutex.enter();
-        m_audio_file=std::move(tempaudiofile);
-        m_audio_file.get_source()->setLooping(true);
-        m_audio_file.get_source()->prepareToPlay(1024,44100.0);
-        m_transport_source->setSource(m_audio_file.get_source(), 0, nullptr, m_audio_file.get_reader()->sampleRate, 2);
-        m_transport_source->setLooping(true);
-        m_transport_source->prepareToPlay(1024,44100.0);
-        m_transport_source->start();
-        m_mutex.exit();
+        budget=g_propsfile->getIntValue("preview_ram_budget_mb",512);
+        if (g_propsfile->getBoolValue("preview_ambisonic_input",false)==true)
+            layout=channel_layout::ambisonic_foa;
     }
+    // Preloading doesn't supersede anything that is being loaded for playback
+    int generation=m_load_generation;
+    if (mode!=load_mode::preload)
+        generation=++m_load_generation;
+    m_loader_pool.addJob(new load_job(this,fn,mode,generation,budget*1024*1024,layout),true);
 }
 
-void juce_audio_preview::audioDeviceIOCallback(const float **, int, float **outputChannelData, int numOutputChannels, int numSamples)
+juce_audio_preview::decoded_file juce_audio_preview::find_decoded_file(const String& fn)
 {
-    ScopedLock locker(m_mutex);
-    if ((numOutputChannels!=2) || (m_audio_file.get_reader()==nullptr) || (m_is_playing==false))
+    ScopedLock locker(m_decoded_files_mutex);
+    for (auto it=m_decoded_files.begin();it!=m_decoded_files.end();++it)
     {
-        for (int i=0;i<numOutputChannels;++i)
-            for (int j=0;j<numSamples;++j)
-                outputChannelData[i][j]=0.0f;
+        if (it->m_filename==fn)
+        {
+            m_decoded_files.splice(m_decoded_files.begin(),m_decoded_files,it);
+            return m_decoded_files.front();
+        }
+    }
+    return decoded_file();
+}
+
+void juce_audio_preview::add_decoded_file(decoded_file file, int64 memory_budget)
+{
+    ScopedLock locker(m_decoded_files_mutex);
+    m_decoded_files.remove_if([&file](const decoded_file& f) { return f.m_filename==file.m_filename; });
+    m_decoded_files.push_front(file);
+    int64 used=0;
+    for (auto it=m_decoded_files.begin();it!=m_decoded_files.end();)
+    {
+        used+=(int64)it->m_buffer->getNumChannels()*it->m_buffer->getNumSamples()*sizeof(float);
+        // The newest one is always kept, it already passed the budget check on its own
+        if (used>memory_budget && it!=m_decoded_files.begin())
+            it=m_decoded_files.erase(it);
+        else ++it;
+    }
+}
+
+void juce_audio_preview::load_file(String fn, load_mode mode, int generation, int64 memory_budget, channel_layout layout, ThreadPoolJob& job)
+{
+    if (mode!=load_mode::preload && generation!=m_load_generation)
+        return;
+    auto state=jcdp::make_unique<juce_playback_state>();
+    decoded_file decoded=find_decoded_file(fn);
+    bool in_memory=decoded.m_buffer!=nullptr;
+    if (in_memory==false)
+    {
+        std::unique_ptr<AudioFormatReader> reader(m_format_manager->createReaderFor(File(fn)));
+        if (reader==nullptr)
+        {
+            Logger::writeToLog("Could not create audio file of "+fn);
+            return;
+        }
+        const int64 len=reader->lengthInSamples;
+        in_memory=len<std::numeric_limits<int>::max() && len*reader->numChannels*(int64)sizeof(float)<=memory_budget;
+        if (in_memory==true)
+        {
+            const int numchans=(int)reader->numChannels;
+            auto buf=std::make_shared<AudioSampleBuffer>(numchans,(int)len);
+            HeapBlock<int*> dest(numchans);
+            const int64 chunk=65536;
+            for (int64 pos=0;pos<len;pos+=chunk)
+            {
+                if (job.shouldExit()==true || (mode!=load_mode::preload && generation!=m_load_generation))
+                    return;
+                const int numsamples=(int)jmin(chunk,len-pos);
+                for (int ch=0;ch<numchans;++ch)
+                    dest[ch]=reinterpret_cast<int*>(buf->getWritePointer(ch,(int)pos));
+                // A file that couldn't be read isn't kept as decoded, so asking for it again tries again
+                if (reader->read(dest.get(),numchans,pos,numsamples,false)==false)
+                {
+                    Logger::writeToLog("Could not read audio file "+fn);
+                    return;
+                }
+                if (reader->usesFloatingPointData==false)
+                    for (int ch=0;ch<numchans;++ch)
+                        FloatVectorOperations::convertFixedToFloat(reinterpret_cast<float*>(dest[ch]),dest[ch],
+                                                                   1.0f/0x7fffffff,numsamples);
+            }
+            decoded.m_filename=fn;
+            decoded.m_buffer=buf;
+            decoded.m_samplerate=reader->sampleRate;
+            add_decoded_file(decoded,memory_budget);
+        }
+    }
+    if (mode==load_mode::preload)
         return;
+    if (in_memory==true)
+    {
+        state->m_num_channels=decoded.m_buffer->getNumChannels();
+        state->m_samplerate=decoded.m_samplerate;
+        state->m_memory_source=jcdp::make_unique<memory_audio_source>(decoded.m_buffer);
+        state->m_transport.setSource(state->m_memory_source.get(), 0, nullptr, state->m_samplerate, state->m_num_channels);
+    }
+    else
+    {
+        state->m_file=juce_audio_file(fn,m_format_manager);
+        if (state->m_file.get_source()==nullptr)
+            return;
+        state->m_num_channels=state->m_file.get_reader()->numChannels;
+        state->m_samplerate=state->m_file.get_reader()->sampleRate;
+        state->m_transport.setSource(state->m_file.get_source(), 65536, &m_read_ahead_thread, state->m_samplerate, state->m_num_channels);
     }
-    AudioSourceChannelInfo info(&m_buffer,0,numSamples);
-    m_transport_source->getNextAudioBlock(info);
-    if (m_audio_file.get_reader()->numChannels==1)
+    state->m_looped=m_looped;
+    state->m_transport.setLooping(state->m_looped);
+    state->m_layout=layout;
+    prepare_state(state.get());
+    state->m_transport.start();
+    state->m_follow_position=mode==load_mode::switch_file;
     {
-        for (int i=0;i<numSamples;++i)
+        ScopedLock locker(m_publish_mutex);
+        if (generation!=m_load_generation)
+            return;
+        // The device may have been opened meanwhile
+        if (state->m_prepared_samplerate!=m_device_sample_rate || state->m_prepared_block_size!=m_device_block_size
+                || state->m_mixer.get_num_outputs()!=m_device_num_outputs)
+            prepare_state(state.get());
+        // If the audio thread has not yet picked up the previously published state, it never will,
+        // so it can be deleted right here
+        delete m_pending_state.exchange(state.release());
+    }
+}
+
+void juce_audio_preview::prepare_state(juce_playback_state* state)
+{
+    state->m_transport.prepareToPlay(m_device_block_size,m_device_sample_rate);
+    state->m_buffer.setSize(state->m_num_channels,jmax(4096,(int)m_device_block_size),false,false,true);
+    if (state->m_mixer.get_num_outputs()!=m_device_num_outputs || state->m_mixer.get_num_inputs()!=state->m_num_channels)
+        state->m_mixer=channel_mixer::make_default(state->m_num_channels,m_device_num_outputs,state->m_layout);
+    state->m_prepared_samplerate=m_device_sample_rate;
+    state->m_prepared_block_size=m_device_block_size;
+}
+
+void juce_audio_preview::audioDeviceAboutToStart(AudioIODevice* device)
+{
+    // Callbacks are not running while this is called, so the current state can be reprepared.
+    // The loaders check the settings again when they publish, so they have to wait here.
+    ScopedLock locker(m_publish_mutex);
+    m_device_sample_rate=device->getCurrentSampleRate();
+    m_device_block_size=device->getCurrentBufferSizeSamples();
+    m_device_num_outputs=device->getActiveOutputChannels().countNumberOfSetBits();
+    if (m_current_state!=nullptr)
+        prepare_state(m_current_state);
+    // A file loaded before the device was opened
+    juce_playback_state* pending=m_pending_state.load();
+    if (pending!=nullptr)
+        prepare_state(pending);
+}
+
+void juce_audio_preview::open_device()
+{
+    // The device types expect to be set up and torn down on the message thread
+    jassert(MessageManager::getInstance()->isThisTheMessageThread());
+    double t0=Time::getMillisecondCounterHiRes();
+    std::unique_ptr<XmlElement> saved_state;
+    if (g_propsfile!=nullptr)
+        saved_state.reset(g_propsfile->getXmlValue("preview_audio_device"));
+    auto manager=jcdp::make_unique<AudioDeviceManager>();
+    String error=manager->initialise(0,2,saved_state.get(),true);
+    AudioIODevice* device=manager->getCurrentAudioDevice();
+    if (error.isEmpty()==true && saved_state==nullptr && device!=nullptr)
+    {
+        // Without saved settings, all the outputs the device has are used, and the mixer
+        // maps the files onto them
+        const int numoutputs=device->getOutputChannelNames().size();
+        if (numoutputs>device->getActiveOutputChannels().countNumberOfSetBits())
         {
-            outputChannelData[0][i]=info.buffer->getSample(0,i);
-            outputChannelData[1][i]=info.buffer->getSample(0,i);
+            AudioDeviceManager::AudioDeviceSetup setup;
+            manager->getAudioDeviceSetup(setup);
+            setup.outputChannels.clear();
+            setup.outputChannels.setRange(0,numoutputs,true);
+            setup.useDefaultOutputChannels=false;
+            error=manager->setAudioDeviceSetup(setup,true);
         }
     }
-    if (m_audio_file.get_reader()->numChannels==2)
+    if (error.isNotEmpty()==true)
+        Logger::writeToLog("Preview audio device error : "+error);
+    if (g_propsfile!=nullptr)
+    {
+        std::unique_ptr<XmlElement> device_state(manager->createStateXml());
+        if (device_state!=nullptr)
+            g_propsfile->setValue("preview_audio_device",device_state.get());
+    }
+    manager->addAudioCallback(this);
+    m_manager=std::move(manager);
+    m_device_open_ms=Time::getMillisecondCounterHiRes()-t0;
+}
+
+void juce_audio_preview::handleAsyncUpdate()
+{
+    if (m_manager==nullptr)
+        open_device();
+}
+
+void juce_audio_preview::timerCallback()
+{
+    delete m_retired_state.exchange(nullptr);
+    double first_audio_time=m_first_audio_time.exchange(0.0);
+    if (first_audio_time>0.0)
+    {
+        Logger::writeToLog("Preview audio device opened in "+String(m_device_open_ms,1)
+                           +" ms, first audio "+String(first_audio_time-m_play_requested_time,1)
+                           +" ms after starting playback");
+    }
+    int xruns=m_xrun_count;
+    if (xruns!=m_reported_xrun_count)
+    {
+        Logger::writeToLog("Preview playback xruns : "+String(xruns));
+        m_reported_xrun_count=xruns;
+    }
+}
+
+void juce_audio_preview::audioDeviceIOCallback(const float **, int, float **outputChannelData, int numOutputChannels, int numSamples)
+{
+    const int64 start_ticks=Time::getHighResolutionTicks();
+    // A new state is only taken when the retire slot is free, so that the replaced state
+    // always has somewhere to go. Only this thread stores non-null pointers into the slot.
+    if (m_pending_state.load()!=nullptr && m_retired_state.load()==nullptr)
     {
-        for (int i=0;i<numSamples;++i)
+        juce_playback_state* incoming=m_pending_state.exchange(nullptr);
+        if (incoming!=nullptr)
         {
-            outputChannelData[0][i]=info.buffer->getSample(0,i);
-            outputChannelData[1][i]=info.buffer->getSample(1,i);
+            if (incoming->m_follow_position==true && m_current_state!=nullptr)
+                incoming->m_transport.setPosition(m_current_state->m_transport.getCurrentPosition());
+            m_retired_state=m_current_state;
+            m_current_state=incoming;
         }
     }
+    juce_playback_state* state=m_current_state;
+    if (state==nullptr || m_is_playing==false)
+    {
+        for (int i=0;i<numOutputChannels;++i)
+            FloatVectorOperations::clear(outputChannelData[i],numSamples);
+        if (state!=nullptr)
+            m_playhead.publish({state->m_transport.getCurrentPosition(),Time::getMillisecondCounterHiRes(),
+                                state->m_transport.getLengthInSeconds(),false,state->m_looped});
+        return;
+    }
+    double seek_pos=m_seek_request.exchange(-1.0);
+    if (seek_pos>=0.0)
+    {
+        state->m_transport.setPosition(seek_pos);
+        if (state->m_transport.isPlaying()==false)
+            state->m_transport.start();
+    }
+    if (state->m_looped!=m_looped)
+    {
+        state->m_looped=m_looped;
+        state->m_transport.setLooping(state->m_looped);
+    }
+    state->m_transport.setGain(m_gain);
+    if (m_first_audio_pending==true)
+    {
+        m_first_audio_pending=false;
+        m_first_audio_time=Time::getMillisecondCounterHiRes();
+    }
+    const int bufsize=state->m_buffer.getNumSamples();
+    for (int pos=0;pos<numSamples;pos+=bufsize)
+        process_block(state,outputChannelData,numOutputChannels,pos,jmin(bufsize,numSamples-pos));
+    m_playhead.publish({state->m_transport.getCurrentPosition(),Time::getMillisecondCounterHiRes(),
+                        state->m_transport.getLengthInSeconds(),state->m_transport.isPlaying(),state->m_looped});
+    double elapsed=Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks()-start_ticks);
+    if (elapsed>numSamples/m_device_sample_rate)
+        ++m_xrun_count;
 }
 
-void juce_audio_preview::seek(double seconds)
+void juce_audio_preview::process_block(juce_playback_state* state, float** outputChannelData, int numOutputChannels,
+                                       int startSample, int numSamples)
 {
-    ScopedLock locker(m_mutex);
-    if (m_audio_file.get_reader()!=nullptr)
+    AudioSourceChannelInfo info(&state->m_buffer,0,numSamples);
+    state->m_transport.getNextAudioBlock(info);
+    const int max_outputs=64;
+    float* outputs[max_outputs];
+    for (int i=0;i<numOutputChannels;++i)
     {
-        m_transport_source->setPosition(seconds);
+        if (i<max_outputs)
+            outputs[i]=outputChannelData[i]+startSample;
+        else FloatVectorOperations::clear(outputChannelData[i]+startSample,numSamples);
     }
+    state->m_mixer.process(state->m_buffer.getArrayOfReadPointers(),state->m_buffer.getNumChannels(),
+                           outputs,jmin(numOutputChannels,max_outputs),numSamples);
+}
+
+void juce_audio_preview::seek(double seconds)
+{
+    m_seek_request=jmax(0.0,seconds);
+    m_playhead.publish_position(jmax(0.0,seconds),m_is_playing);
 }
 
 void juce_audio_preview::start()
 {
     m_is_playing=true;
+    if (m_device_requested==true)
+        return;
+    m_device_requested=true;
+    m_play_requested_time=Time::getMillisecondCounterHiRes();
+    // Opening the device can take hundreds of milliseconds, so the call that started playback
+    // returns first
+    triggerAsyncUpdate();
 }
 
 void juce_audio_preview::stop()
 {
     m_is_playing=false;
+    m_playhead.publish_position(get_position(),false);
 }
 
 void juce_audio_preview::set_volume(double gain)
 {
-    if (m_transport_source)
-    {
-        m_transport_source->setGain(gain);
-    }
+    m_gain=(float)gain;
 }
 
 reaper_audio_preview::reaper_audio_preview() : m_mutex(&m_prev_reg)
@@ -125,13 +451,14 @@ reaper_audio_preview::reaper_audio_preview() : m_mutex(&m_prev_reg)
     m_prev_reg.preview_track=nullptr;
     m_prev_reg.volume=1.0;
     m_prev_reg.src=nullptr;
+    startTimer(100);
 }
 
 reaper_audio_preview::~reaper_audio_preview()
 {
+    stopTimer();
     stop();
     delete m_src;
-    remove_file_if_exists(m_filename);
 }
 
 bool reaper_audio_preview::is_playing()
@@ -140,20 +467,72 @@ bool reaper_audio_preview::is_playing()
 }
 
 void reaper_audio_preview::set_audio_file(String fn)
+{
+    if (m_is_playing==false)
+        open_file(fn,swap_position::restart);
+    else if (g_propsfile!=nullptr && g_propsfile->getBoolValue("preview_proportional_swap",true)==false)
+        open_file(fn,swap_position::keep);
+    else open_file(fn,swap_position::proportional);
+}
+
+void reaper_audio_preview::switch_audio_file(String fn)
+{
+    open_file(fn,swap_position::keep);
+}
+
+void reaper_audio_preview::open_file(String fn, swap_position mode)
 {
     const char* foo=fn.toRawUTF8();
     PCM_source* temp=PCM_Source_CreateFromFile(foo);
-    if (temp!=nullptr)
+    if (temp==nullptr)
     {
-        m_mutex.lock();
-        PCM_source* old_src=m_src;
-        m_src=temp;
-        m_prev_reg.src=temp;
+        Logger::writeToLog("Could not create PCM_source");
+        return;
+    }
+    double fade_len=0.0;
+    if (m_is_playing==true && mode!=swap_position::restart)
+    {
+        fade_len=0.03;
+        if (g_propsfile!=nullptr)
+            fade_len=g_propsfile->getIntValue("preview_crossfade_ms",30)/1000.0;
+    }
+    const double new_len=temp->GetLength();
+    m_mutex.lock();
+    if (m_src==nullptr)
+    {
+        m_src=new crossfade_pcm_source(temp);
+        m_src->set_playhead(&m_playhead,m_looped);
+        m_prev_reg.src=m_src;
         m_prev_reg.curpos=0.0;
-        m_mutex.unlock();
-        delete old_src;
-        m_filename=fn;
-    } else Logger::writeToLog("Could not create PCM_source");
+    } else
+    {
+        double old_pos=m_prev_reg.curpos;
+        double new_pos=old_pos;
+        double old_len=m_src->GetLength();
+        if (mode==swap_position::restart)
+            new_pos=0.0;
+        else if (mode==swap_position::proportional && old_len>0.0)
+            new_pos=old_pos/old_len*new_len;
+        if (new_pos>=new_len)
+            new_pos=m_looped && new_len>0.0 ? std::fmod(new_pos,new_len) : new_len;
+        m_src->swap_source(temp,old_pos,new_pos,fade_len);
+        m_prev_reg.curpos=new_pos;
+    }
+    double pos=m_prev_reg.curpos;
+    m_mutex.unlock();
+    m_playhead.publish_waiting({pos,Time::getMillisecondCounterHiRes(),new_len,m_is_playing,m_looped});
+    m_filename=fn;
+}
+
+void reaper_audio_preview::timerCallback()
+{
+    std::vector<PCM_source*> finished;
+    m_mutex.lock();
+    if (m_src!=nullptr)
+        finished=m_src->take_finished_sources();
+    m_mutex.unlock();
+    for (auto e : finished)
+        delete e;
 }
 
 void reaper_audio_preview::set_volume(double gain)
@@ -169,6 +548,7 @@ void reaper_audio_preview::start()
         return;
     PlayPreviewEx(&m_prev_reg,1,-1.0);
     m_is_playing=true;
+    m_playhead.publish_position(m_playhead.read().m_position,true);
 }
 
 void reaper_audio_preview::stop()
@@ -177,6 +557,7 @@ void reaper_audio_preview::stop()
         return;
     StopPreview(&m_prev_reg);
     m_is_playing=false;
+    m_playhead.publish_position(get_position(),false);
 }
 
 void reaper_audio_preview::seek(double pos)
@@ -187,9 +568,10 @@ void reaper_audio_preview::seek(double pos)
         m_prev_reg.curpos=pos;
     }
     m_mutex.unlock();
+    m_playhead.publish_position(pos,m_is_playing);
 }
 
 double reaper_audio_preview::get_position()
 {
-    return m_prev_reg.curpos;
+    return m_playhead.get_position(Time::getMillisecondCounterHiRes());
 }
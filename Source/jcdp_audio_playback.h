@@ -19,8 +19,12 @@ along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
 #define JCDP_AUDIO_PLAYBACK_H
 
 #include <atomic>
+#include <list>
 #include <memory>
 #include "jcdp_utilities.h"
+#include "jcdp_channel_mixer.h"
+#include "jcdp_crossfade_source.h"
+#include "jcdp_playhead.h"
 #include "reaper_plugin.h"
 
 #ifndef WIN32
@@ -89,10 +93,20 @@ public:
     virtual void set_volume(double gain)=0;
 	virtual bool is_looped() = 0;
 	virtual void set_looped(bool b) = 0;
+    // Replaces the file keeping the playback position, for comparing renders
+    virtual void switch_audio_file(String fn) { set_audio_file(fn); }
+    // Hints that the file is likely to be played soon, and that it no longer is
+    virtual void preload(String) {}
+    virtual void release_preload(String) {}
 	std::function<void(void)> OnFileEnd;
+protected:
+    // Published from the audio thread, get_position() extrapolates from it
+    playhead_publisher m_playhead;
 };
 
-class reaper_audio_preview : public IJCDPreviewPlayback
+// Plays files through REAPER's preview API. New files are swapped in through a
+// crossfade_pcm_source, so that renders arriving during playback don't restart it.
+class reaper_audio_preview : public IJCDPreviewPlayback, public Timer
 {
 public:
     reaper_audio_preview();
@@ -103,6 +117,7 @@ public:
     void seek(double);
     double get_position();
     void set_audio_file(String);
+    void switch_audio_file(String);
     void set_volume(double gain);
 	bool is_looped() { return m_looped; }
 	void set_looped(bool b) 
@@ -110,12 +125,22 @@ public:
 		m_mutex.lock();
 		m_looped = b;
 		m_prev_reg.loop = b;
+		if (m_src != nullptr)
+			m_src->set_playhead(&m_playhead, b);
 		m_mutex.unlock();
 	}
-	
+    void timerCallback();
 private:
+    enum class swap_position
+    {
+        restart,
+        keep,
+        // Keeps the same relative position when the length of the file changed
+        proportional
+    };
+    void open_file(String fn, swap_position mode);
 	bool m_looped = true;
-	PCM_source* m_src=nullptr;
+	crossfade_pcm_source* m_src=nullptr;
     preview_register_t m_prev_reg;
     jcdp_mutex m_mutex;
     std::atomic<bool> m_is_playing={false};
@@ -175,42 +200,142 @@ private:
     AudioFormatReaderSource* m_source=nullptr;
 };
 
-class juce_audio_preview : public IJCDPreviewPlayback, public AudioIODeviceCallback
+// Plays back audio that has been decoded into memory. The buffer is shared, so that the same
+// decoded audio can be handed to several sources without copying it.
+class memory_audio_source : public PositionableAudioSource
+{
+public:
+    memory_audio_source(std::shared_ptr<const AudioSampleBuffer> buf) : m_buffer(buf) {}
+    void prepareToPlay(int, double) {}
+    void releaseResources() {}
+    void getNextAudioBlock(const AudioSourceChannelInfo& info);
+    void setNextReadPosition(int64 pos) { m_pos=pos; }
+    int64 getNextReadPosition() const;
+    int64 getTotalLength() const { return m_buffer->getNumSamples(); }
+    bool isLooping() const { return m_looping; }
+    void setLooping(bool b) { m_looping=b; }
+    const std::shared_ptr<const AudioSampleBuffer>& get_buffer() const { return m_buffer; }
+private:
+    std::shared_ptr<const AudioSampleBuffer> m_buffer;
+    int64 m_pos=0;
+    bool m_looping=true;
+};
+
+// Everything the audio callback needs to play one file. A state is fully loaded and prepared
+// on the loader thread and then handed to the audio thread, which owns it until it is
+// retired back to the message thread for deletion.
+struct juce_playback_state
+{
+    // Files that fit in the memory budget are decoded into m_memory_source, larger
+    // ones are streamed from m_file with read-ahead
+    std::unique_ptr<memory_audio_source> m_memory_source;
+    juce_audio_file m_file;
+    int m_num_channels=0;
+    double m_samplerate=0.0;
+    AudioTransportSource m_transport;
+    bool m_looped=true;
+    // Holds one block of all the file's channels before they are mapped to the outputs
+    AudioSampleBuffer m_buffer;
+    channel_layout m_layout=channel_layout::automatic;
+    channel_mixer m_mixer;
+    // Continue from where the replaced state was playing
+    bool m_follow_position=false;
+    // The device settings the state was prepared for
+    double m_prepared_samplerate=0.0;
+    int m_prepared_block_size=0;
+};
+
+// Plays files through JUCE's own audio device. The audio callback never takes a lock or
+// frees memory : new files are published through an atomic pointer, seek/gain/loop changes
+// through atomics, and replaced states are deleted from a timer on the message thread.
+class juce_audio_preview : public IJCDPreviewPlayback, public AudioIODeviceCallback, public Timer,
+                           public AsyncUpdater
 {
 public:
     juce_audio_preview(AudioFormatManager* afm);
     ~juce_audio_preview();
+    // Loads the file on a background thread. The currently playing file keeps playing until
+    // the new one is ready.
     void set_audio_file(String fn);
+    // As above, but the new file starts at the position the old one had reached when the
+    // switch happens on the audio thread
+    void switch_audio_file(String fn);
+    // Decodes the file into memory ahead of time, so that later switching to it is instant.
+    // The decoded files are kept within the memory budget, least recently used going first.
+    void preload(String fn);
+    void release_preload(String fn);
 
     void audioDeviceIOCallback(const float** inputChannelData,
                                int numInputChannels,
                                float** outputChannelData,
                                int numOutputChannels,
                                int numSamples);
-    void audioDeviceAboutToStart(AudioIODevice*) { }
+    void audioDeviceAboutToStart(AudioIODevice* device);
     void audioDeviceStopped() { }
+    void timerCallback();
+    // Opens the device requested by start
+    void handleAsyncUpdate();
     void seek(double seconds);
-    double get_position() { return m_transport_source->getCurrentPosition(); }
+    double get_position() { return m_playhead.get_position(Time::getMillisecondCounterHiRes()); }
     bool is_playing() { return m_is_playing; }
     void start();
     void stop();
     void set_volume(double gain);
 	bool is_looped() { return m_looped; }
-	void set_looped(bool b)
-	{
-		m_mutex.enter();
-		m_looped = b;
-		m_mutex.exit();
-	}
+	void set_looped(bool b) { m_looped = b; }
+    // Number of callbacks that took longer than the duration of the buffer they produced
+    int get_xrun_count() const { return m_xrun_count; }
 private:
-	bool m_looped = true;
-	AudioTransportSource* m_transport_source=nullptr;
-    AudioSampleBuffer m_buffer;
-    CriticalSection m_mutex;
+    class load_job;
+    enum class load_mode { play, switch_file, preload };
+    struct decoded_file
+    {
+        String m_filename;
+        std::shared_ptr<const AudioSampleBuffer> m_buffer;
+        double m_samplerate=0.0;
+    };
+    void open_device();
+    // Prepares the state for the current device settings
+    void prepare_state(juce_playback_state* state);
+    void start_load(String fn, load_mode mode);
+    void load_file(String fn, load_mode mode, int generation, int64 memory_budget, channel_layout layout, ThreadPoolJob& job);
+    decoded_file find_decoded_file(const String& fn);
+    void add_decoded_file(decoded_file file, int64 memory_budget);
+    void process_block(juce_playback_state* state, float** outputChannelData, int numOutputChannels,
+                       int startSample, int numSamples);
+    std::atomic<bool> m_looped={true};
+    std::atomic<float> m_gain={1.0f};
+    std::atomic<double> m_seek_request={-1.0};
     std::atomic<bool> m_is_playing={false};
+    std::atomic<int> m_xrun_count={0};
+    int m_reported_xrun_count=0;
+    std::atomic<double> m_device_sample_rate={44100.0};
+    std::atomic<int> m_device_block_size={1024};
+    std::atomic<int> m_device_num_outputs={2};
+    // Published by the message thread, taken by the audio thread
+    std::atomic<juce_playback_state*> m_pending_state={nullptr};
+    // Handed back by the audio thread, deleted by the message thread
+    std::atomic<juce_playback_state*> m_retired_state={nullptr};
+    // Only touched by the audio thread while the device is running
+    juce_playback_state* m_current_state=nullptr;
     AudioFormatManager* m_format_manager=nullptr;
+    // Created by open_device on the message thread, the first time playback is started
     std::unique_ptr<AudioDeviceManager> m_manager;
-    juce_audio_file m_audio_file;
+    bool m_device_requested=false;
+    double m_device_open_ms=0.0;
+    double m_play_requested_time=0.0;
+    // Set by the audio thread when it first produces audio
+    std::atomic<bool> m_first_audio_pending={true};
+    std::atomic<double> m_first_audio_time={0.0};
+    // Bumped for every requested file, so that loads which have been superseded can give up
+    std::atomic<int> m_load_generation={0};
+    // Makes checking the generation and publishing the state atomic between the loader threads
+    CriticalSection m_publish_mutex;
+    // Most recently used first
+    std::list<decoded_file> m_decoded_files;
+    CriticalSection m_decoded_files_mutex;
+    ThreadPool m_loader_pool{2};
+    TimeSliceThread m_read_ahead_thread{"CDP preview read-ahead"};
 };
 
 #endif // JCDP_AUDIO_PLAYBACK_H
@@ -0,0 +1,322 @@
+/*
+This file is part of CDP Front-end.
+
+CDP front-end is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+CDP front-end is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "jcdp_batch_render.h"
+#include "jcdp_main_dialog.h"
+#include "jcdp_plugin_render.h"
+#include "reaper_plugin_functions.h"
+
+#undef min
+#undef max
+
+extern std::unique_ptr<PropertiesFile> g_propsfile;
+
+String batch_renderer::batch_progress::to_string() const
+{
+    String result=String::formatted("Batch : %d/%d done",m_finished,m_total);
+    if (m_rendering>0)
+        result+=String::formatted(", %d rendering",m_rendering);
+    if (m_failed>0)
+        result+=String::formatted(", %d failed",m_failed);
+    result+=String::formatted(", %.1f items/s, %.1fx realtime",m_items_per_second,m_realtime_factor);
+    return result;
+}
+
+batch_renderer::batch_renderer()
+{
+}
+
+batch_renderer::~batch_renderer()
+{
+    stopTimer();
+    m_cancelled=true;
+    // Doesn't wait for the running renders, their results aren't delivered anymore
+    m_engine=nullptr;
+    for (auto& e : m_items)
+        if (e.m_state==item_state::rendered)
+            remove_file_if_exists(e.m_out_fn);
+}
+
+bool batch_renderer::start(const std::vector<MediaItem_Take*>& takes, const cdp_render_request& request_template)
+{
+    if (m_running==true)
+        return false;
+    // All the renders of the previous batch have been delivered by now
+    m_engine=nullptr;
+    m_items.clear();
+    for (auto take : takes)
+    {
+        if (take==nullptr)
+            continue;
+        batch_item item;
+        item.m_take=take;
+        item.m_item=GetMediaItemTake_Item(take);
+        char* takename=static_cast<char*>(GetSetMediaItemTakeInfo(take,"P_NAME",nullptr));
+        if (takename!=nullptr)
+            item.m_name=String(takename);
+        m_items.push_back(item);
+    }
+    if (m_items.empty()==true)
+        return false;
+    m_request_template=request_template;
+    m_cancelled=false;
+    m_next_export=0;
+    m_next_insert=0;
+    m_rendered_seconds=0.0;
+    m_max_jobs=g_propsfile->getIntValue("batch_max_jobs",0);
+    if (m_max_jobs<=0)
+        m_max_jobs=SystemStats::getNumCpus();
+    m_engine=jcdp::make_unique<cdp_render_engine>(m_max_jobs);
+    m_start_time=Time::getMillisecondCounterHiRes();
+    m_running=true;
+    Logger::writeToLog(String::formatted("Starting batch render of %d items with %d jobs",(int)m_items.size(),m_max_jobs));
+    startTimer(50);
+    return true;
+}
+
+void batch_renderer::cancel_all()
+{
+    if (m_running==false)
+        return;
+    m_cancelled=true;
+    Logger::writeToLog("Cancelling batch render");
+}
+
+batch_renderer::batch_progress batch_renderer::get_progress() const
+{
+    batch_progress result;
+    result.m_running=m_running;
+    result.m_total=(int)m_items.size();
+    ScopedLock locker(m_cs);
+    int succeeded=0;
+    for (auto& e : m_items)
+    {
+        if (e.m_state==item_state::rendering)
+            ++result.m_rendering;
+        if (e.m_state==item_state::rendered || e.m_state==item_state::inserted)
+            ++succeeded;
+        if (e.m_state==item_state::failed)
+            ++result.m_failed;
+        if (e.m_state==item_state::failed || e.m_state==item_state::cancelled)
+            ++result.m_finished;
+    }
+    result.m_finished+=succeeded;
+    double elapsed=(Time::getMillisecondCounterHiRes()-m_start_time)/1000.0;
+    if (elapsed>0.0)
+    {
+        result.m_items_per_second=succeeded/elapsed;
+        result.m_realtime_factor=m_rendered_seconds/elapsed;
+    }
+    return result;
+}
+
+batch_renderer::item_state batch_renderer::get_item_state(int index) const
+{
+    ScopedLock locker(m_cs);
+    if (index>=0 && index<m_items.size())
+        return m_items[index].m_state;
+    return item_state::failed;
+}
+
+void batch_renderer::set_item_state(int index, item_state state, String message)
+{
+    ScopedLock locker(m_cs);
+    m_items[index].m_state=state;
+    m_items[index].m_message=message;
+}
+
+void batch_renderer::on_item_rendered(int index, const cdp_render_result& result)
+{
+    if (result.ok()==false)
+    {
+        if (result.m_cancelled==true || m_cancelled==true)
+            set_item_state(index,item_state::cancelled);
+        else
+            set_item_state(index,item_state::failed,result.m_error);
+        return;
+    }
+    ScopedLock locker(m_cs);
+    m_items[index].m_out_fn=result.m_output_file;
+    m_items[index].m_state=item_state::rendered;
+    m_rendered_seconds+=m_items[index].m_length;
+}
+
+void batch_renderer::export_next_item()
+{
+    if (m_next_export>=m_items.size())
+        return;
+    if (m_cancelled==true)
+    {
+        for (;m_next_export<m_items.size();++m_next_export)
+            set_item_state(m_next_export,item_state::cancelled);
+        return;
+    }
+    int in_flight=0;
+    {
+        ScopedLock locker(m_cs);
+        for (auto& e : m_items)
+            if (e.m_state==item_state::rendering)
+                ++in_flight;
+    }
+    // Enough exported to keep all the jobs busy
+    if (in_flight>=2*m_max_jobs)
+        return;
+    int index=m_next_export++;
+    MediaItem_Take* take=m_items[index].m_take;
+    if (ValidatePtr(take,"MediaItem_Take*")==false)
+    {
+        set_item_state(index,item_state::failed,"Take was removed");
+        return;
+    }
+    double pregain=exp(m_request_template.m_processor.m_parameters[0].m_current_value*0.11512925464970228420089957273422);
+    auto preprocresult=pre_process_file_with_reaper_api(take,time_range(),pregain,false);
+    if (preprocresult.first.isEmpty()==true)
+    {
+        set_item_state(index,item_state::failed,"REAPER AudioAccessor processing failed");
+        return;
+    }
+    double len=get_audio_source_info(preprocresult.first).get_length_seconds();
+    {
+        ScopedLock locker(m_cs);
+        m_items[index].m_in_fn=preprocresult.first;
+        m_items[index].m_length=len;
+        m_items[index].m_state=item_state::rendering;
+    }
+    cdp_render_request request=m_request_template;
+    request.m_input_file=preprocresult.first;
+    request.m_cut_input=false;
+    request.m_apply_pre_volume=false;
+#ifdef CDP_VST_ENABLED
+    if (request.m_processor.m_main_program=="vstplugin")
+    {
+        // The renders run in parallel, so each gets its own instance of the plugin
+        String error;
+        request.m_plugin_instance=create_render_plugin_instance(request.m_plugin_description,
+                                                                request.m_plugin_state,error);
+        if (request.m_plugin_instance==nullptr)
+        {
+            set_item_state(index,item_state::failed,error);
+            return;
+        }
+    }
+#endif
+    m_engine->submit(std::move(request),[this]() { return m_cancelled.load(); },
+                     [this,index](const cdp_render_result& result) { on_item_rendered(index,result); });
+}
+
+void batch_renderer::insert_finished_items()
+{
+    while (m_next_insert<m_items.size())
+    {
+        item_state state=get_item_state(m_next_insert);
+        if (state==item_state::waiting || state==item_state::rendering)
+            break;
+        if (state==item_state::rendered)
+        {
+            if (m_cancelled==true)
+            {
+                remove_file_if_exists(m_items[m_next_insert].m_out_fn);
+                set_item_state(m_next_insert,item_state::cancelled);
+            }
+            else
+                insert_item(m_items[m_next_insert]);
+        }
+        ++m_next_insert;
+    }
+}
+
+void batch_renderer::insert_item(batch_item& item)
+{
+    String outfilename=get_audio_render_path()+"/";
+    if (item.m_name.isNotEmpty())
+        outfilename+=item.m_name+"-";
+    outfilename+=String(Time::currentTimeMillis())+"_"+String(m_next_insert)+".wav";
+    int index=m_next_insert;
+    if (File(item.m_out_fn).moveFileTo(File(outfilename))==false)
+    {
+        remove_file_if_exists(item.m_out_fn);
+        set_item_state(index,item_state::failed,"Could not move processed file to destination");
+        return;
+    }
+    if (g_propsfile->getBoolValue("addrenderednewtake",true)==true)
+    {
+        if (ValidatePtr(item.m_item,"MediaItem*")==false)
+        {
+            set_item_state(index,item_state::failed,"Item was removed, file rendered to : "+outfilename);
+            return;
+        }
+        PCM_source* src=PCM_Source_CreateFromFile(outfilename.toRawUTF8());
+        if (src==nullptr)
+        {
+            set_item_state(index,item_state::failed,"REAPER could not open "+outfilename);
+            return;
+        }
+        MediaItem_Take* take=AddTakeToMediaItem(item.m_item);
+        GetSetMediaItemTakeInfo(take,"P_SOURCE",src);
+        SetActiveTake(take);
+        if (m_request_template.m_processor.m_changes_duration==true && g_propsfile->getBoolValue("adjustitemlength",true)==true)
+            SetMediaItemInfo_Value(item.m_item,"D_LENGTH",src->GetLength());
+        UpdateArrange();
+    }
+    set_item_state(index,item_state::inserted,outfilename);
+}
+
+void batch_renderer::finish()
+{
+    stopTimer();
+    m_running=false;
+    bool any_inserted=false;
+    for (auto& e : m_items)
+        if (e.m_state==item_state::inserted)
+            any_inserted=true;
+    if (any_inserted==true && g_propsfile->getBoolValue("addrenderednewtake",true)==true)
+        Undo_OnStateChange("CDP batch render");
+    auto progress=get_progress();
+    Logger::writeToLog(progress.to_string());
+    if (OnFinished)
+        OnFinished(progress);
+}
+
+void batch_renderer::timerCallback()
+{
+    export_next_item();
+    insert_finished_items();
+    std::vector<std::tuple<int,item_state,String>> changes;
+    {
+        ScopedLock locker(m_cs);
+        for (int i=0;i<m_items.size();++i)
+        {
+            batch_item& item=m_items[i];
+            if (item.m_state!=item.m_reported_state)
+            {
+                item.m_reported_state=item.m_state;
+                changes.emplace_back(i,item.m_state,item.m_message);
+            }
+        }
+    }
+    for (auto& e : changes)
+    {
+        if (std::get<1>(e)==item_state::failed)
+            Logger::writeToLog("Batch item "+String(std::get<0>(e)+1)+" failed : "+std::get<2>(e));
+        if (OnItemStateChanged)
+            OnItemStateChanged(std::get<0>(e),std::get<1>(e),std::get<2>(e));
+    }
+    if (OnProgress)
+        OnProgress(get_progress());
+    if (m_next_insert>=m_items.size())
+        finish();
+}
@@ -0,0 +1,109 @@
+/*
+This file is part of CDP Front-end.
+
+CDP front-end is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+CDP front-end is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef JCDP_BATCH_RENDER_H
+#define JCDP_BATCH_RENDER_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <tuple>
+#include <vector>
+#include "JuceHeader.h"
+#include "jcdp_processor.h"
+#include "jcdp_render_engine.h"
+
+class MediaItem;
+class MediaItem_Take;
+
+// Renders many REAPER takes with the same processor settings. The takes are exported on the
+// message thread, as REAPER's AudioAccessors can't be used from other threads, a few at a
+// time so that the exports stay ahead of the rendering without filling the disk. The CDP or
+// plugin processing runs on a render engine with a thread per CPU, and the results are inserted
+// as new takes in the order the takes were given in.
+class batch_renderer : public Timer
+{
+public:
+    enum class item_state
+    {
+        waiting,
+        rendering,
+        rendered,
+        inserted,
+        failed,
+        cancelled
+    };
+    struct batch_progress
+    {
+        int m_total=0;
+        int m_rendering=0;
+        int m_finished=0;
+        int m_failed=0;
+        double m_items_per_second=0.0;
+        // Seconds of audio rendered per second
+        double m_realtime_factor=0.0;
+        bool m_running=false;
+        String to_string() const;
+    };
+    batch_renderer();
+    ~batch_renderer();
+    // The request is copied, so the processor can be edited while the batch runs. The input
+    // of the request is replaced by each take. Returns false if a batch is already running.
+    bool start(const std::vector<MediaItem_Take*>& takes, const cdp_render_request& request_template);
+    // Renders already running are let to finish, but nothing of the batch is inserted after this
+    void cancel_all();
+    bool is_running() const { return m_running; }
+    batch_progress get_progress() const;
+    item_state get_item_state(int index) const;
+    // These are called on the message thread
+    std::function<void(int, item_state, const String&)> OnItemStateChanged;
+    std::function<void(const batch_progress&)> OnProgress;
+    std::function<void(const batch_progress&)> OnFinished;
+    void timerCallback();
+private:
+    struct batch_item
+    {
+        MediaItem* m_item=nullptr;
+        MediaItem_Take* m_take=nullptr;
+        String m_name;
+        item_state m_state=item_state::waiting;
+        item_state m_reported_state=item_state::waiting;
+        String m_in_fn;
+        String m_out_fn;
+        String m_message;
+        double m_length=0.0;
+    };
+    void on_item_rendered(int index, const cdp_render_result& result);
+    void set_item_state(int index, item_state state, String message=String());
+    void export_next_item();
+    void insert_finished_items();
+    void insert_item(batch_item& item);
+    void finish();
+    mutable CriticalSection m_cs;
+    std::vector<batch_item> m_items;
+    cdp_render_request m_request_template;
+    std::atomic<bool> m_cancelled{false};
+    bool m_running=false;
+    int m_next_export=0;
+    int m_next_insert=0;
+    int m_max_jobs=1;
+    double m_start_time=0.0;
+    double m_rendered_seconds=0.0;
+    std::unique_ptr<cdp_render_engine> m_engine;
+};
+
+#endif // JCDP_BATCH_RENDER_H
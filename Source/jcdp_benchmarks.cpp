@@ -0,0 +1,254 @@
+/*
+This file is part of CDP Front-end.
+
+CDP front-end is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+CDP front-end is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "jcdp_benchmarks.h"
+#include "jcdp_thumbnail.h"
+#include "jcdp_envelope.h"
+#include "jcdp_breakpoints.h"
+
+extern std::unique_ptr<AudioFormatManager> g_format_manager;
+
+static const int c_benchmark_timeout=600000;
+
+void benchmark_thumbnail_generation(String fn)
+{
+    if (File(fn).existsAsFile()==false)
+    {
+        Logger::writeToLog("Thumbnail benchmark : no input file");
+        return;
+    }
+    Logger::writeToLog("Thumbnail benchmark : "+fn+", "+String(SystemStats::getNumCpus())+" CPUs");
+    // Read the file through once, so that all the runs below find it in the OS file cache
+    // and the first one isn't slowed down by the disk. None of them use a thumbnail cache.
+    {
+        std::unique_ptr<FileInputStream> stream(File(fn).createInputStream());
+        HeapBlock<char> buf(1<<20);
+        while (stream!=nullptr && stream->read(buf.get(),1<<20)>0) {}
+    }
+    double stock_time=0.0;
+    {
+        AudioThumbnailCache cache(1);
+        AudioThumbnail thumb(chunked_thumbnail::c_samples_per_block,*g_format_manager,cache);
+        double t0=Time::getMillisecondCounterHiRes();
+        thumb.setSource(new FileInputSource(File(fn)));
+        while (thumb.isFullyLoaded()==false && Time::getMillisecondCounterHiRes()-t0<c_benchmark_timeout)
+            Thread::sleep(1);
+        stock_time=Time::getMillisecondCounterHiRes()-t0;
+        Logger::writeToLog(String::formatted("\tAudioThumbnail : %.1f ms",stock_time));
+    }
+    for (int numthreads : {1,4,16})
+    {
+        ThreadPool pool(numthreads);
+        double t0=Time::getMillisecondCounterHiRes();
+        chunked_thumbnail thumb(fn,&pool);
+        thumb.wait_until_loaded(c_benchmark_timeout);
+        double elapsed=Time::getMillisecondCounterHiRes()-t0;
+        Logger::writeToLog(String::formatted("\tchunked_thumbnail, %d threads : %.1f ms (%.2fx)",
+                                             numthreads,elapsed,stock_time/elapsed));
+    }
+}
+
+void benchmark_envelope_evaluation()
+{
+    const int numnodes=1000;
+    const int numpoints=1000000;
+    Random rnd(1);
+    breakpoint_envelope env("benchmark");
+    env.BeginUpdate();
+    for (int i=0;i<numnodes;++i)
+        env.AddNode(envelope_node(rnd.nextDouble(),rnd.nextDouble(),rnd.nextDouble()));
+    env.EndUpdate();
+    const double dt=1.0/numpoints;
+    std::vector<float> point_values(numpoints);
+    std::vector<float> block_values(numpoints);
+    double t0=Time::getMillisecondCounterHiRes();
+    for (int i=0;i<numpoints;++i)
+        point_values[i]=env.GetInterpolatedNodeValue(dt*i);
+    const double point_time=Time::getMillisecondCounterHiRes()-t0;
+    t0=Time::getMillisecondCounterHiRes();
+    env.evaluate_block(0.0,dt,block_values.data(),numpoints);
+    const double block_time=Time::getMillisecondCounterHiRes()-t0;
+    float maxerror=0.0f;
+    for (int i=0;i<numpoints;++i)
+        maxerror=std::max(maxerror,std::abs(point_values[i]-block_values[i]));
+    Logger::writeToLog(String::formatted("Envelope evaluation benchmark : %d nodes, %d points",numnodes,numpoints));
+    Logger::writeToLog(String::formatted("\tGetInterpolatedNodeValue : %.1f ms",point_time));
+    Logger::writeToLog(String::formatted("\tevaluate_block : %.1f ms (%.2fx), max error %g",
+                                         block_time,point_time/block_time,maxerror));
+}
+
+void benchmark_envelope_editing()
+{
+    const int numnodes=100000;
+    const int numedits=1000;
+    Random rnd(1);
+    nodes_t nodes;
+    for (int i=0;i<numnodes;++i)
+        nodes.push_back(envelope_node(rnd.nextDouble(),rnd.nextDouble()));
+    Logger::writeToLog(String::formatted("Envelope editing benchmark : %d nodes",numnodes));
+    breakpoint_envelope env("benchmark");
+    double t0=Time::getMillisecondCounterHiRes();
+    env.insert_nodes(nodes);
+    Logger::writeToLog(String::formatted("\tinsert_nodes, %d nodes : %.1f ms",
+                                         numnodes,Time::getMillisecondCounterHiRes()-t0));
+    // The previous way of adding a node, appending and sorting all the nodes
+    t0=Time::getMillisecondCounterHiRes();
+    for (int i=0;i<numedits;++i)
+    {
+        env.BeginUpdate();
+        env.AddNode(envelope_node(rnd.nextDouble(),rnd.nextDouble()));
+        env.EndUpdate();
+    }
+    Logger::writeToLog(String::formatted("\tAddNode and sort, %d nodes : %.1f ms",
+                                         numedits,Time::getMillisecondCounterHiRes()-t0));
+    t0=Time::getMillisecondCounterHiRes();
+    for (int i=0;i<numedits;++i)
+        env.AddNode(envelope_node(rnd.nextDouble(),rnd.nextDouble()));
+    Logger::writeToLog(String::formatted("\tSorted AddNode, %d nodes : %.1f ms",
+                                         numedits,Time::getMillisecondCounterHiRes()-t0));
+    // Drag a node in small steps across the middle of the envelope
+    int index=env.GetNumNodes()/2;
+    t0=Time::getMillisecondCounterHiRes();
+    for (int i=0;i<numedits;++i)
+    {
+        envelope_node node=env.GetNodeAtIndex(index);
+        node.Time+=0.00001;
+        env.SetNode(index,node);
+        env.SortNodes();
+    }
+    Logger::writeToLog(String::formatted("\tSetNode and sort, %d drag steps : %.1f ms",
+                                         numedits,Time::getMillisecondCounterHiRes()-t0));
+    t0=Time::getMillisecondCounterHiRes();
+    for (int i=0;i<numedits;++i)
+    {
+        envelope_node node=env.GetNodeAtIndex(index);
+        node.Time-=0.00001;
+        index=env.move_node(index,node);
+    }
+    Logger::writeToLog(String::formatted("\tmove_node, %d drag steps : %.1f ms",
+                                         numedits,Time::getMillisecondCounterHiRes()-t0));
+    t0=Time::getMillisecondCounterHiRes();
+    env.manipulate_range(0,env.GetNumNodes()/10,[](envelope_node& node)
+    {
+        node.Value=1.0-node.Value;
+        return true;
+    });
+    Logger::writeToLog(String::formatted("\tmanipulate_range, %d nodes : %.1f ms",
+                                         env.GetNumNodes()/10,Time::getMillisecondCounterHiRes()-t0));
+}
+
+void benchmark_breakpoint_export()
+{
+    const int numnodes=10000;
+    const double filelen=600.0;
+    Random rnd(1);
+    nodes_t nodes;
+    double value=0.5;
+    for (int i=0;i<numnodes;++i)
+    {
+        // Mix of flat, linear and curved segments, like drawn automation
+        const int kind=rnd.nextInt(3);
+        if (kind>0)
+            value=rnd.nextDouble();
+        nodes.push_back(envelope_node((double)i/(numnodes-1),value,kind==2 ? rnd.nextDouble() : 0.5));
+    }
+    auto value_func=[](double x) { return 1.0+99.0*x; };
+    File legacy_file=File::getSpecialLocation(File::tempDirectory).getChildFile("jcdp_bench_legacy.txt");
+    File adaptive_file=File::getSpecialLocation(File::tempDirectory).getChildFile("jcdp_bench_adaptive.txt");
+    legacy_file.deleteFile();
+    double t0=Time::getMillisecondCounterHiRes();
+    {
+        // The previous exporter, 15 sub-segments per segment
+        FileOutputStream os(legacy_file);
+        const int num_sub_segments=15;
+        for (int i=0;i<numnodes-1;++i)
+        {
+            const envelope_node& node0=nodes[i];
+            const envelope_node& node1=nodes[i+1];
+            for (int j=0;j<num_sub_segments;++j)
+            {
+                double to_shaping=1.0/num_sub_segments*j;
+                double shaped=node0.Value+(node1.Value-node0.Value)*get_shaped_value(to_shaping,0,node0.ShapeParam1,0.0);
+                double scaledtime=(node0.Time+(node1.Time-node0.Time)*to_shaping)*filelen;
+                os << String::formatted("%f %f\n",scaledtime,value_func(shaped));
+            }
+        }
+    }
+    const double legacy_time=Time::getMillisecondCounterHiRes()-t0;
+    Logger::writeToLog(String::formatted("Breakpoint export benchmark : %d nodes",numnodes));
+    Logger::writeToLog(String::formatted("\tfixed subdivision : %.1f ms, %d bytes",legacy_time,(int)legacy_file.getSize()));
+    for (double max_error : { 0.01,0.001,0.0001 })
+    {
+        t0=Time::getMillisecondCounterHiRes();
+        const double abs_error=0.5*99.0*max_error;
+        breakpoints_t points=envelope_to_breakpoints(nodes,value_func,[filelen](double t) { return t*filelen; },abs_error);
+        simplify_breakpoints(points,abs_error);
+        write_breakpoint_file(adaptive_file,points);
+        const double elapsed=Time::getMillisecondCounterHiRes()-t0;
+        Logger::writeToLog(String::formatted("\tadaptive, max error %g : %.1f ms (%.2fx), %d points, %d bytes",
+                                             max_error,elapsed,legacy_time/elapsed,(int)points.size(),
+                                             (int)adaptive_file.getSize()));
+    }
+    legacy_file.deleteFile();
+    adaptive_file.deleteFile();
+}
+
+void benchmark_envelope_storage()
+{
+    const int numnodes=1000000;
+    const int numlookups=1000000;
+    Random rnd(1);
+    nodes_t nodes;
+    nodes.reserve(numnodes);
+    for (int i=0;i<numnodes;++i)
+        nodes.push_back(envelope_node((double)i/numnodes,rnd.nextDouble(),rnd.nextDouble()));
+    breakpoint_envelope env("benchmark");
+    env.insert_nodes(nodes);
+    std::vector<double> lookup_times(numlookups);
+    for (auto& e : lookup_times)
+        e=rnd.nextDouble();
+    // Accumulate the results so that the lookups can't be optimized away
+    int64 aos_index_sum=0;
+    double t0=Time::getMillisecondCounterHiRes();
+    for (double t : lookup_times)
+        aos_index_sum+=std::lower_bound(nodes.begin(),nodes.end(),envelope_node(t,0.0))-nodes.begin();
+    const double aos_search_time=Time::getMillisecondCounterHiRes()-t0;
+    int64 soa_index_sum=0;
+    t0=Time::getMillisecondCounterHiRes();
+    for (double t : lookup_times)
+        soa_index_sum+=env.get_node_arrays().lower_bound(t);
+    const double soa_search_time=Time::getMillisecondCounterHiRes()-t0;
+    double aos_sum=0.0;
+    t0=Time::getMillisecondCounterHiRes();
+    for (double t : lookup_times)
+        aos_sum+=GetInterpolatedNodeValue(nodes,t);
+    const double aos_time=Time::getMillisecondCounterHiRes()-t0;
+    double soa_sum=0.0;
+    t0=Time::getMillisecondCounterHiRes();
+    for (double t : lookup_times)
+        soa_sum+=env.GetInterpolatedNodeValue(t);
+    const double soa_time=Time::getMillisecondCounterHiRes()-t0;
+    Logger::writeToLog(String::formatted("Envelope storage benchmark : %d nodes, %d random lookups",numnodes,numlookups));
+    Logger::writeToLog(String::formatted("\tnodes_t : search %.1f ms, evaluation %.1f ms (%.1f M lookups/s), %.1f MB",
+                                         aos_search_time,aos_time,numlookups/aos_time/1000.0,
+                                         nodes.capacity()*sizeof(envelope_node)/1048576.0));
+    Logger::writeToLog(String::formatted("\tbreakpoint_envelope : search %.1f ms, evaluation %.1f ms (%.1f M lookups/s), %.1f MB",
+                                         soa_search_time,soa_time,numlookups/soa_time/1000.0,env.memory_size()/1048576.0));
+    Logger::writeToLog(String::formatted("\tsearch results %s, mean value difference %g",
+                                         aos_index_sum==soa_index_sum ? "match" : "differ",
+                                         std::abs(aos_sum-soa_sum)/numlookups));
+}
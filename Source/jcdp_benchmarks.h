@@ -0,0 +1,32 @@
+/*
+This file is part of CDP Front-end.
+
+CDP front-end is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+CDP front-end is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef JCDP_BENCHMARKS_H
+#define JCDP_BENCHMARKS_H
+
+#include "JuceHeader.h"
+
+// Developer benchmarks, available from the settings menu in debug builds.
+// They run synchronously and write their results with Logger::writeToLog.
+
+void benchmark_thumbnail_generation(String fn);
+void benchmark_envelope_evaluation();
+void benchmark_envelope_editing();
+void benchmark_breakpoint_export();
+void benchmark_envelope_storage();
+
+#endif // JCDP_BENCHMARKS_H
@@ -0,0 +1,179 @@
+/*
+This file is part of CDP Front-end.
+
+CDP front-end is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+CDP front-end is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "jcdp_breakpoints.h"
+
+// Deepest subdivision of a single segment, 2^16 sub-segments
+static const int c_max_subdivision_depth=16;
+
+namespace
+{
+    template<typename F>
+    void subdivide_segment(F&& eval, const std::function<double(double)>& time_func,
+                           double t0, double t1, double x0, double v0, double x1, double v1,
+                           double max_error, int depth, breakpoints_t& result)
+    {
+        const double xm=(x0+x1)*0.5;
+        const double vm=eval(xm);
+        bool within_error=std::abs(vm-(v0+v1)*0.5)<=max_error;
+        // The midpoint alone can miss the error of a strongly bent curve
+        if (within_error==true)
+            within_error=std::abs(eval(x0+(x1-x0)*0.25)-(v0*0.75+v1*0.25))<=max_error &&
+                         std::abs(eval(x0+(x1-x0)*0.75)-(v0*0.25+v1*0.75))<=max_error;
+        if (within_error==true || depth>=c_max_subdivision_depth)
+        {
+            result.emplace_back(time_func(t0+(t1-t0)*x0),v0);
+            return;
+        }
+        subdivide_segment(eval,time_func,t0,t1,x0,v0,xm,vm,max_error,depth+1,result);
+        subdivide_segment(eval,time_func,t0,t1,xm,vm,x1,v1,max_error,depth+1,result);
+    }
+}
+
+breakpoints_t envelope_to_breakpoints(const nodes_t& nodes,
+                                      const std::function<double(double)>& value_func,
+                                      const std::function<double(double)>& time_func,
+                                      double max_error)
+{
+    breakpoints_t result;
+    if (nodes.empty())
+        return result;
+    result.reserve(nodes.size()*2);
+    for (int i=0;i<(int)nodes.size()-1;++i)
+    {
+        const envelope_node& node0=nodes[i];
+        const envelope_node& node1=nodes[i+1];
+        const double value_delta=node1.Value-node0.Value;
+        auto eval=[&node0,value_delta,&value_func](double x)
+        {
+            return value_func(node0.Value+value_delta*get_shaped_value(x,0,node0.ShapeParam1,node0.ShapeParam2));
+        };
+        const double v0=value_func(node0.Value);
+        if (value_delta==0.0 || node1.Time<=node0.Time)
+        {
+            result.emplace_back(time_func(node0.Time),v0);
+            continue;
+        }
+        subdivide_segment(eval,time_func,node0.Time,node1.Time,0.0,v0,1.0,value_func(node1.Value),
+                          max_error,0,result);
+    }
+    result.emplace_back(time_func(nodes.back().Time),value_func(nodes.back().Value));
+    return result;
+}
+
+void simplify_breakpoints(breakpoints_t& points, double max_error)
+{
+    if (points.size()<3)
+        return;
+    std::vector<char> keep(points.size(),0);
+    keep.front()=1;
+    keep.back()=1;
+    std::vector<std::pair<int,int>> ranges{ { 0,(int)points.size()-1 } };
+    while (ranges.empty()==false)
+    {
+        const auto range=ranges.back();
+        ranges.pop_back();
+        const auto& a=points[range.first];
+        const auto& b=points[range.second];
+        const double tdelta=b.first-a.first;
+        double worst_error=-1.0;
+        int worst_index=-1;
+        for (int i=range.first+1;i<range.second;++i)
+        {
+            double interpolated=a.second;
+            if (tdelta>0.0)
+                interpolated+=(b.second-a.second)*(points[i].first-a.first)/tdelta;
+            const double error=std::abs(points[i].second-interpolated);
+            if (error>worst_error)
+            {
+                worst_error=error;
+                worst_index=i;
+            }
+        }
+        if (worst_index>=0 && worst_error>max_error)
+        {
+            keep[worst_index]=1;
+            ranges.emplace_back(range.first,worst_index);
+            ranges.emplace_back(worst_index,range.second);
+        }
+    }
+    int num_kept=0;
+    for (size_t i=0;i<points.size();++i)
+        if (keep[i]!=0)
+            points[num_kept++]=points[i];
+    points.resize(num_kept);
+}
+
+std::string format_breakpoints(const breakpoints_t& points)
+{
+    std::string result;
+    result.reserve(points.size()*24);
+    char buf[64];
+    for (auto& e : points)
+    {
+        int len=snprintf(buf,sizeof(buf),"%f %f\n",e.first,e.second);
+        if (len>0)
+            result.append(buf,std::min<int>(len,sizeof(buf)-1));
+    }
+    return result;
+}
+
+bool write_breakpoint_file(const File& file, const breakpoints_t& points)
+{
+    const std::string text=format_breakpoints(points);
+    return file.replaceWithData(text.data(),text.size());
+}
+
+cached_breakpoint_file::~cached_breakpoint_file()
+{
+    remove_file_if_exists(m_filename);
+}
+
+std::shared_ptr<cached_breakpoint_file> breakpoint_file_cache::get_file(const breakpoint_cache_key& key, String fn,
+                                                                        const std::function<breakpoints_t()>& generate)
+{
+    size_t hash=0;
+    for (double x : key)
+        combine_hashes_helper(hash,x);
+    const ScopedLock locker(m_cs);
+    ++m_use_counter;
+    auto it=m_entries.find(hash);
+    // On a hash collision the entry is replaced by the new file
+    if (it!=m_entries.end() && it->second.m_key==key && File(it->second.m_file->m_filename).existsAsFile()==true)
+    {
+        it->second.m_last_used=m_use_counter;
+        return it->second.m_file;
+    }
+    if (write_breakpoint_file(File(fn),generate())==false)
+        return nullptr;
+    auto file=std::make_shared<cached_breakpoint_file>(fn);
+    m_entries[hash]={ key,file,m_use_counter };
+    while ((int)m_entries.size()>m_capacity)
+    {
+        auto oldest=std::min_element(m_entries.begin(),m_entries.end(),
+                                     [](const std::pair<const size_t,entry>& a, const std::pair<const size_t,entry>& b)
+        { return a.second.m_last_used<b.second.m_last_used; });
+        m_entries.erase(oldest);
+    }
+    return file;
+}
+
+void breakpoint_file_cache::clear()
+{
+    const ScopedLock locker(m_cs);
+    m_entries.clear();
+}
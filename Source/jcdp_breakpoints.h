@@ -0,0 +1,97 @@
+/*
+This file is part of CDP Front-end.
+
+CDP front-end is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+CDP front-end is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef JCDP_BREAKPOINTS_H
+#define JCDP_BREAKPOINTS_H
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "JuceHeader.h"
+#include "jcdp_envelope.h"
+#include "jcdp_utilities.h"
+
+// Conversion of the shaped envelopes into the linear breakpoint files CDP reads.
+// Each shaped segment is subdivided only as much as needed to keep the linear
+// interpolation within the maximum error, and points that lie on a line between
+// their neighbours are removed afterwards.
+
+// time, value
+using breakpoints_t=std::vector<std::pair<double,double>>;
+
+// Maps the nodes into breakpoints. value_func maps the normalized envelope values and
+// time_func the node times (linearly) into the values and times written to the file.
+// The result stays within max_error of value_func applied to the shaped curve.
+breakpoints_t envelope_to_breakpoints(const nodes_t& nodes,
+                                      const std::function<double(double)>& value_func,
+                                      const std::function<double(double)>& time_func,
+                                      double max_error);
+
+// Ramer-Douglas-Peucker pass, removing points whose value is within max_error of the
+// line between the points kept around them
+void simplify_breakpoints(breakpoints_t& points, double max_error);
+
+// Formats all the points into one string, in the "time value" per line format of CDP
+std::string format_breakpoints(const breakpoints_t& points);
+
+bool write_breakpoint_file(const File& file, const breakpoints_t& points);
+
+// A breakpoint file owned by breakpoint_file_cache. The file is deleted when the
+// last reference to it goes away.
+struct cached_breakpoint_file
+{
+    cached_breakpoint_file(String fn) : m_filename(fn) {}
+    ~cached_breakpoint_file();
+    cached_breakpoint_file(const cached_breakpoint_file&)=delete;
+    cached_breakpoint_file& operator=(const cached_breakpoint_file&)=delete;
+    const String m_filename;
+};
+
+// Everything that goes into a breakpoint file, as compared by breakpoint_file_cache
+typedef std::vector<double> breakpoint_cache_key;
+
+// Breakpoint files keyed by everything that goes into them, so that renders with unchanged
+// envelopes, and all the channels of a split render, use the same file. The entries are
+// looked up by a hash of the key, and the whole key is compared before a file is reused.
+// Renders keep references to the files they use, so evicting an entry doesn't remove
+// a file that a running CDP process still reads.
+class breakpoint_file_cache
+{
+public:
+    breakpoint_file_cache(int capacity=64) : m_capacity(capacity) {}
+    // Returns the cached file for the key, or writes the points from generate into a new
+    // file named fn. Returns nullptr if the file could not be written.
+    std::shared_ptr<cached_breakpoint_file> get_file(const breakpoint_cache_key& key, String fn,
+                                                     const std::function<breakpoints_t()>& generate);
+    void clear();
+private:
+    struct entry
+    {
+        breakpoint_cache_key m_key;
+        std::shared_ptr<cached_breakpoint_file> m_file;
+        uint64 m_last_used=0;
+    };
+    CriticalSection m_cs;
+    std::map<size_t,entry> m_entries;
+    uint64 m_use_counter=0;
+    int m_capacity=64;
+};
+
+#endif // JCDP_BREAKPOINTS_H
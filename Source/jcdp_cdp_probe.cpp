@@ -0,0 +1,297 @@
+/*
+This file is part of CDP Front-end.
+
+CDP front-end is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+CDP front-end is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "jcdp_cdp_probe.h"
+#include "jcdp_utilities.h"
+
+#undef min
+#undef max
+
+// The positional parameters of a processor as render_cdp_file passes them, excluding the
+// pre volume and FFT settings which are not given to the program itself
+static int count_positional_parameters(const CDP_processor_info& proc)
+{
+    int first=proc.m_is_spectral ? 3 : 1;
+    int result=0;
+    for (int i=first;i<proc.m_parameters.size();++i)
+        if (proc.m_parameters[i].m_cmd_prefix.isEmpty()==true)
+            ++result;
+    return result;
+}
+
+// Finds the usage line like "modify brassage 6 infile outfile velocity density ..." and counts
+// the parameters after the output file. Long usages continue on the following lines, which
+// only have lower case parameter names, the parameter descriptions after them are upper case.
+static int parse_usage_arguments(const StringArray& lines, const String& program,
+                                 const String& sub_program, const String& mode)
+{
+    for (int i=0;i<lines.size();++i)
+    {
+        StringArray tokens=StringArray::fromTokens(lines[i]," \t","");
+        if (tokens.size()>0 && tokens[0].startsWithIgnoreCase("usage"))
+            tokens.remove(0);
+        if (tokens.size()<2 || File(tokens[0]).getFileNameWithoutExtension().equalsIgnoreCase(program)==false
+                || tokens[1].equalsIgnoreCase(sub_program)==false)
+            continue;
+        int pos=2;
+        if (mode.isNotEmpty()==true)
+        {
+            if (tokens[2]!=mode && tokens[2].equalsIgnoreCase("mode")==false)
+                continue;
+            pos=3;
+        }
+        for (int j=i+1;j<lines.size();++j)
+        {
+            String line=lines[j].trim();
+            if (line.isEmpty()==true || (line.startsWithChar('[')==false && line!=line.toLowerCase()))
+                break;
+            tokens.addTokens(line," \t","");
+        }
+        int outfile_index=-1;
+        for (int j=pos;j<tokens.size();++j)
+        {
+            if (tokens[j].startsWith("out")==true)
+            {
+                outfile_index=j;
+                break;
+            }
+        }
+        if (outfile_index<0)
+            return -1;
+        int result=0;
+        for (int j=outfile_index+1;j<tokens.size();++j)
+            if (tokens[j].startsWithChar('[')==false && tokens[j].startsWithChar('-')==false)
+                ++result;
+        return result;
+    }
+    return -1;
+}
+
+cdp_capability_probe::cdp_capability_probe() : Thread("CDP capability probe")
+{
+}
+
+cdp_capability_probe::~cdp_capability_probe()
+{
+    stopThread(m_timeout_ms+1000);
+}
+
+String cdp_capability_probe::make_key(const String& program, const String& sub_program, const String& mode) const
+{
+    return m_binaries_dir.getFullPathName()+" "+program+" "+sub_program+" "+mode;
+}
+
+String cdp_capability_probe::make_key(const CDP_processor_info& proc) const
+{
+    return make_key(proc.m_main_program,proc.m_sub_program,proc.m_mode);
+}
+
+void cdp_capability_probe::start(File cache_file, File binaries_dir, const std::vector<CDP_processor_info>& procs)
+{
+    if (isThreadRunning()==true)
+        return;
+    m_cache_file=cache_file;
+    m_binaries_dir=binaries_dir;
+    m_targets.clear();
+    std::set<String> keys;
+    for (auto& proc : procs)
+    {
+        if (proc.m_main_program.isEmpty()==true || proc.m_main_program=="vstplugin")
+            continue;
+        if (keys.insert(make_key(proc)).second==true)
+            m_targets.push_back({proc.m_main_program,proc.m_sub_program,proc.m_mode});
+    }
+    startThread(Thread::lowPriority);
+}
+
+bool cdp_capability_probe::find(const CDP_processor_info& proc, cdp_program_capabilities& result) const
+{
+    ScopedLock locker(m_cs);
+    auto iter=m_results.find(make_key(proc));
+    if (iter==m_results.end())
+        return false;
+    result=iter->second;
+    return true;
+}
+
+String cdp_capability_probe::check_processor(const CDP_processor_info& proc) const
+{
+    cdp_program_capabilities caps;
+    if (proc.m_main_program=="vstplugin" || find(proc,caps)==false)
+        return String();
+    if (caps.m_binary_exists==false)
+        return caps.m_binary+" was not found in the CDP binaries folder";
+    if (caps.m_responded==false)
+        return proc.m_main_program+" "+proc.m_sub_program+" does not run, the program may be broken";
+    // Processors whose parameters haven't been loaded yet can't be checked further
+    if (proc.m_pending_parameters!=nullptr)
+        return String();
+    const int expected=count_positional_parameters(proc);
+    if (caps.m_num_arguments>=0 && caps.m_num_arguments!=expected)
+    {
+        ScopedLock locker(m_cs);
+        if (m_warned.insert(proc.m_title).second==true)
+        {
+            Logger::writeToLog("Warning : "+proc.m_title+" passes "+String(expected)+" parameters but the usage of "
+                               +proc.m_main_program+" "+proc.m_sub_program+" "+proc.m_mode+" lists "
+                               +String(caps.m_num_arguments));
+        }
+    }
+    return String();
+}
+
+bool cdp_capability_probe::is_broken(const CDP_processor_info& proc) const
+{
+    cdp_program_capabilities caps;
+    if (proc.m_main_program=="vstplugin" || find(proc,caps)==false)
+        return false;
+    // Missing programs are left to the render time error, the binaries folder may just be wrong
+    return caps.m_binary_exists==true && caps.m_responded==false;
+}
+
+String cdp_capability_probe::probe_version(const File& binary)
+{
+    ChildProcess proc;
+    StringArray args;
+    args.add(binary.getFullPathName());
+    args.add("--version");
+    if (proc.start(args)==false)
+        return String();
+    if (proc.waitForProcessToFinish(m_timeout_ms)==false)
+    {
+        proc.kill();
+        return String();
+    }
+    return proc.readAllProcessOutput().trim().upToFirstOccurrenceOf("\n",false,false).trim();
+}
+
+cdp_program_capabilities cdp_capability_probe::probe(const probe_target& target, const File& binary)
+{
+    cdp_program_capabilities result;
+    result.m_binary=binary.getFileName();
+    result.m_binary_exists=binary.existsAsFile();
+    if (result.m_binary_exists==false)
+        return result;
+    result.m_binary_mod_time=binary.getLastModificationTime().toMilliseconds();
+    ChildProcess proc;
+    StringArray args;
+    args.add(binary.getFullPathName());
+    args.add(target.m_sub_program);
+    if (target.m_mode.isNotEmpty()==true)
+        args.add(target.m_mode);
+    if (proc.start(args)==false)
+        return result;
+    if (proc.waitForProcessToFinish(m_timeout_ms)==false)
+    {
+        proc.kill();
+        Logger::writeToLog("CDP probe of "+args.joinIntoString(" ")+" timed out");
+        return result;
+    }
+    String output=proc.readAllProcessOutput();
+    result.m_responded=output.trim().isNotEmpty();
+    result.m_num_arguments=parse_usage_arguments(StringArray::fromLines(output),target.m_program,
+                                                 target.m_sub_program,target.m_mode);
+    result.m_usage_found=result.m_num_arguments>=0;
+    return result;
+}
+
+void cdp_capability_probe::load_cache()
+{
+    if (m_cache_file.existsAsFile()==false)
+        return;
+    std::unique_ptr<XmlElement> xml(XmlDocument::parse(m_cache_file));
+    if (xml==nullptr)
+        return;
+    ScopedLock locker(m_cs);
+    forEachXmlChildElementWithTagName(*xml,e,"PROGRAM")
+    {
+        cdp_program_capabilities caps;
+        caps.m_binary=e->getStringAttribute("binary");
+        caps.m_binary_mod_time=e->getStringAttribute("modtime").getLargeIntValue();
+        caps.m_binary_exists=e->getBoolAttribute("exists");
+        caps.m_responded=e->getBoolAttribute("responded");
+        caps.m_usage_found=e->getBoolAttribute("usage");
+        caps.m_version=e->getStringAttribute("version");
+        caps.m_num_arguments=e->getIntAttribute("numargs",-1);
+        m_results[e->getStringAttribute("key")]=caps;
+    }
+}
+
+void cdp_capability_probe::save_cache()
+{
+    XmlElement xml("CDPCAPABILITIES");
+    ScopedLock locker(m_cs);
+    for (auto& e : m_results)
+    {
+        XmlElement* child=xml.createNewChildElement("PROGRAM");
+        child->setAttribute("key",e.first);
+        child->setAttribute("binary",e.second.m_binary);
+        child->setAttribute("modtime",String(e.second.m_binary_mod_time));
+        child->setAttribute("exists",e.second.m_binary_exists);
+        child->setAttribute("responded",e.second.m_responded);
+        child->setAttribute("usage",e.second.m_usage_found);
+        child->setAttribute("version",e.second.m_version);
+        child->setAttribute("numargs",e.second.m_num_arguments);
+    }
+    xml.writeToFile(m_cache_file,"");
+}
+
+void cdp_capability_probe::run()
+{
+    double t0=Time::getMillisecondCounterHiRes();
+    load_cache();
+    std::map<String,String> versions;
+    int num_probed=0;
+    for (auto& target : m_targets)
+    {
+        if (threadShouldExit()==true)
+            return;
+#ifdef WIN32
+        File binary=m_binaries_dir.getChildFile(target.m_program+".exe");
+#else
+        File binary=m_binaries_dir.getChildFile(target.m_program);
+#endif
+        const bool exists=binary.existsAsFile();
+        const int64 mod_time=exists ? binary.getLastModificationTime().toMilliseconds() : 0;
+        const String key=make_key(target.m_program,target.m_sub_program,target.m_mode);
+        {
+            ScopedLock locker(m_cs);
+            auto iter=m_results.find(key);
+            if (iter!=m_results.end() && iter->second.m_binary_exists==exists && iter->second.m_binary_mod_time==mod_time)
+                continue;
+        }
+        cdp_program_capabilities caps=probe(target,binary);
+        if (caps.m_responded==true)
+        {
+            // Several processors share the program, its version is only asked once
+            if (versions.count(target.m_program)==0)
+                versions[target.m_program]=probe_version(binary);
+            caps.m_version=versions[target.m_program];
+        }
+        if (threadShouldExit()==true)
+            return;
+        ++num_probed;
+        ScopedLock locker(m_cs);
+        m_results[key]=caps;
+    }
+    if (num_probed>0)
+        save_cache();
+    Logger::writeToLog("CDP capability probe of "+String((int)m_targets.size())+" programs took "
+                       +String(Time::getMillisecondCounterHiRes()-t0,1)+" ms, "+String(num_probed)+" probed");
+    if (OnFinished)
+        OnFinished();
+}
@@ -0,0 +1,88 @@
+/*
+This file is part of CDP Front-end.
+
+CDP front-end is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+CDP front-end is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef JCDP_CDP_PROBE_H
+#define JCDP_CDP_PROBE_H
+
+#include <functional>
+#include <map>
+#include <set>
+#include <vector>
+#include "JuceHeader.h"
+#include "jcdp_processor.h"
+
+// What a CDP program reported about itself when run without any files
+struct cdp_program_capabilities
+{
+    String m_binary;
+    int64 m_binary_mod_time=0;
+    bool m_binary_exists=false;
+    // The program printed something instead of crashing right away
+    bool m_responded=false;
+    // A usage line for the sub program and mode was found
+    bool m_usage_found=false;
+    String m_version;
+    // Parameters after the output file in the usage line, -1 if not known
+    int m_num_arguments=-1;
+};
+
+// Runs each CDP program the processors use once, with no files, and reads the usage it prints.
+// The results are cached in a file per binaries folder and reused as long as the program binary
+// has the same modification time, so after the first run the probe costs only a few file checks.
+// Everything happens on a background thread, until it has finished the processors are assumed
+// to work. Only a missing or unresponsive program stops a processor from rendering, the usage
+// parsing is a heuristic and a parameter count that differs from it is just logged.
+class cdp_capability_probe : public Thread
+{
+public:
+    cdp_capability_probe();
+    ~cdp_capability_probe();
+    // Starts probing the CDP programs of the processors, the other processors are ignored
+    void start(File cache_file, File binaries_dir, const std::vector<CDP_processor_info>& procs);
+    // Called from the probe thread when all the programs have been probed
+    std::function<void()> OnFinished;
+    // Empty if the processor can be rendered, or nothing is known about it yet
+    String check_processor(const CDP_processor_info& proc) const;
+    // The program exists but crashes or hangs when started
+    bool is_broken(const CDP_processor_info& proc) const;
+    void run() override;
+private:
+    struct probe_target
+    {
+        String m_program;
+        String m_sub_program;
+        String m_mode;
+    };
+    // Includes the binaries folder, so that programs in another folder are probed again
+    String make_key(const String& program, const String& sub_program, const String& mode) const;
+    String make_key(const CDP_processor_info& proc) const;
+    bool find(const CDP_processor_info& proc, cdp_program_capabilities& result) const;
+    cdp_program_capabilities probe(const probe_target& target, const File& binary);
+    String probe_version(const File& binary);
+    void load_cache();
+    void save_cache();
+    File m_cache_file;
+    File m_binaries_dir;
+    std::vector<probe_target> m_targets;
+    std::map<String,cdp_program_capabilities> m_results;
+    // The processors whose parameter count mismatch has been logged
+    mutable std::set<String> m_warned;
+    mutable CriticalSection m_cs;
+    int m_timeout_ms=5000;
+};
+
+#endif // JCDP_CDP_PROBE_H
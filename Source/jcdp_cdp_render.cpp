@@ -0,0 +1,468 @@
+/*
+This file is part of CDP Front-end.
+
+CDP front-end is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+CDP front-end is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <atomic>
+#include "jcdp_cdp_render.h"
+#ifdef WIN32
+#include <windows.h>
+#else
+#include "stdlib.h"
+#endif
+
+#undef min
+#undef max
+
+extern File g_cdp_binaries_dir;
+extern std::unique_ptr<PropertiesFile> g_propsfile;
+
+int g_max_child_process_wait_time=15000;
+
+String get_temp_audio_file_name(String suffix)
+{
+    // The counter keeps the names unique when several renders run at the same time
+    static std::atomic<int> counter{0};
+    return get_audio_render_path()+"/"+c_file_prefix+String(Time::getHighResolutionTicks())+"_"+String(++counter)+"."+suffix;
+}
+
+void check_and_fix_environment()
+{
+#ifdef WIN32
+    char buf[1024];
+    auto result=GetEnvironmentVariableA("CDP_SOUND_EXT",buf,1024);
+    if (result==0)
+    {
+        Logger::writeToLog("CDP sound file extension environment variable not set");
+        SetEnvironmentVariableA("CDP_SOUND_EXT","wav");
+        result=GetEnvironmentVariableA("CDP_SOUND_EXT",buf,1024);
+        if (result!=0)
+        {
+            Logger::writeToLog("Set CDP_SOUND_EXT for the process!");
+        }
+    }
+    result=GetEnvironmentVariableA("CDP_NOCLIP_FLOATS",buf,1024);
+    if (result==0)
+    {
+        Logger::writeToLog("CDP_NOCLIP_FLOATS environment variable not set");
+        SetEnvironmentVariableA("CDP_NOCLIP_FLOATS","1");
+        result=GetEnvironmentVariableA("CDP_NOCLIP_FLOATS",buf,1024);
+        if (result!=0)
+        {
+            Logger::writeToLog("Set CDP_NOCLIP_FLOATS for the process!");
+        }
+    }
+#else
+    if (putenv(strdup("CDP_SOUND_EXT=wav"))!=0)
+        Logger::writeToLog("Could not set CDP_SOUND_EXT environment variable");
+    if (putenv(strdup("CDP_NOCLIP_FLOATS=1"))!=0)
+        Logger::writeToLog("Could not set CDP_NOCLIP_FLOATS environment variable");
+#endif
+}
+
+std::pair<StringArray, String> do_pvoc_analysis(StringArray infiles, int wsize, int olap,
+                                                std::function<bool()> should_cancel)
+{
+    child_processes processes;
+    StringArray outfilenames;
+    for (int i=0;i<infiles.size();++i)
+    {
+        String outfilename=get_temp_audio_file_name("ana");
+        outfilenames.add(outfilename);
+        remove_file_if_exists(outfilename);
+        StringArray pvocargs;
+        pvocargs.add(g_cdp_binaries_dir.getFullPathName()+"/pvoc");
+        pvocargs.add("anal");
+        pvocargs.add("1");
+        pvocargs.add(infiles[i]);
+        pvocargs.add(outfilename);
+        pvocargs.add(String::formatted("-c%d",wsize));
+        pvocargs.add(String::formatted("-o%d",olap));
+        Logger::writeToLog("Starting ChildProcess pvoc anal "+infiles[i]);
+        //Logger::writeToLog(pvocargs.joinIntoString(" "));
+        processes.add_and_start_task(pvocargs);
+    }
+    String r=processes.wait_for_finished(g_max_child_process_wait_time,should_cancel);
+    if (r.isEmpty()==true)
+    {
+        return std::make_pair(outfilenames,String());
+    }
+    for (auto& e : outfilenames)
+        remove_file_if_exists(e);
+    return std::make_pair(StringArray(),r);
+}
+
+std::pair<StringArray, String> do_pvoc_resynth(StringArray infiles, std::function<bool()> should_cancel)
+{
+    bool do_parallel=true;
+    child_processes processes;
+    StringArray outfiles;
+    for (int i=0;i<infiles.size();++i)
+    {
+        String resynthtoutfn=get_temp_audio_file_name();
+        remove_file_if_exists(resynthtoutfn);
+        outfiles.add(resynthtoutfn);
+        StringArray pvocargs;
+        pvocargs.add(g_cdp_binaries_dir.getFullPathName()+"/pvoc");
+        pvocargs.add("synth");
+        pvocargs.add(infiles[i]);
+        pvocargs.add("-f"+resynthtoutfn);
+        if (do_parallel==true)
+            processes.add_and_start_task(pvocargs);
+        else
+        {
+            processes.add_task(pvocargs);
+        }
+    }
+    String r;
+    if (do_parallel==true)
+        r=processes.wait_for_finished(g_max_child_process_wait_time,should_cancel);
+    else r=processes.process_sequentially(g_max_child_process_wait_time);
+    if (r.isEmpty()==true)
+        return std::make_pair(outfiles,String());
+    for (auto& e : outfiles)
+        remove_file_if_exists(e);
+    return std::make_pair(StringArray(),r);
+}
+
+// Everything that affects the breakpoint file written for the parameter
+static breakpoint_cache_key make_breakpoint_cache_key(parameter_info& param, double time_scale, time_range time_selection,
+                                                      double inputfilelen, double max_error)
+{
+    const envelope_node_arrays& nodes=param.m_env.get_node_arrays();
+    breakpoint_cache_key key;
+    key.reserve(10+4*nodes.size());
+    key.insert(key.end(),{ time_scale,time_selection.start(),time_selection.end(),inputfilelen,max_error });
+    // The scaling function is identified by its output at a few points
+    for (double x : { 0.0,0.25,0.5,0.75,1.0 })
+        key.push_back(param.m_slider_shaping_func(x));
+    for (int i=0;i<nodes.size();++i)
+        key.insert(key.end(),{ nodes.time(i),nodes.value(i),(double)nodes.shape_p1(i),(double)nodes.shape_p2(i) });
+    return key;
+}
+
+String generate_cmd_argument(parameter_info& param,
+                             double inputfilelen,
+                             file_cleaner& cleaner,
+                             CDP_processor_info& procinfo,time_range time_selection,
+                             breakpoint_file_cache* cache)
+{
+    if (time_selection.isValid()==false)
+        time_selection=time_range(0.0,inputfilelen);
+    if (param.m_cmd_arg_formatter)
+    {
+        auto result=param.m_cmd_arg_formatter(&param);
+        if (result.second==true)
+            cleaner.add(result.first);
+        return result.first;
+    }
+    if (param.m_automation_enabled==false)
+    {
+        if (param.m_cmd_prefix.isEmpty()==true)
+            return String(param.m_current_value);
+        else
+            return param.m_cmd_prefix+String(param.m_current_value);
+    } else
+    {
+        String parname=param.m_name.replaceCharacter(' ','_');
+        String env_fn=get_audio_render_path()+"/"+c_file_prefix+parname+String(Time::getHighResolutionTicks())+".txt";
+        double valuerange=param.m_maximum_value-param.m_minimum_value;
+        double max_error_setting=g_propsfile->getDoubleValue("breakpoint_max_error",0.001);
+        // Half of the allowed error goes to the subdivision and half to the simplification
+        double max_error=0.5*std::abs(valuerange)*max_error_setting;
+        double time_scale=inputfilelen;
+        bool clip_to_selection=true;
+        if (param.m_envelope_time_scaling_func)
+        {
+            time_scale=param.m_envelope_time_scaling_func(&procinfo);
+            clip_to_selection=false;
+        }
+        auto generate=[&param,time_scale,clip_to_selection,max_error,inputfilelen,time_selection]()
+        {
+            breakpoints_t envpoints=envelope_to_breakpoints(param.m_env.get_all_nodes(),
+                                                            param.m_slider_shaping_func,
+                                                            [time_scale](double t) { return t*time_scale; },
+                                                            max_error);
+            simplify_breakpoints(envpoints,max_error);
+            breakpoints_t points;
+            points.reserve(envpoints.size()+2);
+            if (time_selection.start()>0.0)
+            {
+                double normalizedvalue=param.m_env.GetInterpolatedNodeValue(1.0/inputfilelen*time_selection.start());
+                points.emplace_back(0.0,param.m_slider_shaping_func(normalizedvalue));
+            }
+            for (auto& e : envpoints)
+            {
+                if (clip_to_selection==true)
+                {
+                    if (e.first<time_selection.start() || e.first>time_selection.end())
+                        continue;
+                    e.first-=time_selection.start();
+                }
+                // CDP wants the breakpoint times to be increasing
+                if (points.empty()==false && e.first<=points.back().first)
+                    continue;
+                points.push_back(e);
+            }
+            if (points.empty()==true || time_selection.length()>points.back().first)
+            {
+                double normalizedvalue=param.m_env.GetInterpolatedNodeValue(1.0/inputfilelen*time_selection.end());
+                points.emplace_back(time_selection.length(),param.m_slider_shaping_func(normalizedvalue));
+            }
+            return points;
+        };
+        if (cache!=nullptr)
+        {
+            breakpoint_cache_key key=make_breakpoint_cache_key(param,time_scale,time_selection,inputfilelen,max_error_setting);
+            auto cached_file=cache->get_file(key,env_fn,generate);
+            if (cached_file!=nullptr)
+            {
+                cleaner.keep_alive(cached_file);
+                env_fn=cached_file->m_filename;
+            }
+            else env_fn=String();
+        }
+        else
+        {
+            if (write_breakpoint_file(File(env_fn),generate())==true)
+                cleaner.add(env_fn);
+            else env_fn=String();
+        }
+        if (env_fn.isNotEmpty())
+        {
+            if (param.m_cmd_prefix.isEmpty()==true)
+                return env_fn;
+            else return param.m_cmd_prefix+env_fn;
+        }
+    }
+    return String();
+}
+
+std::pair<StringArray, String> split_multichannel_file(String fn, 
+	audio_source_info info, file_cleaner& cleaner)
+{
+    StringArray result;
+    // housekeep chans 2 names its outputs after the input file, so it is run on a uniquely
+    // named copy to keep renders of the same file at the same time from sharing the outputs
+    File helper_file(get_temp_audio_file_name(File(fn).getFileExtension().substring(1)));
+    if (File(fn).copyFileTo(helper_file)==false)
+        return std::make_pair(StringArray(),"Could not copy "+fn+" for the channel split");
+    cleaner.add(helper_file.getFullPathName());
+    File helper_directory=helper_file.getParentDirectory();
+    for (int i=0;i<info.num_channels;++i)
+    {
+        String temp_fn=helper_directory.getFullPathName()+"/"+
+                helper_file.getFileNameWithoutExtension()+"_c"+String(i+1)+helper_file.getFileExtension();
+        remove_file_if_exists(temp_fn,true);
+        cleaner.add(temp_fn,true);
+        result.add(temp_fn);
+    }
+    ChildProcess proc;
+    StringArray proc_args;
+    proc_args.add(g_cdp_binaries_dir.getFullPathName()+"/housekeep");
+    proc_args.add("chans");
+    proc_args.add("2");
+    proc_args.add(helper_file.getFullPathName());
+    proc.start(proc_args);
+    proc.waitForProcessToFinish(g_max_child_process_wait_time);
+    if (proc.getExitCode()==0)
+    {
+        return std::make_pair(result,String());
+    }
+    return std::make_pair(StringArray(),proc.readAllProcessOutput());
+}
+
+std::pair<String, String> merge_split_files(StringArray infiles)
+{
+    //submix interleave sndfile1 sndfile2 [sndfile3 sndfile4] outfile
+    String outfn=get_temp_audio_file_name();
+    ChildProcess proc;
+    StringArray merge_args;
+    merge_args.add(g_cdp_binaries_dir.getFullPathName()+"/submix");
+    merge_args.add("interleave");
+    for (int i=0;i<infiles.size();++i)
+    {
+        merge_args.add(infiles[i]);
+    }
+    merge_args.add(outfn);
+    proc.start(merge_args);
+    proc.waitForProcessToFinish(g_max_child_process_wait_time);
+    if (proc.getExitCode()==0)
+    {
+        return std::make_pair(outfn,String());
+    }
+    return std::make_pair(String(),proc.readAllProcessOutput());
+}
+
+std::pair<String,String> cut_file(String infn, time_range trange, bool excise)
+{
+    if (trange.isValid()==false)
+        return std::make_pair(infn,String());
+    String outfn=get_temp_audio_file_name();
+    remove_file_if_exists(outfn);
+    ChildProcess proc;
+    StringArray cutargs;
+    cutargs.add(g_cdp_binaries_dir.getFullPathName()+"/sfedit");
+    if (excise==false)
+    {
+        cutargs.add("cut");
+        cutargs.add("1");
+    } else
+    {
+        cutargs.add("excise");
+        cutargs.add("1");
+    }
+    cutargs.add(infn);
+    cutargs.add("-f"+outfn);
+    cutargs.add(String(trange.start()));
+    cutargs.add(String(trange.end()-0.001)); // the CDP cut program errors out if the end is even slightly past the file end
+    proc.start(cutargs);
+    proc.waitForProcessToFinish(g_max_child_process_wait_time);
+    {
+        if (proc.getExitCode()==0)
+        {
+            return std::make_pair(outfn,String());
+        }
+    }
+    return std::make_pair(String(),proc.readAllProcessOutput());
+}
+
+String adjust_file_volume(String infn, double vol)
+{
+    String outfn=get_temp_audio_file_name();
+    remove_file_if_exists(outfn);
+    auto result=run_process({g_cdp_binaries_dir.getFullPathName()+"/modify",
+                            "loudness","2",
+                            infn,"-f"+outfn,
+                            String(vol)},g_max_child_process_wait_time);
+    if (result.second==0)
+        return outfn;
+    return String();
+}
+
+String monoize_file(String infn)
+{
+    String outfn=get_temp_audio_file_name();
+    //String outfn(get_audio_render_path()+"/monoized_"+String(Time::currentTimeMillis())+".wav");
+    remove_file_if_exists(outfn);
+    ChildProcess proc;
+    StringArray monoizer_args;
+    monoizer_args.add(g_cdp_binaries_dir.getFullPathName()+"/housekeep");
+    monoizer_args.add("chans");
+    monoizer_args.add("4");
+    monoizer_args.add(infn);
+    monoizer_args.add("-f"+outfn);
+    proc.start(monoizer_args);
+    proc.waitForProcessToFinish(g_max_child_process_wait_time);
+    {
+        if (proc.getExitCode()==0)
+        {
+            return outfn;
+        }
+    }
+    return String();
+}
+
+std::pair<String,String> render_cdp_file(CDP_processor_info& procinfo, String infile,
+                                         time_range time_selection, double source_length,
+                                         file_cleaner& cleaner, breakpoint_file_cache* cache,
+                                         std::function<bool()> should_cancel)
+{
+    auto cancelled=[&should_cancel]() { return should_cancel && should_cancel(); };
+    auto info=get_audio_source_info(infile);
+    if (info.num_channels<1)
+        return std::make_pair(String(),"Could not read "+infile);
+    if (source_length<=0.0)
+        source_length=info.get_length_seconds();
+    StringArray infiles;
+    if (procinfo.m_mono_only==false || info.num_channels==1)
+        infiles.add(infile);
+    else
+    {
+        auto split_result=split_multichannel_file(infile,info,cleaner);
+        if (split_result.second.isNotEmpty())
+            return std::make_pair(String(),"CDP channel split failed\n"+split_result.second);
+        infiles.addArray(split_result.first);
+    }
+    if (cancelled()==true)
+        return std::make_pair(String(),String("Cancelled"));
+    if (procinfo.m_is_spectral==true)
+    {
+        int wsize=(int)procinfo.m_parameters[1].m_current_value;
+        int olap=(int)procinfo.m_parameters[2].m_current_value;
+        auto pvoc_anal_result=do_pvoc_analysis(infiles,wsize,olap,cancelled);
+        if (pvoc_anal_result.second.isNotEmpty())
+            return std::make_pair(String(),"CDP pvoc analysis failed\n"+pvoc_anal_result.second);
+        infiles=pvoc_anal_result.first;
+        cleaner.add_multiple(infiles);
+        if (cancelled()==true)
+            return std::make_pair(String(),String("Cancelled"));
+    }
+    StringArray param_args;
+    int param_index_offset=1;
+    if (procinfo.m_is_spectral==true)
+        param_index_offset=3;
+    for (int i=param_index_offset;i<procinfo.m_parameters.size();++i)
+        param_args.add(generate_cmd_argument(procinfo.m_parameters[i],source_length,cleaner,procinfo,
+                                             time_selection,cache));
+    StringArray outfiles;
+    child_processes processes;
+    for (int ch=0;ch<infiles.size();++ch)
+    {
+        String procoutfilename=get_temp_audio_file_name(procinfo.m_is_spectral ? "ana" : "wav");
+        remove_file_if_exists(procoutfilename);
+        StringArray procargs;
+        procargs.add(g_cdp_binaries_dir.getFullPathName()+"/"+procinfo.m_main_program);
+        procargs.add(procinfo.m_sub_program);
+        if (procinfo.m_mode.isEmpty()==false)
+            procargs.add(procinfo.m_mode);
+        procargs.add(infiles[ch]);
+        if (procinfo.m_is_spectral==false)
+            procargs.add("-f"+procoutfilename);
+        else
+            procargs.add(procoutfilename);
+        procargs.addArray(param_args);
+        outfiles.add(procoutfilename);
+        processes.add_and_start_task(procargs);
+    }
+    String prog_output=processes.wait_for_finished(g_max_child_process_wait_time,cancelled);
+    if (prog_output.isNotEmpty() || cancelled()==true)
+    {
+        cleaner.add_multiple(outfiles);
+        if (prog_output.isEmpty()==true)
+            prog_output="Cancelled";
+        return std::make_pair(String(),prog_output);
+    }
+    if (do_all_files_exist(outfiles)==false)
+    {
+        cleaner.add_multiple(outfiles);
+        return std::make_pair(String(),String("CDP returned success but a file or multiple files were not created"));
+    }
+    if (procinfo.m_is_spectral==true)
+    {
+        cleaner.add_multiple(outfiles);
+        auto resynth_result=do_pvoc_resynth(outfiles,cancelled);
+        if (resynth_result.second.isNotEmpty())
+            return std::make_pair(String(),"CDP pvoc resynthesis failed\n"+resynth_result.second);
+        outfiles=resynth_result.first;
+    }
+    if (outfiles.size()==1)
+        return std::make_pair(outfiles[0],String());
+    cleaner.add_multiple(outfiles);
+    auto merge_result=merge_split_files(outfiles);
+    if (merge_result.second.isNotEmpty())
+        return std::make_pair(String(),"CDP file merge failed\n"+merge_result.second);
+    return merge_result;
+}
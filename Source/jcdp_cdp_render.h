@@ -0,0 +1,69 @@
+/*
+This file is part of CDP Front-end.
+
+CDP front-end is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+CDP front-end is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef JCDP_CDP_RENDER_H
+#define JCDP_CDP_RENDER_H
+
+#include <functional>
+#include "JuceHeader.h"
+#include "jcdp_utilities.h"
+#include "jcdp_processor.h"
+#include "jcdp_breakpoints.h"
+
+// Milliseconds to wait for a CDP program before giving up
+extern int g_max_child_process_wait_time;
+
+// Where the temporary and rendered files go. Each target defines this : the front-end uses the
+// REAPER project folder or asks the user, the command line renderer uses the output folder.
+String get_audio_render_path();
+
+String get_temp_audio_file_name(String suffix="wav");
+
+// Sets the environment variables the CDP programs need
+void check_and_fix_environment();
+
+// These run the CDP programs and block until they have finished, they don't touch any GUI
+// state and can be called from any thread
+
+std::pair<String,String> cut_file(String infn, time_range trange, bool excise=false);
+String adjust_file_volume(String infn, double vol);
+String monoize_file(String infn);
+
+std::pair<StringArray,String> do_pvoc_analysis(StringArray infiles,int wsize, int olap,
+                                               std::function<bool()> should_cancel=nullptr);
+std::pair<StringArray, String> do_pvoc_resynth(StringArray infiles, std::function<bool()> should_cancel=nullptr);
+std::pair<StringArray,String> split_multichannel_file(String fn,audio_source_info info, file_cleaner& cleaner);
+std::pair<String,String> merge_split_files(StringArray infiles);
+
+String generate_cmd_argument(parameter_info& param,
+                             double inputfilelen,
+                             file_cleaner& cleaner,
+                             CDP_processor_info& procinfo,time_range time_selection,
+                             breakpoint_file_cache* cache=nullptr);
+
+// Processes the file with the processor's current parameters, splitting the channels and doing
+// the spectral analysis and resynthesis when the processor needs those. The input file should
+// already be cut and have the pre volume applied. If the file was cut from a longer source,
+// time_selection and source_length tell where, as the envelopes span the whole source.
+// Returns the rendered file, which the caller owns, or the error message. should_cancel is
+// polled between the CDP program runs.
+std::pair<String,String> render_cdp_file(CDP_processor_info& procinfo, String infile,
+                                         time_range time_selection, double source_length,
+                                         file_cleaner& cleaner, breakpoint_file_cache* cache=nullptr,
+                                         std::function<bool()> should_cancel=nullptr);
+
+#endif // JCDP_CDP_RENDER_H
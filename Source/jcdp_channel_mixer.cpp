@@ -0,0 +1,137 @@
+/*
+This file is part of CDP Front-end.
+
+CDP front-end is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+CDP front-end is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "jcdp_channel_mixer.h"
+
+channel_mixer::channel_mixer(int num_inputs, int num_outputs) :
+    m_num_inputs(num_inputs), m_num_outputs(num_outputs),
+    m_gains(num_inputs*num_outputs,0.0f)
+{
+}
+
+channel_mixer channel_mixer::make_default(int num_inputs, int num_outputs, channel_layout layout)
+{
+    channel_mixer result(num_inputs,num_outputs);
+    if (num_inputs<1 || num_outputs<1)
+        return result;
+    if (num_outputs==1)
+    {
+        // Via the stereo downmix, so that the surround formats get the same weighting
+        channel_mixer stereo=make_default(num_inputs,2,layout);
+        for (int i=0;i<num_inputs;++i)
+            result.set_gain(i,0,0.5f*(stereo.get_gain(i,0)+stereo.get_gain(i,1)));
+        return result;
+    }
+    const float minus3db=0.70710678f;
+    if (layout==channel_layout::ambisonic_foa && num_inputs>=4)
+    {
+        // Cardioids at +-90 degrees : 0.5*(W+Y) and 0.5*(W-Y). Higher orders are ignored.
+        result.set_gain(0,0,0.5f);
+        result.set_gain(1,0,0.5f);
+        result.set_gain(0,1,0.5f);
+        result.set_gain(1,1,-0.5f);
+        return result;
+    }
+    if (num_inputs==num_outputs)
+    {
+        for (int i=0;i<num_inputs;++i)
+            result.set_gain(i,i,1.0f);
+        return result;
+    }
+    if (num_inputs==1)
+    {
+        result.set_gain(0,0,1.0f);
+        result.set_gain(0,1,1.0f);
+        return result;
+    }
+    if (num_inputs==2)
+    {
+        result.set_gain(0,0,1.0f);
+        result.set_gain(1,1,1.0f);
+        return result;
+    }
+    if (num_outputs==2)
+    {
+        if (num_inputs==4)
+        {
+            // L R Ls Rs
+            result.set_gain(0,0,1.0f);
+            result.set_gain(1,1,1.0f);
+            result.set_gain(2,0,minus3db);
+            result.set_gain(3,1,minus3db);
+            return result;
+        }
+        if (num_inputs==6 || num_inputs==8)
+        {
+            // L R C LFE Ls Rs (Lside Rside), the LFE is dropped as usual
+            result.set_gain(0,0,1.0f);
+            result.set_gain(1,1,1.0f);
+            result.set_gain(2,0,minus3db);
+            result.set_gain(2,1,minus3db);
+            for (int i=4;i<num_inputs;i+=2)
+            {
+                result.set_gain(i,0,minus3db);
+                result.set_gain(i+1,1,minus3db);
+            }
+            return result;
+        }
+        // Anything else, like the multichannel rings CDP can produce, alternates between
+        // left and right, keeping the total power of each side
+        const int num_left=(num_inputs+1)/2;
+        const int num_right=num_inputs/2;
+        for (int i=0;i<num_inputs;++i)
+        {
+            if (i % 2 == 0)
+                result.set_gain(i,0,1.0f/std::sqrt((float)num_left));
+            else result.set_gain(i,1,1.0f/std::sqrt((float)num_right));
+        }
+        return result;
+    }
+    // Wrap the inputs around the outputs
+    for (int i=0;i<num_inputs;++i)
+        result.set_gain(i,i % num_outputs,1.0f);
+    return result;
+}
+
+void channel_mixer::process(const float* const* inputs, int num_inputs,
+                            float* const* outputs, int num_outputs, int num_samples) const
+{
+    const int num_ins=jmin(num_inputs,m_num_inputs);
+    for (int o=0;o<num_outputs;++o)
+    {
+        bool written=false;
+        if (o<m_num_outputs)
+        {
+            const float* gains=&m_gains[o*m_num_inputs];
+            for (int i=0;i<num_ins;++i)
+            {
+                if (gains[i]==0.0f)
+                    continue;
+                if (written==false)
+                {
+                    if (gains[i]==1.0f)
+                        FloatVectorOperations::copy(outputs[o],inputs[i],num_samples);
+                    else FloatVectorOperations::copyWithMultiply(outputs[o],inputs[i],gains[i],num_samples);
+                    written=true;
+                }
+                else FloatVectorOperations::addWithMultiply(outputs[o],inputs[i],gains[i],num_samples);
+            }
+        }
+        if (written==false)
+            FloatVectorOperations::clear(outputs[o],num_samples);
+    }
+}
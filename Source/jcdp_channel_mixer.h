@@ -0,0 +1,61 @@
+/*
+This file is part of CDP Front-end.
+
+CDP front-end is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+CDP front-end is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef JCDP_CHANNEL_MIXER_H
+#define JCDP_CHANNEL_MIXER_H
+
+#include <vector>
+#include "JuceHeader.h"
+
+// How the channels of a file are to be interpreted when mapping them to the outputs.
+// Files don't carry that information for the layouts CDP writes, so a 4 channel file
+// is for example taken as quad unless ambisonic_foa is asked for.
+enum class channel_layout
+{
+    automatic,
+    // First order B-format in ACN channel order (W, Y, Z, X) with SN3D normalization
+    ambisonic_foa
+};
+
+// Maps N input channels into M output channels with a gain matrix. Each output is built
+// with vectorized multiply-adds of whole blocks, skipping the zero gains.
+class channel_mixer
+{
+public:
+    channel_mixer() {}
+    // All gains are initially zero
+    channel_mixer(int num_inputs, int num_outputs);
+    // Identity when the channel counts match, otherwise the usual downmix or upmix for
+    // mono, stereo, quad, 5.1 and 7.1 (in the WAV channel order), or a pair of virtual
+    // cardioids pointing left and right for ambisonic input
+    static channel_mixer make_default(int num_inputs, int num_outputs,
+                                      channel_layout layout=channel_layout::automatic);
+    int get_num_inputs() const { return m_num_inputs; }
+    int get_num_outputs() const { return m_num_outputs; }
+    float get_gain(int input, int output) const { return m_gains[output*m_num_inputs+input]; }
+    void set_gain(int input, int output, float gain) { m_gains[output*m_num_inputs+input]=gain; }
+    // Writes (doesn't add to) num_outputs channels. Outputs beyond the matrix are cleared.
+    void process(const float* const* inputs, int num_inputs,
+                 float* const* outputs, int num_outputs, int num_samples) const;
+private:
+    int m_num_inputs=0;
+    int m_num_outputs=0;
+    // Output-major, so that one output's gains are contiguous
+    std::vector<float> m_gains;
+};
+
+#endif // JCDP_CHANNEL_MIXER_H
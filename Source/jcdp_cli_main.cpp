@@ -0,0 +1,320 @@
+/*
+This file is part of CDP Front-end.
+
+CDP front-end is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+CDP front-end is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Command line renderer : renders audio files with the front-end's CDP processors without
+// REAPER or a GUI, for bulk jobs and benchmarks. Shares the processor table and the render
+// engine with the front-end.
+
+#include <iostream>
+#include <map>
+#include <memory>
+#include "JuceHeader.h"
+
+#ifndef WIN32
+#include "stdlib.h"
+#include "swell-internal.h"
+#endif
+
+// The REAPER API function pointers are only declared here, they stay null as nothing
+// calls them outside of REAPER
+#define REAPERAPI_DECL
+#include "reaper_plugin_functions.h"
+
+#undef min
+#undef max
+
+#include "jcdp_utilities.h"
+#include "jcdp_processor_registry.h"
+#include "jcdp_cdp_render.h"
+#include "jcdp_render_engine.h"
+#include "jcdp_plugin_scanner.h"
+
+std::unique_ptr<AudioFormatManager> g_format_manager;
+std::unique_ptr<PropertiesFile> g_propsfile;
+File g_cdp_binaries_dir;
+
+static File g_output_dir;
+
+String get_audio_render_path()
+{
+    return g_output_dir.getFullPathName();
+}
+
+static void print_usage()
+{
+    std::cout << "Usage : jcdp_cli --processor <title> --out-dir <folder> [options] <input files...>\n"
+              << "  --list                    List the processors and their parameters\n"
+              << "  --param <name>=<value>    Set a parameter, can be repeated\n"
+              << "  --envelope <name>=<file>  Use a CDP breakpoint file for an automatable parameter\n"
+              << "  --jobs <n>                Number of parallel renders, the number of CPUs by default\n"
+              << "  --cdp-bin <folder>        Location of the CDP programs\n"
+              << "  --timings <file>          Write the per job timings JSON into the file instead of stdout\n";
+}
+
+static void print_processors(std::vector<CDP_processor_info>& procs)
+{
+    for (auto& proc : procs)
+    {
+        load_processor_parameters(proc);
+        std::cout << proc.m_title << (proc.m_is_spectral ? " (spectral)" : "") << "\n";
+        for (auto& par : proc.m_parameters)
+        {
+            std::cout << "    " << par.m_name << " : " << par.m_default_value
+                      << " [" << par.m_minimum_value << ".." << par.m_maximum_value << "]"
+                      << (par.m_can_automate ? " automatable" : "") << "\n";
+        }
+    }
+}
+
+static parameter_info* find_parameter(CDP_processor_info& proc, const String& name)
+{
+    for (auto& par : proc.m_parameters)
+        if (par.m_name.equalsIgnoreCase(name))
+            return &par;
+    return nullptr;
+}
+
+struct cli_job_result
+{
+    String m_input;
+    String m_output;
+    String m_error;
+    double m_seconds=0.0;
+    double m_audio_seconds=0.0;
+};
+
+// Inputs with the same name from different folders get a number after the name, so that
+// they don't overwrite each other's output
+static std::vector<File> make_output_files(const CDP_processor_info& proc, const StringArray& infiles)
+{
+    std::vector<File> result;
+    std::map<String,int> name_counts;
+    const String suffix="-"+proc.m_title.replaceCharacter(' ','_');
+    for (auto& infn : infiles)
+    {
+        String name=File(infn).getFileNameWithoutExtension();
+        // Not case sensitive, like the file systems of Windows and macOS
+        int count=++name_counts[name.toLowerCase()];
+        if (count>1)
+            name+="-"+String(count);
+        result.push_back(g_output_dir.getChildFile(name+suffix+".wav"));
+    }
+    return result;
+}
+
+static cli_job_result finish_job(String infn, const File& outfile, const cdp_render_result& render_result)
+{
+    cli_job_result result;
+    result.m_input=infn;
+    result.m_seconds=render_result.m_elapsed_seconds;
+    result.m_audio_seconds=get_audio_source_info(infn).get_length_seconds();
+    if (render_result.ok()==false)
+    {
+        result.m_error=render_result.m_error;
+        return result;
+    }
+    if (File(render_result.m_output_file).moveFileTo(outfile)==false)
+    {
+        remove_file_if_exists(render_result.m_output_file);
+        result.m_error="Could not move the rendered file to "+outfile.getFullPathName();
+    }
+    else
+        result.m_output=outfile.getFullPathName();
+    return result;
+}
+
+static var make_json(const String& proctitle, int numjobs, double total_seconds, const std::vector<cli_job_result>& results)
+{
+    DynamicObject::Ptr root=new DynamicObject;
+    root->setProperty("processor",proctitle);
+    root->setProperty("parallel_jobs",numjobs);
+    root->setProperty("total_seconds",total_seconds);
+    Array<var> jobs;
+    for (auto& e : results)
+    {
+        DynamicObject::Ptr job=new DynamicObject;
+        job->setProperty("input",e.m_input);
+        job->setProperty("output",e.m_output);
+        job->setProperty("ok",e.m_error.isEmpty());
+        if (e.m_error.isNotEmpty())
+            job->setProperty("error",e.m_error);
+        job->setProperty("seconds",e.m_seconds);
+        job->setProperty("audio_seconds",e.m_audio_seconds);
+        if (e.m_seconds>0.0)
+            job->setProperty("realtime_factor",e.m_audio_seconds/e.m_seconds);
+        jobs.add(var(job.get()));
+    }
+    root->setProperty("jobs",jobs);
+    return var(root.get());
+}
+
+int main(int argc, char** argv)
+{
+    ScopedJuceInitialiser_GUI juce_init;
+    check_and_fix_environment();
+    g_format_manager=jcdp::make_unique<AudioFormatManager>();
+    g_format_manager->registerBasicFormats();
+    // The front-end's settings are used as the defaults, but never written
+    PropertiesFile::Options poptions;
+    poptions.applicationName="JuceCDP";
+    poptions.folderName="JuceCDP";
+    poptions.commonToAllUsers=false;
+    poptions.doNotSave=true;
+    poptions.storageFormat=PropertiesFile::storeAsXML;
+    poptions.ignoreCaseOfKeyNames=false;
+    poptions.filenameSuffix=".xml";
+    poptions.osxLibrarySubFolder="Application Support";
+    g_propsfile=jcdp::make_unique<PropertiesFile>(poptions);
+    g_cdp_binaries_dir=File(g_propsfile->getValue("general/cdp_bin_loc"));
+    g_max_child_process_wait_time=1000*g_propsfile->getIntValue("cdp_max_wait",15);
+
+    auto procs=make_cdp_processors();
+    StringArray args;
+    for (int i=1;i<argc;++i)
+        args.add(CharPointer_UTF8(argv[i]));
+    String proctitle;
+    StringArray params;
+    StringArray envelopes;
+    StringArray infiles;
+    String timings_fn;
+    int numjobs=SystemStats::getNumCpus();
+    for (int i=0;i<args.size();++i)
+    {
+        const String& arg=args[i];
+        bool has_value=i+1<args.size();
+#ifdef CDP_VST_ENABLED
+        // Used by the front-end to scan plugins without risking its own process
+        if (arg=="--scan-plugin" && i+2<args.size())
+            return write_plugin_scan_result(args[i+1],File(args[i+2]));
+#endif
+        if (arg=="--list")
+        {
+            print_processors(procs);
+            return 0;
+        }
+        else if (arg=="--processor" && has_value)
+            proctitle=args[++i];
+        else if (arg=="--param" && has_value)
+            params.add(args[++i]);
+        else if (arg=="--envelope" && has_value)
+            envelopes.add(args[++i]);
+        else if (arg=="--out-dir" && has_value)
+            g_output_dir=File::getCurrentWorkingDirectory().getChildFile(args[++i]);
+        else if (arg=="--jobs" && has_value)
+            numjobs=jmax(1,args[++i].getIntValue());
+        else if (arg=="--cdp-bin" && has_value)
+            g_cdp_binaries_dir=File::getCurrentWorkingDirectory().getChildFile(args[++i]);
+        else if (arg=="--timings" && has_value)
+            timings_fn=args[++i];
+        else if (arg.startsWith("--"))
+        {
+            std::cerr << "Unknown option " << arg << "\n";
+            print_usage();
+            return 1;
+        }
+        else
+            infiles.add(File::getCurrentWorkingDirectory().getChildFile(arg).getFullPathName());
+    }
+    int procindex=index_of_processor(procs,proctitle);
+    if (procindex<0 || infiles.isEmpty()==true || g_output_dir==File())
+    {
+        if (proctitle.isNotEmpty() && procindex<0)
+            std::cerr << "No processor named " << proctitle << ", see --list\n";
+        print_usage();
+        return 1;
+    }
+    if (g_cdp_binaries_dir.isDirectory()==false)
+    {
+        std::cerr << "CDP programs not found, use --cdp-bin\n";
+        return 1;
+    }
+    if (g_output_dir.createDirectory().failed())
+    {
+        std::cerr << "Could not create " << g_output_dir.getFullPathName() << "\n";
+        return 1;
+    }
+    CDP_processor_info& proc=procs[procindex];
+    load_processor_parameters(proc);
+    if (proc.m_main_program.isEmpty()==true)
+    {
+        std::cerr << proc.m_title << " is not a CDP processor\n";
+        return 1;
+    }
+    for (auto& e : params)
+    {
+        parameter_info* par=find_parameter(proc,e.upToFirstOccurrenceOf("=",false,false));
+        if (par==nullptr)
+        {
+            std::cerr << "No parameter " << e << " in " << proc.m_title << "\n";
+            return 1;
+        }
+        double v=e.fromFirstOccurrenceOf("=",false,false).getDoubleValue();
+        par->m_current_value=jlimit(par->m_minimum_value,par->m_maximum_value,v);
+        if (par->m_current_value!=v)
+            std::cerr << par->m_name << " limited to " << par->m_current_value << "\n";
+    }
+    for (auto& e : envelopes)
+    {
+        parameter_info* par=find_parameter(proc,e.upToFirstOccurrenceOf("=",false,false));
+        if (par==nullptr || par->m_can_automate==false)
+        {
+            std::cerr << "No automatable parameter " << e << " in " << proc.m_title << "\n";
+            return 1;
+        }
+        File envfile=File::getCurrentWorkingDirectory().getChildFile(e.fromFirstOccurrenceOf("=",false,false));
+        if (envfile.existsAsFile()==false)
+        {
+            std::cerr << "Envelope file " << envfile.getFullPathName() << " not found\n";
+            return 1;
+        }
+        // CDP reads the breakpoint file as such, and it must not be removed after the render
+        String envarg=par->m_cmd_prefix+envfile.getFullPathName();
+        par->m_cmd_arg_formatter=[envarg](parameter_info*) { return std::make_pair(envarg,false); };
+    }
+
+    std::vector<File> outfiles=make_output_files(proc,infiles);
+    std::vector<cli_job_result> results;
+    double t0=Time::getMillisecondCounterHiRes();
+    {
+        cdp_render_engine engine(numjobs);
+        std::vector<std::future<cdp_render_result>> futures;
+        for (auto& infn : infiles)
+        {
+            cdp_render_request request;
+            request.m_processor=proc;
+            request.m_input_file=infn;
+            futures.push_back(engine.submit(std::move(request),nullptr,[infn](const cdp_render_result& result)
+            {
+                std::cerr << (result.ok() ? "Rendered " : "Failed ") << infn << "\n";
+            }));
+        }
+        for (int i=0;i<infiles.size();++i)
+            results.push_back(finish_job(infiles[i],outfiles[i],futures[i].get()));
+    }
+    // Every render has delivered its result, this only joins the idle threads
+    cdp_render_engine::wait_for_retired_engines();
+    double total_seconds=(Time::getMillisecondCounterHiRes()-t0)/1000.0;
+    String json=JSON::toString(make_json(proc.m_title,numjobs,total_seconds,results));
+    if (timings_fn.isNotEmpty())
+        File::getCurrentWorkingDirectory().getChildFile(timings_fn).replaceWithText(json);
+    else
+        std::cout << json << "\n";
+    for (auto& e : results)
+        if (e.m_error.isNotEmpty())
+            return 2;
+    return 0;
+}
@@ -0,0 +1,133 @@
+/*
+This file is part of CDP Front-end.
+
+CDP front-end is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+CDP front-end is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "jcdp_crossfade_source.h"
+#include <cmath>
+
+crossfade_pcm_source::~crossfade_pcm_source()
+{
+    delete m_source;
+    delete m_old_source;
+    for (auto e : m_finished)
+        delete e;
+}
+
+void crossfade_pcm_source::swap_source(PCM_source* src, double old_time, double new_time, double fade_seconds)
+{
+    // The audio thread only ever adds the one source being faded out, and must not allocate
+    m_finished.reserve(m_finished.size()+2);
+    // A fade that is still going on is cut short, only one old source is faded at a time
+    if (m_old_source!=nullptr)
+        m_finished.push_back(m_old_source);
+    m_old_source=nullptr;
+    if (m_source!=nullptr && fade_seconds>0.0)
+    {
+        m_old_source=m_source;
+        m_old_time_offset=old_time-new_time;
+        m_fade_length=fade_seconds;
+        m_fade_done=0.0;
+        // Enough for large preview blocks at high sample rates
+        const size_t old_samples_size=8192*(size_t)jmax(2,m_old_source->GetNumChannels(),src!=nullptr ? src->GetNumChannels() : 0);
+        if (m_old_samples.size()<old_samples_size)
+            m_old_samples.resize(old_samples_size);
+    }
+    else if (m_source!=nullptr)
+        m_finished.push_back(m_source);
+    m_source=src;
+}
+
+std::vector<PCM_source*> crossfade_pcm_source::take_finished_sources()
+{
+    // Cleared rather than swapped, the audio thread relies on the capacity reserved in swap_source
+    std::vector<PCM_source*> result(m_finished.begin(),m_finished.end());
+    m_finished.clear();
+    return result;
+}
+
+void crossfade_pcm_source::GetSamples(PCM_source_transfer_t* block)
+{
+    if (m_source==nullptr)
+    {
+        block->samples_out=0;
+        return;
+    }
+    m_source->GetSamples(block);
+    if (m_playhead!=nullptr)
+        m_playhead->publish({block->time_s,Time::getMillisecondCounterHiRes(),m_source->GetLength(),true,m_looped});
+    if (m_old_source==nullptr)
+        return;
+    const int nch=block->nch;
+    // The old source is read in chunks that fit the buffer sized in swap_source
+    const int chunk_frames=nch>0 ? (int)(m_old_samples.size()/nch) : 0;
+    // Silence where the new source ended early
+    for (int i=block->samples_out;i<block->length;++i)
+        for (int ch=0;ch<nch;++ch)
+            block->samples[i*nch+ch]=0.0;
+    // Equal power, as the sources are unrelated in general
+    const double fade_step=1.0/(m_fade_length*block->samplerate);
+    const double fade_start=m_fade_done/m_fade_length;
+    int faded_frames=0;
+    int old_frames_out=0;
+    for (int chunk_start=0;chunk_frames>0 && chunk_start<block->length;chunk_start+=chunk_frames)
+    {
+        if (fade_start+chunk_start*fade_step>=1.0)
+            break;
+        const int len=jmin(chunk_frames,block->length-chunk_start);
+        PCM_source_transfer_t old_block=*block;
+        old_block.time_s=block->time_s+m_old_time_offset+chunk_start/block->samplerate;
+        old_block.length=len;
+        old_block.samples=m_old_samples.data();
+        old_block.samples_out=0;
+        old_block.midi_events=nullptr;
+        m_old_source->GetSamples(&old_block);
+        // Silence where the old source ended early
+        for (int i=old_block.samples_out;i<len;++i)
+            for (int ch=0;ch<nch;++ch)
+                m_old_samples[i*nch+ch]=0.0;
+        if (old_block.samples_out>0)
+            old_frames_out=chunk_start+old_block.samples_out;
+        for (int i=0;i<len;++i)
+        {
+            const double fade_pos=fade_start+(chunk_start+i)*fade_step;
+            if (fade_pos>=1.0)
+                break;
+            const double angle=fade_pos*double_Pi*0.5;
+            const double gain_in=std::sin(angle);
+            const double gain_out=std::cos(angle);
+            for (int ch=0;ch<nch;++ch)
+            {
+                ReaSample& out=block->samples[(chunk_start+i)*nch+ch];
+                out=(ReaSample)(out*gain_in+m_old_samples[i*nch+ch]*gain_out);
+            }
+            faded_frames=chunk_start+i+1;
+        }
+    }
+    block->samples_out=jmax(block->samples_out,jmin(faded_frames,old_frames_out));
+    m_fade_done+=block->length/block->samplerate;
+    if (m_fade_done>=m_fade_length || chunk_frames==0)
+    {
+        m_finished.push_back(m_old_source);
+        m_old_source=nullptr;
+    }
+}
+
+void crossfade_pcm_source::GetPeakInfo(PCM_source_peaktransfer_t* block)
+{
+    if (m_source!=nullptr)
+        m_source->GetPeakInfo(block);
+    else block->peaks_out=0;
+}
@@ -0,0 +1,80 @@
+/*
+This file is part of CDP Front-end.
+
+CDP front-end is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+CDP front-end is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef JCDP_CROSSFADE_SOURCE_H
+#define JCDP_CROSSFADE_SOURCE_H
+
+#include <vector>
+#include "JuceHeader.h"
+#include "reaper_plugin.h"
+#include "jcdp_playhead.h"
+
+// PCM_source that stays registered for REAPER's preview playback while the sources it plays
+// are swapped underneath it. After a swap the previous source keeps playing from where it
+// was and is crossfaded out, so new renders come in without restarting or clicking.
+// Sources that are no longer played are only collected, never deleted, here : the owner
+// takes them with take_finished_sources() and deletes them outside the audio path.
+// All the methods must be called with the preview register's mutex held.
+class crossfade_pcm_source : public PCM_source
+{
+public:
+    crossfade_pcm_source(PCM_source* src) : m_source(src) {}
+    ~crossfade_pcm_source();
+    // Takes ownership of src. The old source continues from old_time while the new one
+    // continues from the preview's new position, which is new_time.
+    void swap_source(PCM_source* src, double old_time, double new_time, double fade_seconds);
+    PCM_source* get_current_source() const { return m_source; }
+    bool is_fading() const { return m_old_source!=nullptr; }
+    // Moves out the sources that are done playing
+    std::vector<PCM_source*> take_finished_sources();
+    // The position of each block requested by REAPER is published there
+    void set_playhead(playhead_publisher* playhead, bool looped) { m_playhead=playhead; m_looped=looped; }
+
+    PCM_source* Duplicate() { return m_source!=nullptr ? m_source->Duplicate() : nullptr; }
+    bool IsAvailable() { return m_source!=nullptr && m_source->IsAvailable(); }
+    const char* GetType() { return "CDPXFADE"; }
+    const char* GetFileName() { return m_source!=nullptr ? m_source->GetFileName() : nullptr; }
+    bool SetFileName(const char*) { return false; }
+    PCM_source* GetSource() { return m_source; }
+    int GetNumChannels() { return m_source!=nullptr ? m_source->GetNumChannels() : 0; }
+    double GetSampleRate() { return m_source!=nullptr ? m_source->GetSampleRate() : 0.0; }
+    double GetLength() { return m_source!=nullptr ? m_source->GetLength() : 0.0; }
+    int PropertiesWindow(HWND) { return 0; }
+    void GetSamples(PCM_source_transfer_t* block);
+    void GetPeakInfo(PCM_source_peaktransfer_t* block);
+    void SaveState(ProjectStateContext*) {}
+    int LoadState(const char*, ProjectStateContext*) { return -1; }
+    void Peaks_Clear(bool) {}
+    int PeaksBuild_Begin() { return 0; }
+    int PeaksBuild_Run() { return 0; }
+    void PeaksBuild_Finish() {}
+private:
+    PCM_source* m_source=nullptr;
+    PCM_source* m_old_source=nullptr;
+    // Added to the block times for reading the old source
+    double m_old_time_offset=0.0;
+    double m_fade_length=0.0;
+    double m_fade_done=0.0;
+    std::vector<PCM_source*> m_finished;
+    playhead_publisher* m_playhead=nullptr;
+    bool m_looped=false;
+    // Sized when swapping and never resized by the audio thread, which reads the old source
+    // in chunks that fit
+    std::vector<ReaSample> m_old_samples;
+};
+
+#endif // JCDP_CROSSFADE_SOURCE_H
@@ -19,7 +19,10 @@ along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
 #define JCDP_ENVELOPE_H
 
 #include <vector>
+#include <deque>
 #include <algorithm>
+#include <cstring>
+#include <cstdint>
 #include "JuceHeader.h"
 #include "jcdp_utilities.h"
 
@@ -28,7 +31,7 @@ struct envelope_node
     envelope_node()
         : Time(0.0), Value(0.0), Shape(0), Status(0),ShapeParam1(0.5), ShapeParam2(0.5) {}
     envelope_node(double x, double y, double p1=0.5, double p2=0.5)
-        : Time(x), Value(y),ShapeParam1(p1),ShapeParam2(p2) {}
+        : Time(x), Value(y), Shape(0), ShapeParam1(p1),ShapeParam2(p2), Status(0) {}
     double Time;
     double Value;
     int Shape;
@@ -171,6 +174,537 @@ inline double interpolate_foo(double atime,double t0, double v0, double t1, doub
     return v0+vdelta*get_shaped_value(((1.0/tdelta*(atime-t0))),0,p1,p2);
 }
 
+// Approximations of log2 and exp2 for evaluating the shaping curves in blocks.
+// The loops using these have no branches, so the compiler can vectorize them.
+// For bases in [0,1] and the exponents in [1,5] used by get_shaped_value, the
+// result of fast_pow_block is within about 1e-5 of pow.
+inline float fast_log2(float x)
+{
+    int32_t bits;
+    memcpy(&bits,&x,sizeof(bits));
+    const float e=(float)(((bits>>23)&255)-127);
+    bits=(bits&0x007fffff)|0x3f800000;
+    float m;
+    memcpy(&m,&bits,sizeof(m));
+    m-=1.0f;
+    // Chebyshev-fitted log2(1+m) for m in [0,1)
+    return e+m*(1.4424753f+m*(-0.71755787f+m*(0.45552707f+m*(-0.27462322f+m*(0.11929821f+m*-0.025123193f)))))
+            +2.1237463e-06f;
+}
+
+inline float fast_exp2(float y)
+{
+    y=std::max(y,-126.0f);
+    const int i=(int)y-(y<(int)y ? 1 : 0);
+    const float f=y-i;
+    const int32_t bits=(i+127)<<23;
+    float scale;
+    memcpy(&scale,&bits,sizeof(scale));
+    // Chebyshev-fitted 2^f for f in [0,1)
+    return scale*(0.99999990f+f*(0.69315462f+f*(0.24014077f+f*(0.055863282f+f*(0.0089462153f+f*0.0018951070f)))));
+}
+
+inline void fast_pow_block(float* buf, int n, float exponent)
+{
+    for (int i=0;i<n;++i)
+        buf[i]=fast_exp2(exponent*fast_log2(buf[i]));
+}
+
+// Applies the curve of get_shaped_value in place to segment positions in [0,1]
+inline void shape_block(float* buf, int n, double p1, double p2)
+{
+#ifndef BEZIER_EXPERIMENT
+    juce::ignoreUnused(p2);
+    if (p1<0.5)
+    {
+        const float exponent=(float)(1.0+(1.0-(p1*2.0))*4.0);
+        FloatVectorOperations::negate(buf,buf,n);
+        FloatVectorOperations::add(buf,1.0f,n);
+        fast_pow_block(buf,n,exponent);
+        FloatVectorOperations::negate(buf,buf,n);
+        FloatVectorOperations::add(buf,1.0f,n);
+    }
+    else if (p1>0.5)
+    {
+        fast_pow_block(buf,n,(float)(1.0+(p1-0.5)*2.0*4.0));
+    }
+#else
+    for (int i=0;i<n;++i)
+        buf[i]=get_shaped_value(buf[i],0,p1,p2);
+#endif
+}
+
+// Storage of the nodes of a breakpoint_envelope as separate arrays. Searching by time only
+// reads the contiguous times, and the shape parameters are stored as floats, so a node takes
+// 24 bytes instead of the 48 bytes of envelope_node. The Shape and Status fields of
+// envelope_node aren't stored.
+class envelope_node_arrays
+{
+public:
+    int size() const { return m_times.size(); }
+    bool empty() const { return m_times.empty(); }
+    double time(int i) const { return m_times[i]; }
+    double value(int i) const { return m_values[i]; }
+    double shape_p1(int i) const { return m_shape_p1[i]; }
+    double shape_p2(int i) const { return m_shape_p2[i]; }
+    const std::vector<double>& times() const { return m_times; }
+    const std::vector<double>& values() const { return m_values; }
+    envelope_node get(int i) const
+    {
+        envelope_node node(m_times[i],m_values[i],m_shape_p1[i],m_shape_p2[i]);
+        return node;
+    }
+    void set(int i, const envelope_node& node)
+    {
+        m_times[i]=node.Time;
+        m_values[i]=node.Value;
+        m_shape_p1[i]=(float)node.ShapeParam1;
+        m_shape_p2[i]=(float)node.ShapeParam2;
+    }
+    void set_time(int i, double t) { m_times[i]=t; }
+    void set_value(int i, double v) { m_values[i]=v; }
+    void push_back(const envelope_node& node)
+    {
+        m_times.push_back(node.Time);
+        m_values.push_back(node.Value);
+        m_shape_p1.push_back((float)node.ShapeParam1);
+        m_shape_p2.push_back((float)node.ShapeParam2);
+    }
+    void insert(int i, const nodes_t& nodes)
+    {
+        std::vector<double> times(nodes.size());
+        std::vector<double> values(nodes.size());
+        std::vector<float> shape_p1(nodes.size());
+        std::vector<float> shape_p2(nodes.size());
+        for (size_t j=0;j<nodes.size();++j)
+        {
+            times[j]=nodes[j].Time;
+            values[j]=nodes[j].Value;
+            shape_p1[j]=(float)nodes[j].ShapeParam1;
+            shape_p2[j]=(float)nodes[j].ShapeParam2;
+        }
+        m_times.insert(m_times.begin()+i,times.begin(),times.end());
+        m_values.insert(m_values.begin()+i,values.begin(),values.end());
+        m_shape_p1.insert(m_shape_p1.begin()+i,shape_p1.begin(),shape_p1.end());
+        m_shape_p2.insert(m_shape_p2.begin()+i,shape_p2.begin(),shape_p2.end());
+    }
+    void insert(int i, const envelope_node& node)
+    {
+        m_times.insert(m_times.begin()+i,node.Time);
+        m_values.insert(m_values.begin()+i,node.Value);
+        m_shape_p1.insert(m_shape_p1.begin()+i,(float)node.ShapeParam1);
+        m_shape_p2.insert(m_shape_p2.begin()+i,(float)node.ShapeParam2);
+    }
+    // Erases the nodes with indices in [first, last)
+    void erase(int first, int last)
+    {
+        m_times.erase(m_times.begin()+first,m_times.begin()+last);
+        m_values.erase(m_values.begin()+first,m_values.begin()+last);
+        m_shape_p1.erase(m_shape_p1.begin()+first,m_shape_p1.begin()+last);
+        m_shape_p2.erase(m_shape_p2.begin()+first,m_shape_p2.begin()+last);
+    }
+    // std::rotate of the nodes in [first, last) so that middle becomes first
+    void rotate(int first, int middle, int last)
+    {
+        std::rotate(m_times.begin()+first,m_times.begin()+middle,m_times.begin()+last);
+        std::rotate(m_values.begin()+first,m_values.begin()+middle,m_values.begin()+last);
+        std::rotate(m_shape_p1.begin()+first,m_shape_p1.begin()+middle,m_shape_p1.begin()+last);
+        std::rotate(m_shape_p2.begin()+first,m_shape_p2.begin()+middle,m_shape_p2.begin()+last);
+    }
+    // Moves the node at index from to index to, shifting the nodes between
+    void move(int from, int to)
+    {
+        if (to<from)
+            rotate(to,from,from+1);
+        else if (to>from)
+            rotate(from,from+1,to+1);
+    }
+    void clear()
+    {
+        m_times.clear();
+        m_values.clear();
+        m_shape_p1.clear();
+        m_shape_p2.clear();
+    }
+    void reserve(int n)
+    {
+        m_times.reserve(n);
+        m_values.reserve(n);
+        m_shape_p1.reserve(n);
+        m_shape_p2.reserve(n);
+    }
+    void assign(const nodes_t& nodes)
+    {
+        clear();
+        reserve(nodes.size());
+        for (auto& e : nodes)
+            push_back(e);
+    }
+    nodes_t to_nodes() const
+    {
+        nodes_t result;
+        result.reserve(size());
+        for (int i=0;i<size();++i)
+            result.push_back(get(i));
+        return result;
+    }
+    // Index of the first node with time not less than t
+    int lower_bound(double t) const
+    {
+        return lower_bound_in(0,size(),t);
+    }
+    int lower_bound_in(int first, int last, double t) const
+    {
+        return std::lower_bound(m_times.begin()+first,m_times.begin()+last,t)-m_times.begin();
+    }
+    // Index of the first node with time greater than t
+    int upper_bound_in(int first, int last, double t) const
+    {
+        return std::upper_bound(m_times.begin()+first,m_times.begin()+last,t)-m_times.begin();
+    }
+    bool is_sorted() const
+    {
+        return std::is_sorted(m_times.begin(),m_times.end());
+    }
+    // Stable sort by time
+    void sort()
+    {
+        std::vector<int> order(size());
+        for (int i=0;i<size();++i)
+            order[i]=i;
+        std::stable_sort(order.begin(),order.end(),[this](int a, int b) { return m_times[a]<m_times[b]; });
+        apply_order(m_times,order);
+        apply_order(m_values,order);
+        apply_order(m_shape_p1,order);
+        apply_order(m_shape_p2,order);
+    }
+    size_t memory_size() const
+    {
+        return m_times.capacity()*sizeof(double)+m_values.capacity()*sizeof(double)+
+                m_shape_p1.capacity()*sizeof(float)+m_shape_p2.capacity()*sizeof(float);
+    }
+private:
+    template<typename T>
+    static void apply_order(std::vector<T>& v, const std::vector<int>& order)
+    {
+        std::vector<T> sorted(v.size());
+        for (size_t i=0;i<order.size();++i)
+            sorted[i]=v[order[i]];
+        v.swap(sorted);
+    }
+    std::vector<double> m_times;
+    std::vector<double> m_values;
+    std::vector<float> m_shape_p1;
+    std::vector<float> m_shape_p2;
+};
+
+// Undo history for the edits of a breakpoint_envelope. Edits are stored as the nodes they
+// inserted, erased or moved, not as copies of the whole envelope, so recording, undoing and
+// redoing an edit costs about as much as the edit itself. Edits are grouped into steps, like a
+// whole mouse drag, which are undone together, and consecutive moves of the same node in a
+// step are merged. The nodes of all the edits are kept in one arena, and the oldest steps are
+// dropped when the history uses more than the memory limit.
+class envelope_edit_history
+{
+public:
+    envelope_edit_history(size_t memory_limit=16*1024*1024) : m_memory_limit(memory_limit) {}
+    // The edits belong to the nodes of one envelope, so copies of the envelope, like the ones
+    // made for every render request, start with an empty history instead of copying it
+    envelope_edit_history(const envelope_edit_history& other) : m_memory_limit(other.m_memory_limit) {}
+    envelope_edit_history& operator=(const envelope_edit_history& other)
+    {
+        if (this!=&other)
+        {
+            clear();
+            m_memory_limit=other.m_memory_limit;
+        }
+        return *this;
+    }
+    envelope_edit_history(envelope_edit_history&&)=default;
+    envelope_edit_history& operator=(envelope_edit_history&&)=default;
+    void set_memory_limit(size_t bytes)
+    {
+        m_memory_limit=bytes;
+        drop_old_steps();
+    }
+    size_t get_memory_usage() const
+    {
+        return m_arena.size()*sizeof(stored_node)+m_edits.size()*sizeof(edit);
+    }
+    bool is_recording() const { return m_recording; }
+    // Starts a new step. The steps that were undone are only discarded by the first edit
+    // recorded, so a step without edits, like a click that just selects, keeps the redo history.
+    void begin_step()
+    {
+        ++m_step_counter;
+        m_recording=true;
+    }
+    void end_step()
+    {
+        m_recording=false;
+        drop_old_steps();
+    }
+    void clear()
+    {
+        m_edits.clear();
+        m_arena.clear();
+        m_arena_base=0;
+        m_position=0;
+    }
+    bool can_undo() const { return m_position>0; }
+    bool can_redo() const { return m_position<m_edits.size(); }
+    // Records nodes inserted at indices [index, index+count), read from the nodes after the insertion
+    void record_insert(const envelope_node_arrays& nodes, int index, int count)
+    {
+        if (count>0)
+            add_edit(et_insert,index,index,nodes,count);
+    }
+    // Records erasing the nodes at [index, index+count), read from the nodes before the erase
+    void record_erase(const envelope_node_arrays& nodes, int index, int count)
+    {
+        if (count>0)
+            add_edit(et_erase,index,index,nodes,count);
+    }
+    // Records a node changed from old_node to new_node, moving from index from to index to
+    void record_move(int from, int to, const envelope_node& old_node, const envelope_node& new_node)
+    {
+        jassert(m_recording==true);
+        discard_redo();
+        if (m_edits.empty()==false)
+        {
+            edit& last=m_edits.back();
+            if (last.m_step==m_step_counter && last.m_type==et_move && last.m_to==from)
+            {
+                last.m_to=to;
+                m_arena.back()=stored_node(new_node);
+                return;
+            }
+        }
+        m_edits.push_back({ et_move,m_step_counter,from,to,m_arena_base+m_arena.size(),2 });
+        m_arena.push_back(stored_node(old_node));
+        m_arena.push_back(stored_node(new_node));
+        m_position=m_edits.size();
+    }
+    // Reverts the edits of the last step. Returns false if there was nothing to undo.
+    bool undo(envelope_node_arrays& nodes)
+    {
+        if (can_undo()==false)
+            return false;
+        const int64_t step=m_edits[m_position-1].m_step;
+        while (m_position>0 && m_edits[m_position-1].m_step==step)
+        {
+            --m_position;
+            revert(m_edits[m_position],nodes);
+        }
+        return true;
+    }
+    bool redo(envelope_node_arrays& nodes)
+    {
+        if (can_redo()==false)
+            return false;
+        const int64_t step=m_edits[m_position].m_step;
+        while (m_position<m_edits.size() && m_edits[m_position].m_step==step)
+        {
+            apply(m_edits[m_position],nodes);
+            ++m_position;
+        }
+        return true;
+    }
+private:
+    enum edit_type { et_insert, et_erase, et_move };
+    struct stored_node
+    {
+        stored_node(const envelope_node& node)
+            : m_time(node.Time), m_value(node.Value), m_shape_p1((float)node.ShapeParam1),
+              m_shape_p2((float)node.ShapeParam2) {}
+        envelope_node get() const { return envelope_node(m_time,m_value,m_shape_p1,m_shape_p2); }
+        double m_time;
+        double m_value;
+        float m_shape_p1;
+        float m_shape_p2;
+    };
+    struct edit
+    {
+        edit_type m_type;
+        int64_t m_step;
+        int m_from;
+        int m_to;
+        // Absolute position of the edit's nodes in the arena, and their count
+        int64_t m_first_node;
+        int m_num_nodes;
+    };
+    void add_edit(edit_type type, int from, int to, const envelope_node_arrays& nodes, int count)
+    {
+        jassert(m_recording==true);
+        discard_redo();
+        m_edits.push_back({ type,m_step_counter,from,to,m_arena_base+m_arena.size(),count });
+        for (int i=from;i<from+count;++i)
+            m_arena.push_back(stored_node(nodes.get(i)));
+        m_position=m_edits.size();
+    }
+    const stored_node& node_of(const edit& e, int i) const
+    {
+        return m_arena[e.m_first_node-m_arena_base+i];
+    }
+    nodes_t nodes_of(const edit& e) const
+    {
+        nodes_t result;
+        result.reserve(e.m_num_nodes);
+        for (int i=0;i<e.m_num_nodes;++i)
+            result.push_back(node_of(e,i).get());
+        return result;
+    }
+    void apply(const edit& e, envelope_node_arrays& nodes) const
+    {
+        if (e.m_type==et_insert)
+            nodes.insert(e.m_from,nodes_of(e));
+        else if (e.m_type==et_erase)
+            nodes.erase(e.m_from,e.m_from+e.m_num_nodes);
+        else
+        {
+            nodes.set(e.m_from,node_of(e,1).get());
+            nodes.move(e.m_from,e.m_to);
+        }
+    }
+    void revert(const edit& e, envelope_node_arrays& nodes) const
+    {
+        if (e.m_type==et_insert)
+            nodes.erase(e.m_from,e.m_from+e.m_num_nodes);
+        else if (e.m_type==et_erase)
+            nodes.insert(e.m_from,nodes_of(e));
+        else
+        {
+            nodes.set(e.m_to,node_of(e,0).get());
+            nodes.move(e.m_to,e.m_from);
+        }
+    }
+    void discard_redo()
+    {
+        while (m_edits.size()>m_position)
+        {
+            m_arena.erase(m_arena.end()-m_edits.back().m_num_nodes,m_arena.end());
+            m_edits.pop_back();
+        }
+    }
+    // Drops whole steps from the start, never the latest step
+    void drop_old_steps()
+    {
+        while (get_memory_usage()>m_memory_limit && m_position>0 &&
+               m_edits.front().m_step!=m_edits[m_position-1].m_step)
+        {
+            const int64_t step=m_edits.front().m_step;
+            while (m_edits.front().m_step==step)
+            {
+                m_arena.erase(m_arena.begin(),m_arena.begin()+m_edits.front().m_num_nodes);
+                m_arena_base+=m_edits.front().m_num_nodes;
+                m_edits.pop_front();
+                --m_position;
+            }
+        }
+    }
+    std::deque<edit> m_edits;
+    std::deque<stored_node> m_arena;
+    int64_t m_arena_base=0;
+    size_t m_position=0; // edits before this have been applied, the rest can be redone
+    int64_t m_step_counter=0;
+    size_t m_memory_limit=0;
+    bool m_recording=false;
+};
+
+// Evaluates nodes at monotonically increasing times, giving the same results as
+// GetInterpolatedNodeValue. The cursor remembers the segment it is in, so the nodes
+// are only searched when the evaluation time moves past the end of the segment.
+// The nodes must not be changed while the cursor is in use.
+class envelope_cursor
+{
+public:
+    envelope_cursor(const envelope_node_arrays& nodes, double defvalue=0.5)
+        : m_nodes(nodes), m_defvalue(defvalue) {}
+    // Must be called before evaluating a time earlier than the previous one
+    void reset() { m_next=0; }
+    double value_at(double atime)
+    {
+        const int numnodes=m_nodes.size();
+        if (numnodes==0)
+            return m_defvalue;
+        if (numnodes==1 || atime<=m_nodes.time(0))
+            return m_nodes.value(0);
+        if (atime>m_nodes.time(numnodes-1))
+            return m_nodes.value(numnodes-1);
+        advance(atime);
+        const int i=m_next-1;
+        return interpolate_foo(atime,m_nodes.time(i),m_nodes.value(i),m_nodes.time(i+1),m_nodes.value(i+1),
+                               m_nodes.shape_p1(i),m_nodes.shape_p2(i));
+    }
+    // Fills dest with the values at t0, t0+dt, t0+2*dt...
+    void evaluate_block(double t0, double dt, float* dest, int n)
+    {
+        jassert(dt>0.0);
+        const int numnodes=m_nodes.size();
+        if (numnodes<2 || dt<=0.0)
+        {
+            FloatVectorOperations::fill(dest,(float)value_at(t0),n);
+            return;
+        }
+        const double first_time=m_nodes.time(0);
+        const double last_time=m_nodes.time(numnodes-1);
+        int i=0;
+        while (i<n && t0+dt*i<=first_time)
+            dest[i++]=(float)m_nodes.value(0);
+        while (i<n)
+        {
+            const double atime=t0+dt*i;
+            if (atime>last_time)
+            {
+                FloatVectorOperations::fill(dest+i,(float)m_nodes.value(numnodes-1),n-i);
+                break;
+            }
+            advance(atime);
+            const int seg=m_next-1;
+            const double seg_t0=m_nodes.time(seg);
+            const double seg_t1=m_nodes.time(seg+1);
+            const double seg_v0=m_nodes.value(seg);
+            const double seg_v1=m_nodes.value(seg+1);
+            // All the following times up to the end node of the segment are in this segment
+            int seg_end=(int)std::min<double>(n,std::floor((seg_t1-t0)/dt)+1.0);
+            if (seg_end<=i)
+                seg_end=i+1;
+            const int count=seg_end-i;
+            const double tdelta=std::max(seg_t1-seg_t0,0.00001);
+            for (int j=i;j<seg_end;++j)
+                dest[j]=(float)((t0+dt*j-seg_t0)/tdelta);
+            FloatVectorOperations::clip(dest+i,dest+i,0.0f,1.0f,count);
+            shape_block(dest+i,count,m_nodes.shape_p1(seg),m_nodes.shape_p2(seg));
+            FloatVectorOperations::multiply(dest+i,(float)(seg_v1-seg_v0),count);
+            FloatVectorOperations::add(dest+i,(float)seg_v0,count);
+#if JUCE_DEBUG
+            // Check the shaping approximation against the exact curve
+            for (int j : { i, seg_end-1 })
+                jassert(std::abs(dest[j]-interpolate_foo(t0+dt*j,seg_t0,seg_v0,seg_t1,seg_v1,
+                                                         m_nodes.shape_p1(seg),m_nodes.shape_p2(seg)))<1e-4);
+#endif
+            i=seg_end;
+        }
+    }
+private:
+    void advance(double atime)
+    {
+        // Nodes are only searched when leaving the current segment, which is usually
+        // into the next one
+        const int numnodes=m_nodes.size();
+        jassert(m_next==0 || m_nodes.time(m_next-1)<atime);
+        if (m_next<numnodes && m_nodes.time(m_next)<atime)
+        {
+            ++m_next;
+            if (m_next<numnodes && m_nodes.time(m_next)<atime)
+                m_next=m_nodes.lower_bound_in(m_next,numnodes,atime);
+        }
+    }
+    const envelope_node_arrays& m_nodes;
+    double m_defvalue=0.5;
+    int m_next=0;
+};
+
 class breakpoint_envelope
 {
 public:
@@ -193,7 +727,9 @@ public:
     int GetDefShape() { return m_defshape; }
     int GetNumNodes() const { return m_nodes.size(); }
     void SetDefShape(int value) { m_defshape=value; }
-    const std::vector<envelope_node>& get_all_nodes() const { return m_nodes; }
+    // Copies the nodes out of the arrays, get_node_arrays avoids the copy
+    nodes_t get_all_nodes() const { return m_nodes.to_nodes(); }
+    const envelope_node_arrays& get_node_arrays() const { return m_nodes; }
     //void set_all_nodes(nodes_t& nds) { m_nodes=nds; }
     void set_reset_nodes(const std::vector<envelope_node>& nodes, bool convertvalues=false)
     {
@@ -210,13 +746,17 @@ public:
                     node.Value=scaled_to_normalized_func(node.Value);
                     m_nodes.push_back(node);
                 }
+                m_history.clear();
+                ++m_revision;
             }
         }
     }
     void ResetEnvelope()
     {
-        m_nodes=m_reset_nodes;
+        m_nodes.assign(m_reset_nodes);
         m_playoffset=0.0;
+        m_history.clear();
+        ++m_revision;
     }
     int GetColor()
     {
@@ -235,43 +775,115 @@ public:
         m_updateopinprogress=false;
         SortNodes();
     }
-    void AddNode(envelope_node newnode)
+    // Returns the index of the new node, which goes after any existing nodes at the same time.
+    // During an update the node is appended and the index is only valid until EndUpdate.
+    int AddNode(envelope_node newnode)
     {
-        m_nodes.push_back(newnode);
-        if (!m_updateopinprogress)
-            SortNodes();
+        ++m_revision;
+        if (m_updateopinprogress)
+        {
+            m_history.clear();
+            m_nodes.push_back(newnode);
+            return m_nodes.size()-1;
+        }
+        const int index=m_nodes.upper_bound_in(0,m_nodes.size(),newnode.Time);
+        m_nodes.insert(index,newnode);
+        if (should_record_edit())
+            m_history.record_insert(m_nodes,index,1);
+        return index;
+    }
+    // Merges the nodes into the envelope. They don't need to be sorted.
+    void insert_nodes(nodes_t nodes)
+    {
+        if (nodes.empty())
+            return;
+        ++m_revision;
+        if (m_updateopinprogress)
+        {
+            m_history.clear();
+            for (auto& e : nodes)
+                m_nodes.push_back(e);
+            return;
+        }
+        std::stable_sort(nodes.begin(),nodes.end());
+        envelope_node_arrays merged;
+        merged.reserve(m_nodes.size()+nodes.size());
+        std::vector<int> inserted_indices;
+        const bool record=should_record_edit();
+        int i=0;
+        size_t j=0;
+        while (i<m_nodes.size() || j<nodes.size())
+        {
+            // Existing nodes go before new nodes at the same time
+            if (j==nodes.size() || (i<m_nodes.size() && m_nodes.time(i)<=nodes[j].Time))
+                merged.push_back(m_nodes.get(i++));
+            else
+            {
+                if (record==true)
+                    inserted_indices.push_back(merged.size());
+                merged.push_back(nodes[j++]);
+            }
+        }
+        std::swap(m_nodes,merged);
+        // Runs of adjacent new nodes are recorded as one insert
+        for (size_t k=0;k<inserted_indices.size();)
+        {
+            size_t run=1;
+            while (k+run<inserted_indices.size() && inserted_indices[k+run]==inserted_indices[k]+(int)run)
+                ++run;
+            m_history.record_insert(m_nodes,inserted_indices[k],run);
+            k+=run;
+        }
     }
     void ClearAllNodes()
     {
+        if (should_record_edit())
+            m_history.record_erase(m_nodes,0,m_nodes.size());
         m_nodes.clear();
+        ++m_revision;
     }
     void DeleteNode(int indx)
     {
         if (indx<0 || indx>m_nodes.size()-1)
             return;
-        m_nodes.erase(m_nodes.begin()+indx);
+        if (should_record_edit())
+            m_history.record_erase(m_nodes,indx,1);
+        m_nodes.erase(indx,indx+1);
+        ++m_revision;
     }
-    void delete_nodes_in_time_range(double t0, double t1)
+    // Deletes the nodes with indices in [first, last)
+    void delete_nodes(int first, int last)
     {
-        m_nodes.erase(std::remove_if(std::begin(m_nodes),
-                                       std::end(m_nodes),
-                                       [t0,t1](const envelope_node& a) { return a.Time>=t0 && a.Time<=t1; } ),
-                                       std::end(m_nodes) );
+        first=bound_value(0,first,(int)m_nodes.size());
+        last=bound_value(first,last,(int)m_nodes.size());
+        if (first==last)
+            return;
+        if (should_record_edit())
+            m_history.record_erase(m_nodes,first,last-first);
+        m_nodes.erase(first,last);
+        ++m_revision;
     }
-
-    envelope_node& GetNodeAtIndex(int indx)
+    void delete_nodes_in_time_range(double t0, double t1)
     {
-        if (m_nodes.size()==0)
+        if (m_updateopinprogress)
         {
-            throw(std::length_error("Empty envelope accessed"));
+            m_history.clear();
+            for (int i=m_nodes.size()-1;i>=0;--i)
+                if (m_nodes.time(i)>=t0 && m_nodes.time(i)<=t1)
+                    m_nodes.erase(i,i+1);
+            ++m_revision;
+            return;
         }
-        if (indx<0)
-            indx=0;
-        if (indx>=m_nodes.size())
-            indx=m_nodes.size()-1;
-        return m_nodes[indx];
+        const int first=m_nodes.lower_bound(t0);
+        const int last=m_nodes.upper_bound_in(first,m_nodes.size(),t1);
+        delete_nodes(first,last);
     }
-    const envelope_node& GetNodeAtIndex(int indx) const
+    // Incremented by every operation that changes the nodes, so that views can
+    // tell if their cached data about the envelope is stale
+    int get_revision() const { return m_revision; }
+
+    // Returns a copy of the node, modifications are done with SetNode or move_node
+    envelope_node GetNodeAtIndex(int indx) const
     {
         if (m_nodes.size()==0)
         {
@@ -281,33 +893,64 @@ public:
             indx=0;
         if (indx>=m_nodes.size())
             indx=m_nodes.size()-1;
-        return m_nodes[indx];
+        return m_nodes.get(indx);
     }
-    void SetNodeStatus(int indx, int nstatus)
+    void SetNode(int indx, envelope_node anode)
     {
         int i=indx;
         if (indx<0) i=0;
         if (indx>m_nodes.size()-1) i=m_nodes.size()-1;
-        m_nodes[i].Status=nstatus;
+        if (should_record_edit())
+            m_history.record_move(i,i,m_nodes.get(i),anode);
+        m_nodes.set(i,anode);
+        ++m_revision;
     }
-    void SetNode(int indx, envelope_node anode)
+    // Replaces the node and moves it to its sorted position among the other nodes,
+    // shifting only the nodes it passes over. Returns the new index of the node.
+    int move_node(int indx, envelope_node anode)
     {
-        int i=indx;
-        if (indx<0) i=0;
-        if (indx>m_nodes.size()-1) i=m_nodes.size()-1;
-        m_nodes[i]=anode;
+        if (m_nodes.empty())
+            return -1;
+        indx=bound_value(0,indx,(int)m_nodes.size()-1);
+        const envelope_node old_node=m_nodes.get(indx);
+        m_nodes.set(indx,anode);
+        ++m_revision;
+        if (m_updateopinprogress)
+        {
+            m_history.clear();
+            return indx;
+        }
+        int dest=m_nodes.upper_bound_in(0,indx,anode.Time);
+        if (dest==indx)
+            dest=m_nodes.lower_bound_in(indx+1,m_nodes.size(),anode.Time)-1;
+        m_nodes.move(indx,dest);
+        if (should_record_edit())
+            m_history.record_move(indx,dest,old_node,anode);
+        return dest;
     }
     void SetNodeTimeValue(int indx,bool setTime,bool setValue,double atime,double avalue)
     {
         int i=indx;
         if (indx<0) i=0;
         if (indx>m_nodes.size()-1) i=m_nodes.size()-1;
-        if (setTime) m_nodes[i].Time=atime;
-        if (setValue) m_nodes[i].Value=avalue;
+        const envelope_node old_node=m_nodes.get(i);
+        if (setTime) m_nodes.set_time(i,atime);
+        if (setValue) m_nodes.set_value(i,avalue);
+        if (should_record_edit())
+            m_history.record_move(i,i,old_node,m_nodes.get(i));
+        ++m_revision;
     }
 
-
-    double GetInterpolatedNodeValue(double atime)
+    envelope_cursor make_cursor() const
+    {
+        return envelope_cursor(m_nodes,m_defvalue);
+    }
+    // Fills dest with the values at t0, t0+dt, t0+2*dt...
+    void evaluate_block(double t0, double dt, float* dest, int n) const
+    {
+        make_cursor().evaluate_block(t0,dt,dest,n);
+    }
+    double GetInterpolatedNodeValue(double atime) const
     {
         double t0=0.0;
         double t1=0.0;
@@ -319,85 +962,86 @@ public:
         if (m_nodes.size()==0)
             return m_defvalue;
         if (m_nodes.size()==1)
-            return m_nodes[0].Value;
-        if (atime<=m_nodes[0].Time)
+            return m_nodes.value(0);
+        if (atime<=m_nodes.time(0))
         {
 #ifdef INTERPOLATING_ENVELOPE_BORDERS
-            t1=m_nodes[0].Time;
-            t0=0.0-(1.0-m_nodes[maxnodeind].Time);
-            v0=m_nodes[maxnodeind].Value;
-            p1=m_nodes[maxnodeind].ShapeParam1;
-            p2=m_nodes[maxnodeind].ShapeParam2;
-            v1=m_nodes[0].Value;
+            t1=m_nodes.time(0);
+            t0=0.0-(1.0-m_nodes.time(maxnodeind));
+            v0=m_nodes.value(maxnodeind);
+            p1=m_nodes.shape_p1(maxnodeind);
+            p2=m_nodes.shape_p2(maxnodeind);
+            v1=m_nodes.value(0);
             return interpolate_foo(atime,t0,v0,t1,v1,p1,p2);
 #else
-            return m_nodes[0].Value;
+            return m_nodes.value(0);
 #endif
         }
-        if (atime>m_nodes[maxnodeind].Time)
+        if (atime>m_nodes.time(maxnodeind))
         {
 #ifdef INTERPOLATING_ENVELOPE_BORDERS
-            t0=m_nodes[maxnodeind].Time;
-            t1=1.0+(m_nodes[0].Time);
-            v0=m_nodes[maxnodeind].Value;
-            v1=m_nodes[0].Value;
-            p1=m_nodes[maxnodeind].ShapeParam1;
-            p2=m_nodes[maxnodeind].ShapeParam2;
+            t0=m_nodes.time(maxnodeind);
+            t1=1.0+(m_nodes.time(0));
+            v0=m_nodes.value(maxnodeind);
+            v1=m_nodes.value(0);
+            p1=m_nodes.shape_p1(maxnodeind);
+            p2=m_nodes.shape_p2(maxnodeind);
             return interpolate_foo(atime,t0,v0,t1,v1,p1,p2);
 #else
-            return m_nodes.back().Value;
+            return m_nodes.value(maxnodeind);
 #endif
         }
-        const envelope_node to_search(atime,0.0);
-        //to_search.Time=atime;
-        auto it=std::lower_bound(m_nodes.begin(),m_nodes.end(),to_search,
-                                 [](const envelope_node& a, const envelope_node& b)
-        { return a.Time<b.Time; } );
-        if (it==m_nodes.end())
-        {
-            return m_defvalue;
-        }
-        --it; // lower_bound has returned iterator to point one too far
-        t0=it->Time;
-        v0=it->Value;
-        p1=it->ShapeParam1;
-        p2=it->ShapeParam2;
-        ++it; // next envelope point
-        t1=it->Time;
-        v1=it->Value;
+        // lower_bound gives the node one too far, the segment starts from the node before it
+        const int i=m_nodes.lower_bound(atime)-1;
+        t0=m_nodes.time(i);
+        v0=m_nodes.value(i);
+        p1=m_nodes.shape_p1(i);
+        p2=m_nodes.shape_p2(i);
+        t1=m_nodes.time(i+1);
+        v1=m_nodes.value(i+1);
         return interpolate_foo(atime,t0,v0,t1,v1,p1,p2);
     }
     bool IsSorted() const
     {
-        return std::is_sorted(m_nodes.begin(), m_nodes.end(), []
-                              (const envelope_node& lhs, const envelope_node& rhs)
-                              {
-                                  return lhs.Time<rhs.Time;
-                              });
+        return m_nodes.is_sorted();
     }
     void SortNodes()
     {
-        stable_sort(m_nodes.begin(),m_nodes.end(),
-             [](const envelope_node& a, const envelope_node& b){ return a.Time<b.Time; } );
+        // Reordering the nodes isn't recorded, so the history can't be used after it
+        if (IsSorted()==false)
+        {
+            m_nodes.sort();
+            m_history.clear();
+        }
+        ++m_revision;
+    }
+    // The edits made between begin_edit_step and end_edit_step are recorded in the undo
+    // history as one step. Changing the nodes outside of a step clears the history.
+    void begin_edit_step() { m_history.begin_step(); }
+    void end_edit_step() { m_history.end_step(); }
+    bool can_undo() const { return m_history.can_undo(); }
+    bool can_redo() const { return m_history.can_redo(); }
+    bool undo()
+    {
+        if (m_history.undo(m_nodes)==false)
+            return false;
+        ++m_revision;
+        return true;
+    }
+    bool redo()
+    {
+        if (m_history.redo(m_nodes)==false)
+            return false;
+        ++m_revision;
+        return true;
     }
+    envelope_edit_history& get_history() { return m_history; }
     double minimum_value() const { return m_minvalue; }
     double maximum_value() const { return m_maxvalue; }
     void set_minimum_value(double v) { m_minvalue=v; }
     void set_maximum_value(double v) { m_maxvalue=v; }
     std::function<double(double)> normalized_to_scaled_func;
     std::function<double(double)> scaled_to_normalized_func;
-    void begin_transformation()
-    {
-        m_old_nodes=m_nodes;
-    }
-    void end_transformation()
-    {
-        m_old_nodes.clear();
-    }
-    nodes_t& origin_nodes()
-    {
-        return m_old_nodes;
-    }
     const nodes_t& repeater_nodes() const
     {
         return m_repeater_nodes;
@@ -407,9 +1051,9 @@ public:
         m_repeater_nodes.clear();
         for (int i=0;i<m_nodes.size();++i)
         {
-            if (m_nodes[i].Time>=m_playoffset && m_nodes[i].Time<=m_playoffset+1.0)
+            if (m_nodes.time(i)>=m_playoffset && m_nodes.time(i)<=m_playoffset+1.0)
             {
-                envelope_node temp=m_nodes[i];
+                envelope_node temp=m_nodes.get(i);
                 temp.Time-=m_playoffset;
                 m_repeater_nodes.push_back(temp);
             }
@@ -420,18 +1064,52 @@ public:
     //time_range get_play_offset_range() const { return std::make_pair(m_mintime,m_maxtime); }
     const grid_t& get_value_grid() const { return m_value_grid; }
     void set_value_grid(grid_t g) { m_value_grid=std::move(g); }
+    // Passes the node arrays to f to be modified in place. f returns true if it changed the
+    // nodes, and must leave them untouched when returning false. The nodes are only sorted
+    // again if f left them out of order.
     template<typename F>
     void manipulate(F&& f)
     {
-        nodes_t backup=m_nodes;
-        if (f(backup)==true)
+        if (f(m_nodes)==true)
         {
-            std::swap(backup,m_nodes);
+            m_history.clear();
             SortNodes();
         }
     }
+    // As manipulate, but f is called with a copy of each node with an index in [first, last),
+    // which is stored back if f returns true
+    template<typename F>
+    void manipulate_range(int first, int last, F&& f)
+    {
+        first=bound_value(0,first,(int)m_nodes.size());
+        last=bound_value(first,last,(int)m_nodes.size());
+        bool changed=false;
+        for (int i=first;i<last;++i)
+        {
+            envelope_node node=m_nodes.get(i);
+            if (f(node)==true)
+            {
+                if (should_record_edit())
+                    m_history.record_move(i,i,m_nodes.get(i),node);
+                m_nodes.set(i,node);
+                changed=true;
+            }
+        }
+        if (changed==true)
+            SortNodes();
+    }
+    size_t memory_size() const { return m_nodes.memory_size(); }
 private:
-    nodes_t m_nodes;
+    // Returns true if the edit being made should be recorded, otherwise the history would
+    // no longer match the nodes after the edit and is cleared
+    bool should_record_edit()
+    {
+        if (m_history.is_recording()==true)
+            return true;
+        m_history.clear();
+        return false;
+    }
+    envelope_node_arrays m_nodes;
     double m_playoffset=0.0;
     double m_minvalue=0.0;
     double m_maxvalue=1.0;
@@ -441,11 +1119,12 @@ private:
     int m_color;
     String m_name;
     bool m_updateopinprogress;
+    int m_revision=0;
     double m_defvalue; // "neutral" value to be used for resets and stuff
 
     nodes_t m_reset_nodes;
-    nodes_t m_old_nodes;
     nodes_t m_repeater_nodes;
+    envelope_edit_history m_history;
     grid_t m_value_grid;
 };
 
@@ -0,0 +1,89 @@
+/*
+This file is part of CDP Front-end.
+
+CDP front-end is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+CDP front-end is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "jcdp_item_tracker.h"
+#include "reaper_plugin_functions.h"
+#undef min
+#undef max
+
+static reaper_item_fingerprint make_fingerprint(MediaItem* item)
+{
+    reaper_item_fingerprint result;
+    result.m_item=item;
+    result.m_take=GetActiveTake(item);
+    if (result.m_take==nullptr)
+        return result;
+    result.m_source=(PCM_source*)GetSetMediaItemTakeInfo(result.m_take,"P_SOURCE",nullptr);
+    result.m_take_start_offset=*(double*)GetSetMediaItemTakeInfo(result.m_take,"D_STARTOFFS",nullptr);
+    result.m_item_length=*(double*)GetSetMediaItemInfo(item,"D_LENGTH",nullptr);
+    return result;
+}
+
+bool reaper_item_tracker::selection_differs()
+{
+    for (int i=0;i<m_items_per_check && i<(int)m_selection.size();++i)
+    {
+        if (m_next_check>=(int)m_selection.size())
+            m_next_check=0;
+        if (GetSelectedMediaItem(nullptr,m_next_check)!=m_selection[m_next_check])
+            return true;
+        ++m_next_check;
+    }
+    return false;
+}
+
+bool reaper_item_tracker::update()
+{
+    m_changed.clear();
+    int state_count=GetProjectStateChangeCount(nullptr);
+    int num_selected=CountSelectedMediaItems(nullptr);
+    MediaItem* first=num_selected>0 ? GetSelectedMediaItem(nullptr,0) : nullptr;
+    MediaItem* last=num_selected>0 ? GetSelectedMediaItem(nullptr,num_selected-1) : nullptr;
+    if (state_count==m_state_change_count && num_selected==m_num_selected
+            && first==m_first_selected && last==m_last_selected && selection_differs()==false)
+        return false;
+    m_state_change_count=state_count;
+    m_num_selected=num_selected;
+    m_first_selected=first;
+    m_last_selected=last;
+    m_selection.resize(num_selected);
+    std::unordered_map<MediaItem*,reaper_item_fingerprint> fingerprints;
+    fingerprints.reserve(num_selected);
+    for (int i=0;i<num_selected;++i)
+    {
+        MediaItem* item=GetSelectedMediaItem(nullptr,i);
+        m_selection[i]=item;
+        reaper_item_fingerprint fp=make_fingerprint(item);
+        auto it=m_fingerprints.find(item);
+        if (it==m_fingerprints.end() || it->second!=fp)
+            m_changed.push_back(fp);
+        fingerprints[item]=fp;
+    }
+    // Items that were deselected are forgotten, so selecting them again counts as a change
+    m_fingerprints.swap(fingerprints);
+    return m_changed.empty()==false;
+}
+
+void reaper_item_tracker::invalidate()
+{
+    m_state_change_count=-1;
+    m_num_selected=-1;
+    m_first_selected=nullptr;
+    m_last_selected=nullptr;
+    m_selection.clear();
+    m_fingerprints.clear();
+}
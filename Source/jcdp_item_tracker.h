@@ -0,0 +1,73 @@
+/*
+This file is part of CDP Front-end.
+
+CDP front-end is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+CDP front-end is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef JCDP_ITEM_TRACKER_H
+#define JCDP_ITEM_TRACKER_H
+
+#include <unordered_map>
+#include <vector>
+#include "JuceHeader.h"
+#include "reaper_plugin.h"
+
+class MediaItem;
+class MediaItem_Take;
+
+// What is relevant to the front-end about one selected item
+struct reaper_item_fingerprint
+{
+    MediaItem* m_item=nullptr;
+    MediaItem_Take* m_take=nullptr;
+    PCM_source* m_source=nullptr;
+    double m_take_start_offset=0.0;
+    double m_item_length=0.0;
+    bool operator==(const reaper_item_fingerprint& other) const
+    {
+        return m_item==other.m_item && m_take==other.m_take && m_source==other.m_source
+            && m_take_start_offset==other.m_take_start_offset && m_item_length==other.m_item_length;
+    }
+    bool operator!=(const reaper_item_fingerprint& other) const { return !(*this==other); }
+};
+
+// Tells which selected items have changed since the previous check. A check first only looks
+// at the project state change counter and at the ends of the selection, and fingerprints the
+// selected items only when one of those changed. As not all selection changes show up in
+// the counter, each check also compares a few of the selected items, in turn, with the ones
+// remembered at the same positions, and fingerprints them all if one differs.
+class reaper_item_tracker
+{
+public:
+    reaper_item_tracker(int items_per_check=4) : m_items_per_check(items_per_check) {}
+    // Returns true if any of the selected items was added or changed
+    bool update();
+    // The items that were new or changed in the last update, in selection order
+    const std::vector<reaper_item_fingerprint>& get_changed_items() const { return m_changed; }
+    // The next update fingerprints all the selected items again and reports them all as changed
+    void invalidate();
+private:
+    bool selection_differs();
+    int m_items_per_check=4;
+    int m_next_check=0;
+    int m_state_change_count=-1;
+    int m_num_selected=-1;
+    MediaItem* m_first_selected=nullptr;
+    MediaItem* m_last_selected=nullptr;
+    std::vector<MediaItem*> m_selection;
+    std::unordered_map<MediaItem*,reaper_item_fingerprint> m_fingerprints;
+    std::vector<reaper_item_fingerprint> m_changed;
+};
+
+#endif // JCDP_ITEM_TRACKER_H
@@ -17,6 +17,10 @@ along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "jcdp_main_dialog.h"
 #include "reaper_plugin_functions.h"
+#include "jcdp_benchmarks.h"
+#include "jcdp_breakpoints.h"
+#include "jcdp_processor_registry.h"
+#include "jcdp_plugin_render.h"
 #include <set>
 #include <future>
 
@@ -32,8 +36,6 @@ extern File g_stand_alone_render_dir;
 extern bool g_is_running_as_plugin;
 extern std::unique_ptr<PropertiesFile> g_propsfile;
 
-int g_max_child_process_wait_time=15000;
-
 ValueTree serialize_to_value_tree(const envelope_node& pt, Identifier id)
 {
 	ValueTree vt(id);
@@ -140,6 +142,9 @@ cdp_main_dialog::cdp_main_dialog(IJCDPreviewPlayback *delegate,
     g_max_child_process_wait_time=1000*g_propsfile->getIntValue("cdp_max_wait",15);
     Logger::writeToLog("max process wait time "+String(g_max_child_process_wait_time));
 	m_gui_scale_factor = g_propsfile->getDoubleValue("gui_scale_factor", 1.0);
+    m_render_history.set_capacity(g_propsfile->getIntValue("render_history_size",8));
+    m_render_history.OnFileRemoved=[this](const String& fn) { m_audio_delegate->release_preload(fn); };
+    m_take_fingerprints.OnTakeChanged=[this](MediaItem_Take* take, const String&) { on_reaper_take_changed(take); };
 #ifdef WIN32
     m_env_bsize=g_propsfile->getValue("cdp_buf_size","1024");
     auto winresult=SetEnvironmentVariableA("CDP_MEMORY_BBSIZE",m_env_bsize.toRawUTF8());
@@ -397,6 +402,22 @@ cdp_main_dialog::cdp_main_dialog(IJCDPreviewPlayback *delegate,
     //m_commands.add_command("Foo",[]() { Logger::writeToLog("FOO!!!!"); },KeyPress(KeyPress::F1Key));
 	load_state();
 	load_presets_file();
+    // Processors whose CDP program crashes are hidden once the probe is done. Without a binaries
+    // folder every program would look missing, so nothing is probed then.
+    if (g_cdp_binaries_dir.isDirectory()==true)
+    {
+        Component::SafePointer<cdp_main_dialog> safe_this(this);
+        m_capability_probe.OnFinished=[safe_this]()
+        {
+            MessageManager::callAsync([safe_this]()
+            {
+                if (safe_this!=nullptr)
+                    safe_this->hide_broken_processors();
+            });
+        };
+        m_capability_probe.start(g_propsfile->getFile().getParentDirectory().getChildFile("cdpcapabilities.xml"),
+                                 g_cdp_binaries_dir,*m_proc_infos);
+    }
 }
 
 struct presets_combo_comparator
@@ -542,12 +563,18 @@ void cdp_main_dialog::load_state()
         }
     }
     for (auto& proc : *m_proc_infos)
+    {
+        // Keeps the processors without stored state unparsed
+        if (vt.getChildWithName(make_valid_id_string(proc.m_title)).isValid()==false)
+            continue;
+        load_processor_parameters(proc);
         for (auto& param : proc.m_parameters)
         {
             String key=make_valid_id_string(proc.m_title)+make_valid_id_string(param.m_name);
             current_params[key]=&param;
 			procparmap[&param] = &proc;
         }
+    }
     for (auto& curpar : current_params)
     {
         auto iter=stored_params.find(curpar.first);
@@ -608,7 +635,9 @@ void cdp_main_dialog::init_plugin()
 	m_param_comps.clear();
 	CDP_processor_info& the_proc_info = get_current_processor();
 	VSTPluginFormat vstformat;
-	PluginDescription* desc = m_kplist->getType(the_proc_info.m_plugin_id);
+	PluginDescription* desc = m_kplist->getTypeForIdentifierString(the_proc_info.m_plugin_identifier);
+	if (desc == nullptr)
+		return;
 	AudioPluginInstance* pluginst = vstformat.createInstanceFromDescription(*desc,44100.0,512);
 	if (pluginst != nullptr)
 	{
@@ -799,10 +828,6 @@ String get_audio_render_path()
     return String();
 }
 
-String get_temp_audio_file_name(String suffix)
-{
-    return get_audio_render_path()+"/"+c_file_prefix+String(Time::getHighResolutionTicks())+"."+suffix;
-}
 #ifndef BUILD_CDP_FRONTEND_PLUGIN
 void cdp_main_dialog::set_input_file(String fn, MediaItem_Take* take, time_range trange)
 {
@@ -815,8 +840,8 @@ void cdp_main_dialog::set_input_file(String fn, MediaItem_Take* take, time_range
 	
 	if (g_is_running_as_plugin == true)
 	{
-		m_reaper_take = take;
-		auto proc_result = pre_process_file_with_reaper_api(m_reaper_take, time_range(), 1.0, false);
+		set_tracked_take(take);
+		auto proc_result = pre_process_file_with_reaper_api(m_reaper_take, m_take_fingerprints, time_range(), 1.0, false);
 		if (proc_result.first.isEmpty() == false)
 		{
 			m_input_waveform->set_file(proc_result.first);
@@ -840,13 +865,15 @@ void cdp_main_dialog::set_input_file(String fn, MediaItem_Take* take, time_range
     }
     m_state_dirty=true;
     m_custom_time_set=false;
+    // So that A/B comparisons against the input switch instantly
+    m_audio_delegate->preload(m_in_fn);
     //process_cdp();
 }
 #else
 void cdp_main_dialog::set_reaper_take(MediaItem_Take * take)
 {
-	m_reaper_take = take;
-	auto proc_result = pre_process_file_with_reaper_api(m_reaper_take, time_range(), 1.0, false);
+	set_tracked_take(take);
+	auto proc_result = pre_process_file_with_reaper_api(m_reaper_take, m_take_fingerprints, time_range(), 1.0, false);
 	if (proc_result.first.isEmpty() == false)
 	{
 		m_input_waveform->set_file(proc_result.first);
@@ -863,6 +890,92 @@ void cdp_main_dialog::set_reaper_take(MediaItem_Take * take)
 }
 #endif
 
+void cdp_main_dialog::start_batch_render()
+{
+	CDP_processor_info& proc = get_current_processor();
+	if (proc.m_main_program.isEmpty() == true)
+	{
+		update_status_label_async("Batch rendering is only supported for CDP processors");
+		return;
+	}
+	if (g_cdp_binaries_dir.exists() == false)
+	{
+		update_status_label_async("CDP binaries location not set");
+		return;
+	}
+	String capability_error = m_capability_probe.check_processor(proc);
+	if (capability_error.isNotEmpty() == true)
+	{
+		update_status_label_async(capability_error);
+		return;
+	}
+	std::vector<MediaItem_Take*> takes;
+	for (int i = 0; i < CountSelectedMediaItems(nullptr); ++i)
+	{
+		MediaItem_Take* take = GetActiveTake(GetSelectedMediaItem(nullptr, i));
+		if (take != nullptr)
+			takes.push_back(take);
+	}
+	update_parameters_from_sliders();
+	if (m_batch_renderer.start(takes, make_render_request(proc)) == false)
+	{
+		update_status_label_async("No items to batch render");
+		return;
+	}
+	m_batch_item_status = String();
+	m_batch_renderer.OnItemStateChanged = [this](int index, batch_renderer::item_state state, const String& msg)
+	{
+		if (state == batch_renderer::item_state::rendering)
+			m_batch_item_status = "item " + String(index + 1) + " rendering";
+		else if (state == batch_renderer::item_state::inserted)
+			m_batch_item_status = "item " + String(index + 1) + " done";
+		else if (state == batch_renderer::item_state::failed)
+			m_batch_item_status = "item " + String(index + 1) + " failed : " + msg;
+	};
+	m_batch_renderer.OnProgress = [this](const batch_renderer::batch_progress& progress)
+	{
+		String txt = progress.to_string();
+		if (m_batch_item_status.isNotEmpty())
+			txt += "\n" + m_batch_item_status;
+		m_status_label->setText(txt, dontSendNotification);
+	};
+	m_batch_renderer.OnFinished = [this](const batch_renderer::batch_progress& progress)
+	{
+		m_status_label->setText(progress.to_string() + "\nBatch render finished", dontSendNotification);
+	};
+}
+
+void cdp_main_dialog::set_tracked_take(MediaItem_Take* take)
+{
+	if (take != m_reaper_take)
+		m_take_fingerprints.untrack(m_reaper_take);
+	m_reaper_take = take;
+	m_take_fingerprints.track(m_reaper_take);
+}
+
+void cdp_main_dialog::on_reaper_take_changed(MediaItem_Take* take)
+{
+	if (take != m_reaper_take)
+		return;
+	// The take audio was edited in REAPER, export it again and rerender
+	if (reload_reaper_take() == false)
+		return;
+	m_state_dirty = true;
+	if (m_render_timer_enabled == true)
+		process_deferred(500);
+}
+
+bool cdp_main_dialog::reload_reaper_take()
+{
+	auto proc_result = pre_process_file_with_reaper_api(m_reaper_take, m_take_fingerprints, time_range(), 1.0, false);
+	if (proc_result.first.isEmpty() == true)
+		return false;
+	m_input_waveform->set_file(proc_result.first);
+	m_in_fn = proc_result.first;
+	m_audio_delegate->preload(m_in_fn);
+	return true;
+}
+
 int cdp_main_dialog::index_of_named_processor(const String& name) const
 {
     for (int i=0;i<m_proc_infos->size();++i)
@@ -871,6 +984,53 @@ int cdp_main_dialog::index_of_named_processor(const String& name) const
     return -1;
 }
 
+void cdp_main_dialog::add_processors(std::vector<CDP_processor_info> procs)
+{
+    if (procs.empty()==true)
+        return;
+    String current_title=get_current_processor().m_title;
+    // The processors are moved around, so the parameters the components point to stay put
+    for (auto& e : procs)
+        m_proc_infos->push_back(std::move(e));
+    std::sort(m_proc_infos->begin(),m_proc_infos->end(),
+              [](const CDP_processor_info& lhs, const CDP_processor_info &rhs)
+    {
+        return lhs.m_title<rhs.m_title;
+    });
+    reselect_processor(current_title);
+}
+
+void cdp_main_dialog::reselect_processor(const String& title)
+{
+    m_proc_listbox->updateContent();
+    int index=index_of_named_processor(title);
+    if (index!=m_proc_listbox->getSelectedRow())
+    {
+        // Same processor at another row, the parameter components don't need to be recreated
+        m_current_processor_index=index;
+        m_proc_listbox->selectRow(index);
+    }
+}
+
+void cdp_main_dialog::hide_broken_processors()
+{
+    if (g_cdp_binaries_dir.isDirectory()==false)
+        return;
+    String current_title=get_current_processor().m_title;
+    const size_t old_size=m_proc_infos->size();
+    m_proc_infos->erase(std::remove_if(m_proc_infos->begin(),m_proc_infos->end(),
+                                       [this,&current_title](const CDP_processor_info& proc)
+    {
+        // The shown processor stays, the parameter components point into it
+        if (proc.m_title==current_title || m_capability_probe.is_broken(proc)==false)
+            return false;
+        Logger::writeToLog("Hiding "+proc.m_title+" : "+m_capability_probe.check_processor(proc));
+        return true;
+    }),m_proc_infos->end());
+    if (m_proc_infos->size()!=old_size)
+        reselect_processor(current_title);
+}
+
 void cdp_main_dialog::closeButtonPressed()
 {
     if (g_is_running_as_plugin==false)
@@ -929,6 +1089,21 @@ bool cdp_main_dialog::keyPressed(const KeyPress &press)
 		update_envelope_size();
 		return true;
 	}
+    if (press.getKeyCode()=='A' && press.getModifiers().isAnyModifierKeyDown()==false)
+    {
+        toggle_preview_ab();
+        return true;
+    }
+    if (press.getKeyCode()==',')
+    {
+        preview_render_history(m_history_index+1);
+        return true;
+    }
+    if (press.getKeyCode()=='.')
+    {
+        preview_render_history(m_history_index-1);
+        return true;
+    }
     return false;
 }
 
@@ -992,9 +1167,12 @@ void cdp_main_dialog::finalize_output_file()
 {
     m_state_dirty=true;
     if (m_out_fn.isEmpty()==true)
+    {
+        // Renders run in the background, continue when the render is done
+        m_finalize_after_render=true;
         process_cdp();
-    if (m_out_fn.isEmpty()==true)
         return;
+    }
     File temp1(m_in_fn);
     String outfilename;
     if (g_propsfile->getBoolValue("always_ask_out_fn",false)==false)
@@ -1068,7 +1246,9 @@ CDP_processor_info &cdp_main_dialog::get_current_processor()
     int index=m_proc_listbox->getSelectedRow();
     if (index<0 || index>=m_proc_infos->size())
         index=0;
-    return (*m_proc_infos)[index];
+    CDP_processor_info& proc=(*m_proc_infos)[index];
+    load_processor_parameters(proc);
+    return proc;
 }
 
 void cdp_main_dialog::show_menu()
@@ -1112,6 +1292,19 @@ void cdp_main_dialog::show_menu()
 	}
 	m.addSubMenu("GUI scaling", gui_scales_menu, true);
 
+	// Maximum error of the automation breakpoint files, as a fraction of the parameter range
+	std::vector<double> breakpoint_errors{ 0.01,0.001,0.0001 };
+	double breakpoint_error_opt = g_propsfile->getDoubleValue("breakpoint_max_error", 0.001);
+	subid = 400;
+	PopupMenu breakpoint_error_menu;
+	for (auto& e : breakpoint_errors)
+	{
+		bool isticked = e == breakpoint_error_opt;
+		breakpoint_error_menu.addItem(subid, String(e*100.0, 2)+" %", true, isticked);
+		++subid;
+	}
+	m.addSubMenu("Automation accuracy", breakpoint_error_menu, true);
+
 	bool opt3=g_propsfile->getBoolValue("always_ask_out_fn",false);
     m.addItem (4, "Always ask for output file name",true,opt3);
     m.addItem (1, "Choose render folder...",!opt3,false);
@@ -1123,6 +1316,26 @@ void cdp_main_dialog::show_menu()
         m.addItem (3, "Adjust item length if processing changes duration",true,opt2);
     m.addItem (7, "Autorender after changing settings",true,m_render_timer_enabled);
 	m.addItem(8, "Loop preview playback", true, m_audio_delegate->is_looped());
+	bool ambisonic_preview=g_propsfile->getBoolValue("preview_ambisonic_input",false);
+	if (g_is_running_as_plugin==false)
+		m.addItem(9, "Preview 4+ channel files as first order Ambisonics", true, ambisonic_preview);
+	bool proportional_swap=g_propsfile->getBoolValue("preview_proportional_swap",true);
+	if (g_is_running_as_plugin==true)
+		m.addItem(10, "Keep relative preview position when render length changes", true, proportional_swap);
+	if (g_is_running_as_plugin==true)
+	{
+		m.addItem(11, "Batch render selected items", m_batch_renderer.is_running()==false, false);
+		m.addItem(12, "Cancel batch render", m_batch_renderer.is_running(), false);
+	}
+#ifndef NDEBUG
+	PopupMenu benchmarks_menu;
+	benchmarks_menu.addItem(500, "Thumbnail generation", m_in_fn.isEmpty()==false, false);
+	benchmarks_menu.addItem(501, "Envelope evaluation", true, false);
+	benchmarks_menu.addItem(502, "Envelope editing", true, false);
+	benchmarks_menu.addItem(503, "Breakpoint export", true, false);
+	benchmarks_menu.addItem(504, "Envelope storage", true, false);
+	m.addSubMenu("Benchmarks", benchmarks_menu, true);
+#endif
 	const int result = m.show();
     if (result == 0)
     {
@@ -1133,6 +1346,45 @@ void cdp_main_dialog::show_menu()
 		m_audio_delegate->set_looped(!m_audio_delegate->is_looped());
 		g_propsfile->setValue("looped_preview", m_audio_delegate->is_looped());
 	}
+	else if (result == 9)
+	{
+		// Takes effect when the next file is loaded for preview
+		g_propsfile->setValue("preview_ambisonic_input", !ambisonic_preview);
+	}
+	else if (result == 10)
+	{
+		g_propsfile->setValue("preview_proportional_swap", !proportional_swap);
+	}
+	else if (result == 11)
+	{
+		start_batch_render();
+	}
+	else if (result == 12)
+	{
+		m_batch_renderer.cancel_all();
+	}
+#ifndef NDEBUG
+	else if (result == 500)
+	{
+		benchmark_thumbnail_generation(m_in_fn);
+	}
+	else if (result == 501)
+	{
+		benchmark_envelope_evaluation();
+	}
+	else if (result == 502)
+	{
+		benchmark_envelope_editing();
+	}
+	else if (result == 503)
+	{
+		benchmark_breakpoint_export();
+	}
+	else if (result == 504)
+	{
+		benchmark_envelope_storage();
+	}
+#endif
 	else if (result == 1)
     {
         choose_rendering_location();
@@ -1208,6 +1460,10 @@ void cdp_main_dialog::show_menu()
 		setSize(getWidth()-1,getHeight()-1);
 		setSize(getWidth()+1, getHeight()+1);
 	}
+	else if (result >= 400 && result < 500)
+	{
+		g_propsfile->setValue("breakpoint_max_error", breakpoint_errors[result - 400]);
+	}
 }
 
 template<typename T,typename U>
@@ -1420,9 +1676,11 @@ void cdp_main_dialog::toggle_preview()
         m_preview_button->setButtonText("Preview");
     } else
     {
-        if (ModifierKeys::getCurrentModifiers().isCtrlDown()==false)
+        m_previewing_input=ModifierKeys::getCurrentModifiers().isCtrlDown();
+        if (m_previewing_input==false)
         {
             process_cdp();
+            m_history_index=0;
             m_audio_delegate->set_audio_file(m_out_fn);
         } else
             m_audio_delegate->set_audio_file(m_in_fn);
@@ -1431,6 +1689,30 @@ void cdp_main_dialog::toggle_preview()
     }
 }
 
+void cdp_main_dialog::toggle_preview_ab()
+{
+    if (m_render_history.size()==0 || m_in_fn.isEmpty()==true)
+        return;
+    if (m_previewing_input==false)
+    {
+        m_previewing_input=true;
+        m_audio_delegate->switch_audio_file(m_in_fn);
+        update_status_label_async("Previewing input");
+    } else preview_render_history(m_history_index);
+}
+
+void cdp_main_dialog::preview_render_history(int index)
+{
+    if (m_render_history.size()==0)
+        return;
+    m_history_index=jlimit(0,m_render_history.size()-1,index);
+    m_previewing_input=false;
+    const render_history_entry& entry=m_render_history.get(m_history_index);
+    m_audio_delegate->switch_audio_file(entry.m_filename);
+    update_status_label_async("Previewing render "+String(m_history_index+1)+"/"+String(m_render_history.size())
+                              +" : "+entry.get_description());
+}
+
 void cdp_main_dialog::import_item()
 {
 #ifdef BUILD_CDP_FRONTEND_PLUGIN
@@ -1529,278 +1811,6 @@ void cdp_main_dialog::import_file()
     }
 }
 
-std::pair<StringArray, String> cdp_main_dialog::do_pvoc_analysis(StringArray infiles, int wsize, int olap)
-{
-    child_processes processes;
-    StringArray outfilenames;
-    for (int i=0;i<infiles.size();++i)
-    {
-        File temp1(infiles[i]);
-        String outfilename=get_audio_render_path()+"/"+c_file_prefix+temp1.getFileNameWithoutExtension()+String(wsize)+String(olap)+".ana";
-        outfilenames.add(outfilename);
-        remove_file_if_exists(outfilename);
-        StringArray pvocargs;
-        pvocargs.add(g_cdp_binaries_dir.getFullPathName()+"/pvoc");
-        pvocargs.add("anal");
-        pvocargs.add("1");
-        pvocargs.add(infiles[i]);
-        pvocargs.add(outfilename);
-        pvocargs.add(String::formatted("-c%d",wsize));
-        pvocargs.add(String::formatted("-o%d",olap));
-        Logger::writeToLog("Starting ChildProcess pvoc anal "+infiles[i]);
-        //Logger::writeToLog(pvocargs.joinIntoString(" "));
-        processes.add_and_start_task(pvocargs);
-    }
-    String r=processes.wait_for_finished(g_max_child_process_wait_time);
-    if (r.isEmpty()==true)
-    {
-        return std::make_pair(outfilenames,String());
-    }
-    return std::make_pair(StringArray(),r);
-}
-
-std::pair<String,String> cdp_main_dialog::cut_file(String infn, time_range trange, bool excise)
-{
-    if (trange.isValid()==false)
-        return std::make_pair(infn,String());
-    String outfn=get_temp_audio_file_name();
-    remove_file_if_exists(outfn);
-    ChildProcess proc;
-    StringArray cutargs;
-    cutargs.add(g_cdp_binaries_dir.getFullPathName()+"/sfedit");
-    if (excise==false)
-    {
-        cutargs.add("cut");
-        cutargs.add("1");
-    } else
-    {
-        cutargs.add("excise");
-        cutargs.add("1");
-    }
-    cutargs.add(infn);
-    cutargs.add("-f"+outfn);
-    cutargs.add(String(trange.start()));
-    cutargs.add(String(trange.end()-0.001)); // the CDP cut program errors out if the end is even slightly past the file end
-    proc.start(cutargs);
-    proc.waitForProcessToFinish(g_max_child_process_wait_time);
-    {
-        if (proc.getExitCode()==0)
-        {
-            return std::make_pair(outfn,String());
-        }
-    }
-    return std::make_pair(String(),proc.readAllProcessOutput());
-}
-
-String cdp_main_dialog::adjust_file_volume(String infn, double vol)
-{
-    String outfn=get_temp_audio_file_name();
-    remove_file_if_exists(outfn);
-    auto result=run_process({g_cdp_binaries_dir.getFullPathName()+"/modify",
-                            "loudness","2",
-                            infn,"-f"+outfn,
-                            String(vol)},g_max_child_process_wait_time);
-    if (result.second==0)
-        return outfn;
-    return String();
-}
-
-String cdp_main_dialog::monoize_file(String infn)
-{
-    String outfn=get_temp_audio_file_name();
-    //String outfn(get_audio_render_path()+"/monoized_"+String(Time::currentTimeMillis())+".wav");
-    remove_file_if_exists(outfn);
-    ChildProcess proc;
-    StringArray monoizer_args;
-    monoizer_args.add(g_cdp_binaries_dir.getFullPathName()+"/housekeep");
-    monoizer_args.add("chans");
-    monoizer_args.add("4");
-    monoizer_args.add(infn);
-    monoizer_args.add("-f"+outfn);
-    proc.start(monoizer_args);
-    proc.waitForProcessToFinish(g_max_child_process_wait_time);
-    {
-        if (proc.getExitCode()==0)
-        {
-            return outfn;
-        }
-    }
-    return String();
-}
-
-std::pair<StringArray, String> cdp_main_dialog::do_pvoc_resynth(StringArray infiles)
-{
-    bool do_parallel=true;
-    child_processes processes;
-    StringArray outfiles;
-    for (int i=0;i<infiles.size();++i)
-    {
-        String resynthtoutfn=get_temp_audio_file_name();
-        remove_file_if_exists(resynthtoutfn);
-        outfiles.add(resynthtoutfn);
-        StringArray pvocargs;
-        pvocargs.add(g_cdp_binaries_dir.getFullPathName()+"/pvoc");
-        pvocargs.add("synth");
-        pvocargs.add(infiles[i]);
-        pvocargs.add("-f"+resynthtoutfn);
-        if (do_parallel==true)
-            processes.add_and_start_task(pvocargs);
-        else
-        {
-            processes.add_task(pvocargs);
-        }
-    }
-    String r;
-    if (do_parallel==true)
-        r=processes.wait_for_finished(g_max_child_process_wait_time);
-    else r=processes.process_sequentially(g_max_child_process_wait_time);
-    if (r.isEmpty()==true)
-        return std::make_pair(outfiles,String());
-    return std::make_pair(StringArray(),r);
-}
-
-String generate_cmd_argument(parameter_info& param,
-                             double inputfilelen,
-                             file_cleaner& cleaner,
-                             CDP_processor_info& procinfo,time_range time_selection)
-{
-    if (time_selection.isValid()==false)
-        time_selection=time_range(0.0,inputfilelen);
-    if (param.m_cmd_arg_formatter)
-    {
-        auto result=param.m_cmd_arg_formatter(&param);
-        if (result.second==true)
-            cleaner.add(result.first);
-        return result.first;
-    }
-    if (param.m_automation_enabled==false)
-    {
-        if (param.m_cmd_prefix.isEmpty()==true)
-            return String(param.m_current_value);
-        else
-            return param.m_cmd_prefix+String(param.m_current_value);
-    } else
-    {
-        String parname=param.m_name.replaceCharacter(' ','_');
-        String env_fn=get_audio_render_path()+"/"+c_file_prefix+parname+String(Time::getHighResolutionTicks())+".txt";
-        File env_txt_file(env_fn);
-        FileOutputStream* os=env_txt_file.createOutputStream();
-        if (os!=nullptr)
-        {
-            double valuerange=param.m_maximum_value-param.m_minimum_value;
-            if (time_selection.start()>0.0)
-            {
-                //Logger::writeToLog(String::formatted("time selection %f %f",time_selection.start(),time_selection.end()));
-                double scalednormtime=1.0/inputfilelen*time_selection.start();
-                double normalizedvalue=param.m_env.GetInterpolatedNodeValue(scalednormtime);
-                double scaledvalue=param.m_minimum_value+valuerange*normalizedvalue;
-                (*os) << String::formatted("%f %f\n",0.0,scaledvalue);
-                //Logger::writeToLog(String::formatted("\t%f %f",0.0,scaledvalue));
-            }
-            const int num_sub_segments=15;
-            for (int i=0;i<param.m_env.GetNumNodes()-1;++i)
-            {
-                const envelope_node& node0=param.m_env.GetNodeAtIndex(i);
-                const envelope_node& node1=param.m_env.GetNodeAtIndex(i+1);
-                double value_delta=node1.Value-node0.Value;
-                double time_delta=node1.Time-node0.Time;
-                //Logger::writeToLog(String::formatted("env node %d",i));
-                for (int j=0;j<num_sub_segments;++j)
-                {
-                    double to_shaping=1.0/(num_sub_segments)*j;
-                    double to_output=time_delta/num_sub_segments*j;
-                    double shaped=node0.Value+value_delta*get_shaped_value(to_shaping,0,node0.ShapeParam1,0.0);
-                    double scaled=param.m_slider_shaping_func(shaped);
-                    double scaledtime;
-                    if (param.m_envelope_time_scaling_func)
-                    {
-                        scaledtime=(node0.Time+to_shaping)*param.m_envelope_time_scaling_func(&procinfo);
-                        (*os) << String::formatted("%f %f\n",scaledtime,scaled);
-                    }
-                    else
-                    {
-                        scaledtime=node0.Time*inputfilelen+to_output*inputfilelen;
-                        if (scaledtime>=time_selection.start() && scaledtime<=time_selection.end())
-                        {
-                            scaledtime-=time_selection.start();
-                            (*os) << String::formatted("%f %f\n",scaledtime,scaled);
-                            //Logger::writeToLog(String::formatted("\t%f %f",scaledtime,scaled));
-                        }
-
-                    }
-                }
-
-            }
-            if (time_selection.isValid()==true)
-            {
-                double scalednormtime=1.0/inputfilelen*time_selection.end();
-                double normalizedvalue=param.m_env.GetInterpolatedNodeValue(scalednormtime);
-                double scaledvalue=param.m_minimum_value+valuerange*normalizedvalue;
-                (*os) << String::formatted("%f %f\n",time_selection.length(),scaledvalue);
-                //Logger::writeToLog(String::formatted("\t%f %f",time_selection.length(),scaledvalue));
-            }
-            delete os;
-            cleaner.add(env_fn);
-            if (param.m_cmd_prefix.isEmpty()==true)
-                return env_fn;
-            else return param.m_cmd_prefix+env_fn;
-        }
-    }
-    return String();
-}
-
-std::pair<StringArray, String> cdp_main_dialog::split_multichannel_file(String fn, 
-	audio_source_info info, file_cleaner& cleaner)
-{
-    StringArray result;
-    // housekeep chans 2 infile
-    File helper_file(fn);
-    File helper_directory=helper_file.getParentDirectory();
-    for (int i=0;i<info.num_channels;++i)
-    {
-        String temp_fn=helper_directory.getFullPathName()+"/"+
-                helper_file.getFileNameWithoutExtension()+"_c"+String(i+1)+helper_file.getFileExtension();
-        remove_file_if_exists(temp_fn,true);
-        cleaner.add(temp_fn,true);
-        result.add(temp_fn);
-    }
-    ChildProcess proc;
-    StringArray proc_args;
-    proc_args.add(g_cdp_binaries_dir.getFullPathName()+"/housekeep");
-    proc_args.add("chans");
-    proc_args.add("2");
-    proc_args.add(fn);
-    proc.start(proc_args);
-    proc.waitForProcessToFinish(g_max_child_process_wait_time);
-    if (proc.getExitCode()==0)
-    {
-        return std::make_pair(result,String());
-    }
-    return std::make_pair(StringArray(),proc.readAllProcessOutput());
-}
-
-std::pair<String, String> cdp_main_dialog::merge_split_files(StringArray infiles)
-{
-    //submix interleave sndfile1 sndfile2 [sndfile3 sndfile4] outfile
-    String outfn=get_temp_audio_file_name();
-    ChildProcess proc;
-    StringArray merge_args;
-    merge_args.add(g_cdp_binaries_dir.getFullPathName()+"/submix");
-    merge_args.add("interleave");
-    for (int i=0;i<infiles.size();++i)
-    {
-        merge_args.add(infiles[i]);
-    }
-    merge_args.add(outfn);
-    proc.start(merge_args);
-    proc.waitForProcessToFinish(g_max_child_process_wait_time);
-    if (proc.getExitCode()==0)
-    {
-        return std::make_pair(outfn,String());
-    }
-    return std::make_pair(String(),proc.readAllProcessOutput());
-}
-
 void cdp_main_dialog::focusLost(FocusChangeType reason)
 {
 	ResizableWindow::focusLost(reason);
@@ -1813,22 +1823,12 @@ void cdp_main_dialog::focusGained(FocusChangeType reason)
 	//readbg() << "focus gained\n";
 }
 
-bool finalize_cdp_process(CDP_processor_info& procinfo,
-						  const StringArray& processed_files,
-						  String& outfile,
-						  file_cleaner& cleaner)
-{
-	if (processed_files.size() == 0)
-		return false;
-	String old_out_file = outfile;
-	outfile = processed_files[0];
-	if (old_out_file.isEmpty() == false)
-		cleaner.add(old_out_file);
-	return true;
-}
-
 void cdp_main_dialog::commit_cdp_render()
 {
+    // The history now owns the file, and the previous renders stay around for comparing
+    m_render_history.add(make_render_history_entry(m_out_fn,get_current_processor()));
+    m_history_index=0;
+    m_previewing_input=false;
 	MessageManager::callAsync([this]()
 	{
 		m_output_waveform->set_file(m_out_fn);
@@ -1839,17 +1839,26 @@ void cdp_main_dialog::commit_cdp_render()
 	});
 }
 
-void cdp_main_dialog::process_cdp()
+cdp_render_request cdp_main_dialog::make_render_request(const CDP_processor_info& proc)
 {
-    if (m_is_processing_cdp==true)
-    {
-        m_task_counter_mutex.lock();
-        ++m_task_counter;
-        m_task_counter_mutex.unlock();
-        Logger::writeToLog("Already processing CDP...");
-        //return;
+    cdp_render_request request;
+    request.m_processor=proc;
+#ifdef CDP_VST_ENABLED
+    if (proc.m_main_program=="vstplugin")
+    {
+        PluginDescription* desc=m_kplist->getTypeForIdentifierString(proc.m_plugin_identifier);
+        if (desc!=nullptr)
+            request.m_plugin_description=*desc;
+        // The renders use their own instances, set up like the one shown in the dialog
+        if (m_plugin_instance!=nullptr)
+            m_plugin_instance->getStateInformation(request.m_plugin_state);
     }
-    //run_at_scope_end restore_status([this](){update_status_label();m_is_processing_cdp=false;});
+#endif
+    return request;
+}
+
+void cdp_main_dialog::process_cdp()
+{
     if (m_state_dirty==false)
         return;
     if (m_in_fn.isEmpty()==true)
@@ -1862,360 +1871,121 @@ void cdp_main_dialog::process_cdp()
                                          this);
         return;
     }
-	m_task_counter_mutex.lock();
-    int task_counter=m_task_counter;
+    // A newer render makes the running ones obsolete
+    m_task_counter_mutex.lock();
+    if (m_is_processing_cdp==true)
+        Logger::writeToLog("Already processing CDP...");
+    int task_counter=++m_task_counter;
     m_task_counter_mutex.unlock();
-    auto render_task=[this,task_counter]()
+    CDP_processor_info& the_proc_info=get_current_processor();
+    the_proc_info.m_is_dirty = true;
+    // Known not to work, so no need to start the CDP programs
+    String capability_error=m_capability_probe.check_processor(the_proc_info);
+    if (capability_error.isNotEmpty()==true)
     {
-        run_at_scope_end restore_status([this]()
-        {
-            m_is_processing_cdp=false;
-            MessageManager::callAsync([this](){ update_status_label();});
-        });
-        m_is_processing_cdp=true;
-
-        m_output_waveform->m_render_elapsed_time=0.0;
-        double bench_t0=Time::getMillisecondCounterHiRes();
-        /*
-        Thread::sleep(1000);
-        if (m_task_counter>task_counter)
+        update_status_label_async(capability_error);
+        return;
+    }
+    cdp_render_request request=make_render_request(the_proc_info);
+    request.m_time_selection=m_input_waveform->get_time_range();
+    request.m_source_length=get_audio_source_info_cached(m_in_fn).get_length_seconds();
+    if (g_is_running_as_plugin == false)
+    {
+        request.m_input_file=m_in_fn;
+    }
+    else
+    {
+        // An edit the fingerprint timer hasn't seen yet is taken into this render, so the
+        // input shown is updated but no further render is scheduled for it
+        if (m_take_fingerprints.refresh(m_reaper_take)==true && reload_reaper_take()==true)
+            request.m_source_length=get_audio_source_info_cached(m_in_fn).get_length_seconds();
+        // The AudioAccessors can only be used from the message thread
+        double prevolume = the_proc_info.m_parameters[0].m_current_value;
+        double pregain = exp(prevolume*0.11512925464970228420089957273422);
+        auto preprocresult = pre_process_file_with_reaper_api(m_reaper_take, m_take_fingerprints, m_input_waveform->get_time_range(), pregain, false);
+        if (preprocresult.first.isEmpty() == true)
         {
-            Logger::writeToLog("cancelling task "+String(task_counter)+" after test sleep");
+            update_status_label_async("REAPER AudioAccessor processing failed");
             return;
         }
-        */
-        CDP_processor_info& the_proc_info=get_current_processor();
-		the_proc_info.m_is_dirty = true;
-		auto info=get_audio_source_info_cached(m_in_fn);
-        String infntouse;
-        bool makemono=false;
-        if (2==1)
-        {
-            if (info.num_channels!=1 && (the_proc_info.m_is_spectral==true || the_proc_info.m_mono_only==true))
-            {
-                if (m_mono_accepted==false)
-                {
-                    bool do_as_mono=AlertWindow::showOkCancelBox(AlertWindow::WarningIcon,
-                                                                 "CDP processing",
-                                                                 "This processor only supports mono files.\nDo you want to process in mono?",
-                                                                 "Yes","No",
-                                                                 this);
-                    if (do_as_mono==false)
-                        return;
-                    m_mono_accepted=true;
-                }
-                makemono=true;
-
-            }
-        }
-        makemono=false;
-        file_cleaner tempfilecleaner;
-        double infilelen=get_audio_source_info_cached(m_in_fn).get_length_seconds();
-		if (g_is_running_as_plugin == false)
-		{
-			auto cut_result = cut_file(m_in_fn, m_input_waveform->get_time_range());
-			infntouse = cut_result.first;
-			if (infntouse.isEmpty() == true)
-			{
-				MessageManager::callAsync([this,cut_result]()
-				{
-					//m_bubble->showAt(m_input_waveform.get(), AttributedString("CDP sfedit cut failed\n" + cut_result.second), 10000);
-				});
-				infntouse = m_in_fn;
-				return;
-			}
-			else
-				update_status_label_async("Cut OK...");
-			if (infntouse != m_in_fn)
-				tempfilecleaner.add(infntouse);
-
-			if (makemono == true)
-			{
-				infntouse = monoize_file(infntouse);
-				if (infntouse.isEmpty() == true)
-				{
-					MessageManager::callAsync([this]()
-					{
-						//m_bubble->showAt(m_input_waveform.get(), AttributedString("CDP stereo to mono failed"), 5000);
-					});
-					return;
-				}
-				tempfilecleaner.add(infntouse);
-			}
-			double prevolume = the_proc_info.m_parameters[0].m_current_value;
-			if (fuzzy_is_zero(prevolume) == false)
-			{
-				infntouse = adjust_file_volume(infntouse, prevolume);
-				if (infntouse.isEmpty() == true)
-				{
-					MessageManager::callAsync([this]()
-					{
-						//m_bubble->showAt(m_input_waveform.get(), AttributedString("CDP adjust volume failed"), 5000);
-					});
-					return;
-				}
-				else
-					update_status_label_async("Volume adjust OK...");
-				tempfilecleaner.add(infntouse);
-			}
-		}
-		else
-		{
-			double prevolume = the_proc_info.m_parameters[0].m_current_value;
-			double pregain = exp(prevolume*0.11512925464970228420089957273422);
-			auto preprocresult = pre_process_file_with_reaper_api(m_reaper_take, m_input_waveform->get_time_range(), pregain, false);
-			if (preprocresult.first.isEmpty() == true)
-			{
-				MessageManager::callAsync([this]()
-				{
-					update_status_label_async("REAPER AudioAccessor processing failed");
-				});
-				return;
-			}
-			infntouse = preprocresult.first;
-		}
-			
-        StringArray infiles;
-		if (the_proc_info.m_mono_only == false)
-		{
-			infiles.add(infntouse);
-		}
-        else
-        {
-            if (info.num_channels==1)
-                infiles.add(infntouse);
-            else
-            {
-                Logger::writeToLog("Beginning split channels processing...");
-                auto split_result=split_multichannel_file(infntouse,info,tempfilecleaner);
-                if (split_result.second.isEmpty()==true)
-                {
-                    infiles.addArray(split_result.first);
-                    update_status_label_async("Split file OK...");
-                } else
-                {
-                    MessageManager::callAsync([split_result,this]()
-                    {
-						m_status_label->setText("CDP channel split failed\n"+split_result.second,dontSendNotification);
-					});
-                    return;
-                }
-            }
-        }
-        if (the_proc_info.m_is_spectral==true)
-        {
-			int wsize = m_param_comps[1]->get_value();
-            int olap=m_param_comps[2]->get_value();
-            double pvoc_t0=Time::getMillisecondCounterHiRes();
-            auto pvoc_anal_result=do_pvoc_analysis(infiles,wsize,olap);
-            double pvoc_t1=Time::getMillisecondCounterHiRes();
-            Logger::writeToLog("pvoc analysis took "+String(pvoc_t1-pvoc_t0)+" milliseconds");
-            if (pvoc_anal_result.second.isEmpty()==true)
-            {
-                infiles.clear();
-                infiles.addArray(pvoc_anal_result.first);
-                tempfilecleaner.add_multiple(pvoc_anal_result.first);
-                update_status_label_async("PVOC analysis OK...");
-            } else
-            {
-                MessageManager::callAsync([this,pvoc_anal_result]()
-				{
-					m_status_label->setText("CDP pvoc analysis failed\n" + pvoc_anal_result.second, dontSendNotification);
-				});
-                return;
-            }
-
-        }
-        StringArray outfiles;
-        String prog_output;
-        child_processes processes;
-        bool main_proc_parallel=true;
-        double main_proc_t0=Time::getMillisecondCounterHiRes();
-        for (int ch=0;ch<infiles.size();++ch)
-        {
-            StringArray procargs;
-            String procoutfilename=get_temp_audio_file_name();
-            if (the_proc_info.m_is_spectral==true)
-                procoutfilename=get_temp_audio_file_name("ana");
-            // if more than 1 infile, we know the files processed here will be temporary
-            if (infiles.size()>1)
-                tempfilecleaner.add(procoutfilename);
-            Logger::writeToLog("processing "+infiles[ch]);
-            if (the_proc_info.m_is_spectral==true)
-            {
-                procoutfilename=get_temp_audio_file_name("ana");
-                tempfilecleaner.add(procoutfilename);
-            }
-            remove_file_if_exists(procoutfilename);
-            procargs.add(g_cdp_binaries_dir.getFullPathName()+"/"+the_proc_info.m_main_program);
-            procargs.add(the_proc_info.m_sub_program);
-            if (the_proc_info.m_mode.isEmpty()==false)
-                procargs.add(the_proc_info.m_mode);
-            procargs.add(infiles[ch]);
-            if (the_proc_info.m_is_spectral==false)
-                procargs.add("-f"+procoutfilename);
-            else
-                procargs.add(procoutfilename);
-            int param_index_offset=1;
-            if (the_proc_info.m_is_spectral==true)
-                param_index_offset=3;
-            for (int i=param_index_offset;i<the_proc_info.m_parameters.size();++i)
-            {
-                parameter_info& paraminfo=the_proc_info.m_parameters[i];
-                procargs.add(generate_cmd_argument(paraminfo,
-                                                   infilelen,
-                                                   tempfilecleaner,
-                                                   the_proc_info,
-                                                   m_input_waveform->get_time_range()));
-            }
-            outfiles.add(procoutfilename);
-            if (main_proc_parallel==true)
-                processes.add_and_start_task(procargs);
-            else processes.add_task(procargs);
-        }
-        if (main_proc_parallel==true)
-            prog_output=processes.wait_for_finished(g_max_child_process_wait_time);
-        else prog_output=processes.process_sequentially(g_max_child_process_wait_time);
-        double main_proc_t1=Time::getMillisecondCounterHiRes();
-        m_task_counter_mutex.lock();
-        if (m_task_counter>task_counter)
+        request.m_input_file=preprocresult.first;
+        request.m_cut_input=false;
+        request.m_apply_pre_volume=false;
+    }
+#ifdef CDP_VST_ENABLED
+    if (request.m_processor.m_main_program=="vstplugin")
+    {
+        // Plugins are created on the message thread, the render thread only processes with it
+        String error;
+        request.m_plugin_instance=create_render_plugin_instance(request.m_plugin_description,
+                                                                request.m_plugin_state,error);
+        if (request.m_plugin_instance==nullptr)
         {
-            m_task_counter_mutex.unlock();
-            tempfilecleaner.add_multiple(outfiles);
-            Logger::writeToLog("cancelling task "+String(task_counter)+" after main CDP processing");
+            update_status_label_async(error);
             return;
         }
+    }
+#endif
+    m_is_processing_cdp=true;
+    m_output_waveform->m_render_elapsed_time=0.0;
+    auto should_cancel=[this,task_counter]()
+    {
+        m_task_counter_mutex.lock();
+        bool cancelled=m_task_counter>task_counter;
         m_task_counter_mutex.unlock();
-        Logger::writeToLog("main processing took "+String(main_proc_t1-main_proc_t0)+" milliseconds");
-        if (prog_output.isEmpty()==true)
+        return cancelled;
+    };
+    Component::SafePointer<cdp_main_dialog> safe_this(this);
+    m_render_engine.submit(std::move(request),should_cancel,[safe_this,task_counter](const cdp_render_result& result)
+    {
+        MessageManager::callAsync([safe_this,task_counter,result]()
         {
-            if (do_all_files_exist(outfiles)==false)
-            {
-                MessageManager::callAsync([this]()
-                {
-					m_status_label->setText("Error : CDP returned success but a file or multiple files were not created",dontSendNotification);
-				});
-                return;
-            }
-            update_status_label_async("Main processing OK...");
-            if (the_proc_info.m_is_spectral==false)
+            if (safe_this==nullptr)
             {
-                double bench_t1=Time::getMillisecondCounterHiRes();
-                m_output_waveform->m_render_elapsed_time=(bench_t1-bench_t0)/1000.0;
-                if (outfiles.size()==1)
-                {
-					if (finalize_cdp_process(the_proc_info, outfiles, m_out_fn, tempfilecleaner) == true)
-					{
-						m_audio_delegate->set_audio_file(m_out_fn);
-						commit_cdp_render();
-					}
-					
-                } else
-                {
-                    //Logger::writeToLog("Split processing done, joining output files...");
-					auto merge_result=merge_split_files(outfiles);
-                    if (merge_result.second.isEmpty()==true)
-                    {
-						String old_out_file = m_out_fn;
-						m_out_fn = merge_result.first;
-						m_audio_delegate->set_audio_file(m_out_fn);
-						if (old_out_file.isEmpty() == false)
-							tempfilecleaner.add(old_out_file);
-						commit_cdp_render();
-					} else
-                    {
-						MessageManager::callAsync([this]()
-						{
-							m_status_label->setText("Merging files failed",dontSendNotification);
-						});
-                    }
-                    return;
-                }
+                remove_file_if_exists(result.m_output_file);
                 return;
-            } else
-            {
-                if (outfiles.size()==1)
-                {
-                    auto resynth_result=do_pvoc_resynth(outfiles);
-                    if (resynth_result.second.isEmpty()==true)
-                    {
-                        double bench_t1=Time::getMillisecondCounterHiRes();
-                        m_output_waveform->m_render_elapsed_time=(bench_t1-bench_t0)/1000.0;
-						String old_out_file = m_out_fn;
-						m_out_fn = resynth_result.first[0];
-						m_audio_delegate->set_audio_file(m_out_fn);
-						if (old_out_file.isEmpty()==false)
-							tempfilecleaner.add(old_out_file);
-						commit_cdp_render();
-                        return;
-                    } else
-                    {
-                        MessageManager::callAsync([resynth_result,this]()
-                        {
-							m_status_label->setText("CDP pvoc resynthesis failed\n" + resynth_result.second, dontSendNotification);
-						});
-                        return;
-                    }
-                }
-                if (info.num_channels>1 && outfiles.size()==info.num_channels)
-                {
-                    double resynth_t0=Time::getMillisecondCounterHiRes();
-                    auto resynth_result=do_pvoc_resynth(outfiles);
-                    double resynth_t1=Time::getMillisecondCounterHiRes();
-                    Logger::writeToLog("pvoc resynth took "+String(resynth_t1-resynth_t0)+" milliseconds");
-                    if (resynth_result.second.isEmpty()==true)
-                    {
-                        update_status_label_async("PVOC resynth OK...");
-                        tempfilecleaner.add_multiple(resynth_result.first);
-                        if (resynth_result.first.size()==outfiles.size())
-                        {
-                            auto merge_result=merge_split_files(resynth_result.first);
-                            if (merge_result.second.isEmpty()==true)
-                            {
-                                double bench_t1=Time::getMillisecondCounterHiRes();
-                                m_output_waveform->m_render_elapsed_time=(bench_t1-bench_t0)/1000.0;
-								String old_out_file = m_out_fn;
-								m_out_fn = merge_result.first;
-								m_audio_delegate->set_audio_file(m_out_fn);
-								if (old_out_file.isEmpty() == false)
-									tempfilecleaner.add(old_out_file);
-								commit_cdp_render();
-                                return;
-                            } else
-                            {
-                                MessageManager::callAsync([this]()
-                                {
-									m_status_label->setText("CDP file merge failed",dontSendNotification);
-								});
-                                return;
-                            }
-                        }
-                    } else
-                    {
-                        MessageManager::callAsync([resynth_result,this]()
-                        {
-							m_status_label->setText("CDP pvoc resynthesis failed\n" + resynth_result.second, dontSendNotification);
-						});
-                        return;
-                    }
-                }
-
             }
-        }
-        if (prog_output.length()>1024)
-            prog_output="Error output too long to show";
-        MessageManager::callAsync([this,prog_output]()
-        {
-            AlertWindow::showMessageBoxAsync(AlertWindow::WarningIcon,
-                                             "CDP processing error",
-                                             prog_output,"OK",
-                                             this);
+            safe_this->on_render_finished(task_counter,result);
         });
-    };
-	render_task();
-    //std::async(std::launch::async,render_task);
-
+    });
+}
 
+void cdp_main_dialog::on_render_finished(int task_counter, const cdp_render_result& result)
+{
+    Logger::writeToLog("CDP processing took "+String(result.m_elapsed_seconds*1000.0)+" milliseconds");
+    bool is_latest=task_counter==m_task_counter;
+    if (is_latest==true)
+    {
+        m_is_processing_cdp=false;
+        update_status_label();
+    }
+    if (result.m_cancelled==true || is_latest==false)
+    {
+        remove_file_if_exists(result.m_output_file);
+        Logger::writeToLog("cancelled task "+String(task_counter));
+        return;
+    }
+    if (result.ok()==true)
+    {
+        m_output_waveform->m_render_elapsed_time=result.m_elapsed_seconds;
+        m_out_fn=result.m_output_file;
+        m_audio_delegate->set_audio_file(m_out_fn);
+        commit_cdp_render();
+        if (m_finalize_after_render==true)
+        {
+            m_finalize_after_render=false;
+            finalize_output_file();
+        }
+        return;
+    }
+    m_finalize_after_render=false;
+    String prog_output=result.m_error;
+    if (prog_output.length()>1024)
+        prog_output="Error output too long to show";
+    AlertWindow::showMessageBoxAsync(AlertWindow::WarningIcon,
+                                     "CDP processing error",
+                                     prog_output,"OK",
+                                     this);
 }
 
 void cdp_main_dialog::update_edit_mode_buttons()
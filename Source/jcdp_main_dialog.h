@@ -27,6 +27,13 @@ along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
 #include "jcdp_wavecomponent.h"
 #include "jcdp_audio_playback.h"
 #include "jcdp_processor.h"
+#include "jcdp_breakpoints.h"
+#include "jcdp_render_history.h"
+#include "jcdp_take_fingerprints.h"
+#include "jcdp_cdp_render.h"
+#include "jcdp_batch_render.h"
+#include "jcdp_render_engine.h"
+#include "jcdp_cdp_probe.h"
 
 
 
@@ -38,10 +45,6 @@ inline bool has_supported_media_type(PCM_source* src)
     return false;
 }
 
-String get_audio_render_path();
-
-String get_temp_audio_file_name(String suffix="wav");
-
 class MediaItem;
 class MediaItem_Take;
 
@@ -114,6 +117,10 @@ public:
 	void focusLost(FocusChangeType reason);
 	void focusGained(FocusChangeType reason);
 	int index_of_named_processor(const String& name) const;
+    // Adds processors found after the dialog was created, keeping the list sorted and the selection
+    void add_processors(std::vector<CDP_processor_info> procs);
+    // Removes the processors whose CDP program the capability probe found broken
+    void hide_broken_processors();
     void closeButtonPressed();
     bool keyPressed(const KeyPress &);
     void userTriedToCloseWindow();
@@ -127,17 +134,14 @@ public:
     float getDesktopScaleFactor() const { return m_gui_scale_factor; }
     void buttonClicked(Button* but);
     void toggle_preview();
+    // Switches the preview between the input file and the chosen render, keeping the position
+    void toggle_preview_ab();
+    // 0 is the most recent render
+    void preview_render_history(int index);
     void show_menu();
     void import_file();
     void import_item();
     void process_deferred(int delms=500);
-    std::pair<StringArray,String> do_pvoc_analysis(StringArray infiles,int wsize, int olap);
-    std::pair<String,String> cut_file(String infn, time_range trange, bool excise=false);
-    String adjust_file_volume(String infn, double vol);
-    String monoize_file(String infn);
-    std::pair<StringArray,String> split_multichannel_file(String fn,audio_source_info info, file_cleaner& cleaner);
-    std::pair<String,String> merge_split_files(StringArray infiles);
-    std::pair<StringArray, String> do_pvoc_resynth(StringArray infiles);
 
     void process_cdp();
     std::unique_ptr<TextButton> m_import_button;
@@ -183,6 +187,9 @@ private:
     std::atomic<bool> m_is_processing_cdp{false};
     std::atomic<int> m_task_counter{0};
     std::mutex m_task_counter_mutex;
+    render_history m_render_history;
+    int m_history_index=0;
+    bool m_previewing_input=false;
     void update_status_label_async(String txt);
     void set_auto_render_enabled(bool b);
     std::unique_ptr<ComboBox> m_presets_combo;
@@ -191,7 +198,15 @@ private:
 	bool m_large_envelope = false;
 	void update_envelope_size();
 	MediaItem_Take* m_reaper_take = nullptr;
-	ReaperTakeAccessorWrapper m_take_accessor_wrapper;
+	take_fingerprint_service m_take_fingerprints;
+	void set_tracked_take(MediaItem_Take* take);
+	void on_reaper_take_changed(MediaItem_Take* take);
+	// Exports the edited take again as the input
+	bool reload_reaper_take();
+	batch_renderer m_batch_renderer;
+	String m_batch_item_status;
+	// Renders the selected REAPER items with the current processor settings
+	void start_batch_render();
 	void commit_cdp_render();
 	void populate_presets_combo(bool keep_current_selection);
 	void show_presets_menu();
@@ -203,6 +218,14 @@ private:
 	int get_max_preset_id();
 	KnownPluginList* m_kplist = nullptr;
 	AudioPluginInstance* m_plugin_instance=nullptr;
+	void on_render_finished(int task_counter, const cdp_render_result& result);
+	void reselect_processor(const String& title);
+	cdp_capability_probe m_capability_probe;
+	// The settings of the processor and of its plugin, the input is filled in by the caller
+	cdp_render_request make_render_request(const CDP_processor_info& proc);
+	bool m_finalize_after_render=false;
+	// Last, so that the running renders have finished before the rest of the dialog is destroyed
+	cdp_render_engine m_render_engine{2};
 };
 
 #endif // JCDP_MAIN_DIALOG_H
@@ -0,0 +1,117 @@
+/*
+This file is part of CDP Front-end.
+
+CDP front-end is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+CDP front-end is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef JCDP_PLAYHEAD_H
+#define JCDP_PLAYHEAD_H
+
+#include <atomic>
+#include <cmath>
+#include "JuceHeader.h"
+#include "jcdp_utilities.h"
+
+struct playhead_state
+{
+    // Seconds into the file
+    double m_position=0.0;
+    // Time::getMillisecondCounterHiRes() when the position was published
+    double m_timestamp=0.0;
+    double m_length=0.0;
+    bool m_playing=false;
+    bool m_looped=false;
+};
+
+// Seqlock through which the audio thread publishes where playback is, for the GUI to poll
+// without locks. Publishing from the audio thread never waits : if another thread happens to
+// be publishing at the same time, the update is simply dropped, as the next block brings a new
+// one anyway. Seeking, starting and stopping from the other threads retry until their update
+// is in, so that they can't be lost. Reading retries while an update is in progress.
+class playhead_publisher
+{
+public:
+    // Returns false if the update was dropped
+    bool publish(const playhead_state& state)
+    {
+        uint32 seq=m_sequence.load(std::memory_order_relaxed);
+        if ((seq & 1)!=0 || m_sequence.compare_exchange_strong(seq,seq+1,std::memory_order_acquire)==false)
+            return false;
+        std::atomic_thread_fence(std::memory_order_release);
+        m_position.store(state.m_position,std::memory_order_relaxed);
+        m_timestamp.store(state.m_timestamp,std::memory_order_relaxed);
+        m_length.store(state.m_length,std::memory_order_relaxed);
+        m_playing.store(state.m_playing,std::memory_order_relaxed);
+        m_looped.store(state.m_looped,std::memory_order_relaxed);
+        m_sequence.store(seq+2,std::memory_order_release);
+        return true;
+    }
+    // For publishing outside of the audio thread, waits for a concurrent update to finish
+    void publish_waiting(const playhead_state& state)
+    {
+        while (publish(state)==false)
+            Thread::yield();
+    }
+    // For seeking, starting and stopping outside of the audio thread, keeps the rest of the state
+    void publish_position(double position, bool playing)
+    {
+        playhead_state state=read();
+        state.m_position=position;
+        state.m_playing=playing;
+        state.m_timestamp=Time::getMillisecondCounterHiRes();
+        publish_waiting(state);
+    }
+    playhead_state read() const
+    {
+        playhead_state result;
+        while (true)
+        {
+            uint32 seq0=m_sequence.load(std::memory_order_acquire);
+            if ((seq0 & 1)==0)
+            {
+                result.m_position=m_position.load(std::memory_order_relaxed);
+                result.m_timestamp=m_timestamp.load(std::memory_order_relaxed);
+                result.m_length=m_length.load(std::memory_order_relaxed);
+                result.m_playing=m_playing.load(std::memory_order_relaxed);
+                result.m_looped=m_looped.load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (m_sequence.load(std::memory_order_relaxed)==seq0)
+                    return result;
+            }
+        }
+    }
+    // Continues from the last published position at the nominal playback rate, so that the
+    // playhead moves smoothly between the audio callbacks. Doesn't run further than max_ahead
+    // seconds past the last update, in case the updates have stopped coming.
+    double get_position(double now_ms, double max_ahead=0.25) const
+    {
+        playhead_state state=read();
+        if (state.m_playing==false)
+            return state.m_position;
+        double elapsed=bound_value(0.0,(now_ms-state.m_timestamp)/1000.0,max_ahead);
+        double pos=state.m_position+elapsed;
+        if (state.m_length>0.0 && pos>=state.m_length)
+            pos=state.m_looped==true ? std::fmod(pos,state.m_length) : state.m_length;
+        return pos;
+    }
+private:
+    std::atomic<uint32> m_sequence{0};
+    std::atomic<double> m_position{0.0};
+    std::atomic<double> m_timestamp{0.0};
+    std::atomic<double> m_length{0.0};
+    std::atomic<bool> m_playing{false};
+    std::atomic<bool> m_looped{false};
+};
+
+#endif // JCDP_PLAYHEAD_H
@@ -0,0 +1,104 @@
+/*
+This file is part of CDP Front-end.
+
+CDP front-end is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+CDP front-end is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "jcdp_plugin_render.h"
+#include "jcdp_utilities.h"
+#include "jcdp_cdp_render.h"
+
+#ifdef CDP_VST_ENABLED
+
+extern std::unique_ptr<AudioFormatManager> g_format_manager;
+
+std::shared_ptr<AudioPluginInstance> create_render_plugin_instance(const PluginDescription& desc,
+                                                                   const MemoryBlock& state, String& error)
+{
+    jassert(MessageManager::getInstance()->isThisTheMessageThread());
+    VSTPluginFormat vstformat;
+    // The renders prepare the instance for the sample rate of their input
+    AudioPluginInstance* plugin=vstformat.createInstanceFromDescription(desc,44100.0,512,error);
+    if (plugin==nullptr)
+    {
+        error="Could not create plugin "+desc.name+"\n"+error;
+        return nullptr;
+    }
+    if (state.getSize()>0)
+        plugin->setStateInformation(state.getData(),(int)state.getSize());
+    return std::shared_ptr<AudioPluginInstance>(plugin,[](AudioPluginInstance* p)
+    {
+        if (MessageManager::getInstance()->isThisTheMessageThread()==true)
+            delete p;
+        else
+            MessageManager::callAsync([p]() { delete p; });
+    });
+}
+
+std::pair<String,String> render_plugin_file(AudioPluginInstance& plugin, String infn,
+                                            std::function<bool()> should_cancel, int block_size)
+{
+    std::unique_ptr<AudioFormatReader> reader(g_format_manager->createReaderFor(File(infn)));
+    if (reader==nullptr)
+        return std::make_pair(String(),"Could not open "+infn);
+    const double sr=reader->sampleRate;
+    plugin.setNonRealtime(true);
+    plugin.prepareToPlay(sr,block_size);
+    run_at_scope_end release_plugin([&plugin]() { plugin.releaseResources(); });
+    const int numins=plugin.getTotalNumInputChannels();
+    const int numouts=plugin.getTotalNumOutputChannels();
+    const int filechans=(int)reader->numChannels;
+    if (numouts==0)
+        return std::make_pair(String(),plugin.getName()+" has no audio outputs");
+    String outfn=get_temp_audio_file_name();
+    remove_file_if_exists(outfn);
+    WavAudioFormat outformat;
+    std::unique_ptr<AudioFormatWriter> writer(outformat.createWriterFor(File(outfn).createOutputStream(),
+                                                                        sr,numouts,32,StringPairArray(),0));
+    if (writer==nullptr)
+        return std::make_pair(String(),"Could not create "+outfn);
+    const int64 inlen=reader->lengthInSamples;
+    const int64 latency=jmax(0,plugin.getLatencySamples());
+    const int64 tail=(int64)(sr*jlimit(0.0,10.0,plugin.getTailLengthSeconds()));
+    const int64 total=inlen+latency+tail;
+    AudioBuffer<float> buffer(jmax(numins,numouts,filechans),block_size);
+    MidiBuffer midi;
+    for (int64 pos=0;pos<total;pos+=block_size)
+    {
+        if (should_cancel && should_cancel()==true)
+        {
+            writer=nullptr;
+            remove_file_if_exists(outfn);
+            return std::make_pair(String(),String("Plugin render cancelled"));
+        }
+        const int n=(int)jmin<int64>(block_size,total-pos);
+        buffer.clear();
+        if (pos<inlen)
+            reader->read(&buffer,0,n,pos,true,true);
+        // Mono files feed all the plugin inputs
+        if (filechans==1)
+            for (int ch=1;ch<numins;++ch)
+                buffer.copyFrom(ch,0,buffer,0,0,n);
+        AudioBuffer<float> block(buffer.getArrayOfWritePointers(),buffer.getNumChannels(),n);
+        plugin.processBlock(block,midi);
+        midi.clear();
+        // The first latency samples come from before the input started
+        const int skip=(int)jlimit<int64>(0,n,latency-pos);
+        if (skip<n)
+            writer->writeFromAudioSampleBuffer(block,skip,n-skip);
+    }
+    return std::make_pair(outfn,String());
+}
+
+#endif
@@ -0,0 +1,45 @@
+/*
+This file is part of CDP Front-end.
+
+CDP front-end is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+CDP front-end is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef JCDP_PLUGIN_RENDER_H
+#define JCDP_PLUGIN_RENDER_H
+
+#include <functional>
+#include <memory>
+#include "JuceHeader.h"
+
+#ifdef CDP_VST_ENABLED
+
+// Creates a plugin instance for render_plugin_file, restored to the given state. Must be called
+// on the message thread : off it, the plugin formats hand the creation to the message thread
+// and wait for it, which would hang when the message thread waits for the render. The
+// instance is deleted on the message thread as well. Returns nullptr and sets error on failure.
+std::shared_ptr<AudioPluginInstance> create_render_plugin_instance(const PluginDescription& desc,
+                                                                   const MemoryBlock& state, String& error);
+
+// Renders a file offline through a plugin instance made by create_render_plugin_instance. An
+// instance must only be used by one render at a time, so parallel renders each need their own.
+// The input is streamed in large blocks, the plugin latency is compensated and the tail of the
+// plugin is rendered, up to 10 seconds. Returns the output file and an error message, like
+// render_cdp_file does.
+std::pair<String,String> render_plugin_file(AudioPluginInstance& plugin, String infn,
+                                            std::function<bool()> should_cancel=nullptr,
+                                            int block_size=8192);
+
+#endif
+
+#endif // JCDP_PLUGIN_RENDER_H
@@ -0,0 +1,195 @@
+/*
+This file is part of CDP Front-end.
+
+CDP front-end is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+CDP front-end is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "jcdp_plugin_scanner.h"
+#include "jcdp_utilities.h"
+
+#ifdef CDP_VST_ENABLED
+
+extern std::unique_ptr<PropertiesFile> g_propsfile;
+
+background_plugin_scanner::background_plugin_scanner(File state_file, FileSearchPath search_path, File helper_exe) :
+    Thread("CDP plugin scanner"), m_state_file(state_file), m_search_path(search_path), m_helper_exe(helper_exe)
+{
+    m_timeout_ms=1000*g_propsfile->getIntValue("plugin_scan_timeout",30);
+}
+
+background_plugin_scanner::~background_plugin_scanner()
+{
+    // A plugin scanned in process can't be interrupted, give it some time
+    stopThread(10000);
+}
+
+void background_plugin_scanner::load_state()
+{
+    m_states.clear();
+    if (m_state_file.existsAsFile()==false)
+        return;
+    std::unique_ptr<XmlElement> xml(XmlDocument::parse(m_state_file));
+    if (xml==nullptr)
+        return;
+    forEachXmlChildElementWithTagName(*xml,e,"FILE")
+    {
+        file_state state;
+        state.m_mod_time=e->getStringAttribute("modtime").getLargeIntValue();
+        state.m_size=e->getStringAttribute("size").getLargeIntValue();
+        state.m_failed=e->getBoolAttribute("failed");
+        m_states[e->getStringAttribute("path")]=state;
+    }
+}
+
+void background_plugin_scanner::save_state()
+{
+    XmlElement xml("PLUGINSCANSTATE");
+    for (auto& e : m_states)
+    {
+        XmlElement* child=xml.createNewChildElement("FILE");
+        child->setAttribute("path",e.first);
+        child->setAttribute("modtime",String(e.second.m_mod_time));
+        child->setAttribute("size",String(e.second.m_size));
+        child->setAttribute("failed",e.second.m_failed);
+    }
+    xml.writeToFile(m_state_file,"");
+}
+
+background_plugin_scanner::scan_result background_plugin_scanner::scan_file_in_process(const String& fn,
+                                                                                  std::vector<PluginDescription>& result)
+{
+    VSTPluginFormat vstformat;
+    OwnedArray<PluginDescription> found;
+    vstformat.findAllTypesForFile(found,fn);
+    for (auto desc : found)
+        result.push_back(*desc);
+    return found.isEmpty()==false ? sr_found : sr_failed;
+}
+
+background_plugin_scanner::scan_result background_plugin_scanner::scan_file_out_of_process(const String& fn,
+                                                                                      std::vector<PluginDescription>& result)
+{
+    File out_file=File::createTempFile(".xml");
+    run_at_scope_end remove_out_file([&out_file]() { out_file.deleteFile(); });
+    ChildProcess proc;
+    StringArray args;
+    args.add(m_helper_exe.getFullPathName());
+    args.add("--scan-plugin");
+    args.add(fn);
+    args.add(out_file.getFullPathName());
+    if (proc.start(args,0)==false)
+    {
+        Logger::writeToLog("Could not start plugin scan helper "+m_helper_exe.getFullPathName());
+        return sr_helper_error;
+    }
+    double t0=Time::getMillisecondCounterHiRes();
+    while (proc.waitForProcessToFinish(100)==false)
+    {
+        if (threadShouldExit()==true || Time::getMillisecondCounterHiRes()-t0>m_timeout_ms)
+        {
+            proc.kill();
+            if (threadShouldExit()==false)
+                Logger::writeToLog("Scanning "+fn+" timed out");
+            return sr_failed;
+        }
+    }
+    if (out_file.existsAsFile()==false)
+    {
+        Logger::writeToLog("Plugin scan helper could not scan "+fn+", exit code "+String(proc.getExitCode()));
+        return sr_helper_error;
+    }
+    if (proc.getExitCode()!=0)
+    {
+        Logger::writeToLog("Scanning "+fn+" failed with exit code "+String(proc.getExitCode()));
+        return sr_failed;
+    }
+    std::unique_ptr<XmlElement> xml(XmlDocument::parse(out_file));
+    if (xml==nullptr)
+        return sr_failed;
+    forEachXmlChildElement(*xml,e)
+    {
+        PluginDescription desc;
+        if (desc.loadFromXml(*e)==true)
+            result.push_back(desc);
+    }
+    return result.empty()==false ? sr_found : sr_failed;
+}
+
+void background_plugin_scanner::run()
+{
+    double t0=Time::getMillisecondCounterHiRes();
+    load_state();
+    VSTPluginFormat vstformat;
+    StringArray files=vstformat.searchPathsForPlugins(m_search_path,true);
+    bool out_of_process=m_helper_exe.existsAsFile();
+    if (out_of_process==false)
+        Logger::writeToLog("Plugin scan helper "+m_helper_exe.getFullPathName()+" not found, scanning in process");
+    std::map<String,file_state> new_states;
+    int num_scanned=0;
+    for (auto& fn : files)
+    {
+        if (threadShouldExit()==true)
+            return;
+        File file(fn);
+        file_state state;
+        state.m_mod_time=file.getLastModificationTime().toMilliseconds();
+        state.m_size=file.getSize();
+        auto iter=m_states.find(fn);
+        if (iter!=m_states.end() && iter->second.m_mod_time==state.m_mod_time && iter->second.m_size==state.m_size)
+        {
+            new_states[fn]=iter->second;
+            continue;
+        }
+        std::vector<PluginDescription> found;
+        scan_result result=sr_failed;
+        if (out_of_process==true)
+            result=scan_file_out_of_process(fn,found);
+        else
+            result=scan_file_in_process(fn,found);
+        // Interrupted scans are done again next time
+        if (threadShouldExit()==true)
+            return;
+        // Not remembered either, so that the file is scanned again once the helper works
+        if (result==sr_helper_error)
+            continue;
+        ++num_scanned;
+        state.m_failed=result==sr_failed;
+        new_states[fn]=state;
+        if (result==sr_found && OnPluginsFound)
+            OnPluginsFound(found);
+    }
+    // Removed files are forgotten. The state is saved by the owner, after the plugin list.
+    m_states=new_states;
+    Logger::writeToLog("Plugin scan of "+String(files.size())+" files took "
+                       +String(Time::getMillisecondCounterHiRes()-t0,1)+" ms, "+String(num_scanned)+" files scanned");
+    if (OnFinished)
+        OnFinished(num_scanned);
+}
+
+int write_plugin_scan_result(const String& plugin_fn, const File& out_file)
+{
+    if (XmlElement("PLUGINS").writeToFile(out_file,"")==false)
+        return 1;
+    VSTPluginFormat vstformat;
+    OwnedArray<PluginDescription> found;
+    vstformat.findAllTypesForFile(found,plugin_fn);
+    if (found.isEmpty()==true)
+        return 1;
+    XmlElement xml("PLUGINS");
+    for (auto desc : found)
+        xml.addChildElement(desc->createXml());
+    return xml.writeToFile(out_file,"") ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,79 @@
+/*
+This file is part of CDP Front-end.
+
+CDP front-end is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+CDP front-end is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef JCDP_PLUGIN_SCANNER_H
+#define JCDP_PLUGIN_SCANNER_H
+
+#include <functional>
+#include <map>
+#include <vector>
+#include "JuceHeader.h"
+
+#ifdef CDP_VST_ENABLED
+
+// Scans the VST plugins on a background thread. Files whose modification time and size
+// haven't changed since the last scan are skipped, including the ones that failed, so that
+// a broken plugin is only tried again once it has been updated. When the scan helper
+// exists, each file is scanned by a child process so that a crashing plugin can't take
+// down the host, otherwise the files are scanned in process.
+class background_plugin_scanner : public Thread
+{
+public:
+    background_plugin_scanner(File state_file, FileSearchPath search_path, File helper_exe);
+    ~background_plugin_scanner();
+    // Called from the scan thread with the plugins found in a newly scanned file
+    std::function<void(const std::vector<PluginDescription>&)> OnPluginsFound;
+    // Called from the scan thread after the last file, with the number of files scanned
+    std::function<void(int)> OnFinished;
+    // Records the files scanned as done. Called by the owner once the plugins found have been
+    // saved, so that quitting before that scans the files again next time. Must not be called
+    // while the scan is running.
+    void save_state();
+    void run() override;
+private:
+    struct file_state
+    {
+        int64 m_mod_time=0;
+        int64 m_size=0;
+        bool m_failed=false;
+    };
+    enum scan_result
+    {
+        sr_found,
+        sr_failed,
+        // The helper didn't get as far as loading the plugin, so nothing is known about the file
+        sr_helper_error
+    };
+    void load_state();
+    scan_result scan_file_in_process(const String& fn, std::vector<PluginDescription>& result);
+    scan_result scan_file_out_of_process(const String& fn, std::vector<PluginDescription>& result);
+    File m_state_file;
+    FileSearchPath m_search_path;
+    File m_helper_exe;
+    int m_timeout_ms=30000;
+    std::map<String,file_state> m_states;
+};
+
+// The --scan-plugin mode of the scan helper : writes the plugins found in the file as XML
+// into out_file. Before the plugin is loaded, out_file is created with a placeholder, so that
+// the front-end can tell a crashing plugin from a helper that could not scan at all.
+// Returns the process exit code.
+int write_plugin_scan_result(const String& plugin_fn, const File& out_file);
+
+#endif
+
+#endif // JCDP_PLUGIN_SCANNER_H
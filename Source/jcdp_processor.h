@@ -89,12 +89,16 @@ struct CDP_processor_info
     String m_sub_program;
     String m_mode;
 	String m_pluginname;
-	int m_plugin_id = 0;
+	String m_plugin_identifier;
     bool m_changes_duration=false;
     bool m_is_spectral=false;
     bool m_mono_only=false;
     std::vector<parameter_info> m_parameters;
 	bool m_is_dirty = false;
+    // Descriptor lines of the processor's own parameters, parsed into m_parameters by
+    // load_processor_parameters() when the processor is first used
+    std::shared_ptr<const StringArray> m_pending_parameters;
+    String m_envelope_time_parameter;
 };
 
 #endif // JCDP_PARAMETER_H
@@ -0,0 +1,328 @@
+/*
+This file is part of CDP Front-end.
+
+CDP front-end is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+CDP front-end is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include "jcdp_processor_registry.h"
+#include "jcdp_cdp_render.h"
+
+extern std::unique_ptr<PropertiesFile> g_propsfile;
+
+static const char* g_builtin_descriptors=R"(
+processor "Modify Brassage Brassage" modify brassage 6 changes_duration
+param "Velocity" 0.5 0.01 2.0 automate skew=0.75 step=0.01
+param "Density" 2.0 0.1 10.0 automate
+param "Grain size" 50.0 2.0 500.0 automate
+param "Pitch shift" -6.0 -24.0 24.0 automate
+param "Amplitude" 0.75 0.01 1.0 automate
+param "Space" 0.5 0.0 1.0 automate
+param "Fade in" 5.0 1.00 20.0 automate
+param "Fade out" 5.0 1.00 20.0 automate
+
+# modify brassage 7 infile outfile velocity density hvelocity hdensity
+# grainsize pitchshift amp space bsplice esplice
+# hgrainsize hpitchshift hamp hspace hbsplice hesplice
+processor "Modify Brassage Full Monty" modify brassage 7 changes_duration
+param "Velocity low" 0.5 0.01 2.0 automate skew=0.75 step=0.01
+param "Density low" 2.0 0.1 10.0 automate
+param "Velocity high" 0.55 0.01 2.0 automate skew=0.75 step=0.01
+param "Density high" 2.0 0.1 10.0 automate
+param "Grain size low" 50.0 2.0 500.0 automate
+param "Pitch shift low" -6.0 -24.0 24.0 automate
+param "Amplitude low" 0.75 0.01 1.0 automate
+param "Space low" 0.1 0.0 1.0 automate
+param "Fade in low" 5.0 1.00 20.0 automate
+param "Fade out low" 5.0 1.00 20.0 automate
+param "Grain size high" 5.0 1.00 20.0 automate
+param "Pitch shift high" -2.0 -24.0 24.0 automate
+param "Amplitude high" 0.75 0.01 1.0 automate
+param "Space high" 0.9 0.0 1.0 automate
+param "Fade in high" 5.0 1.00 20.0 automate
+param "Fade out high" 5.0 1.00 20.0 automate
+
+processor "Modify Radical Shred" modify radical 2
+param "Iterations" 1.0 1.0 32.0
+param "Chunk length" 0.1 0.05 2.0
+
+processor "Modify Speed" modify speed 2 changes_duration
+param "Semitones" 0.0 -24.0 24.0 automate
+
+processor "Modify Stack" modify stack - changes_duration
+param "Transpose" -12.0 -12.0 12.0
+param "Num layers" 2.0 2.0 8.0
+param "Lean" 1.0 0.1 2.0
+param "Attack offset" 0.0 0.0 1.0 marker
+param "Gain" 1.0 0.1 2.0
+param "Duration" 1.0 0.01 1.0
+
+processor "Distort Repeat" distort repeat - changes_duration mono
+param "Multiplier" 2.0 2.0 16.0 automate
+param "Cycle cnt" 1.0 1.0 8.0 automate prefix=-c
+
+# grain timewarp infile outfile timestretch_ratio [-blen] [-lgate] [-hminhole] [-twinsize] [-x]
+processor "Grain Timewarp" grain timewarp - changes_duration mono
+param "Ratio" 0.5 0.1 2.0 automate
+
+processor "Distort Pitch" distort pitch - changes_duration mono
+param "Pitch amount" 0.2 0.01 8.0 automate
+param "Cycle cnt" 32.0 2.0 128.0 automate prefix=-c
+
+processor "Distort Interpolate" distort interpolate - changes_duration mono
+param "Multiplier" 4.0 2.00 64.0 automate
+
+processor "Envel Warp Exaggerate" envel warp 3
+param "Window size" 20.0 5.0 100.0
+param "Amount" 0.75 0.05 4.0 automate skew=0.5 step=0.01
+
+processor "Blur Blur" blur blur - spectral
+param "Blur amount" 50.0 1.0 1000.0 automate skew=0.3
+
+processor "Blur Noise" blur noise - spectral
+param "Noise amount" 0.2 0.0 1.0 automate
+
+# blur suppress infile outfile N
+processor "Blur Suppress" blur suppress - spectral
+param "Amount" 4.0 1.0 16.0 automate
+
+processor "Stretch Time" stretch time 1 spectral changes_duration
+param "Time factor" 2.0 1.0 64.0 automate skew=0.25 step=0.01
+
+processor "Stretch Spectrum" stretch spectrum 1 spectral
+param "Freq divide" 64.0 64.0 10000.0 skew=0.25 step=10.0
+param "Max stretch" 2.0 0.1 2.0 step=0.01
+param "Exponent" 0.5 0.1 2.0 step=0.01
+param "Depth" 1.0 0.0 1.0 automate prefix=-d step=0.01
+
+processor "Focus Step" focus step - spectral
+param "Step duration" 0.5 0.1 1.0
+
+processor "Repitch Transpose" repitch transpose 3 spectral
+param "Semitones" 0.0 -24.0 24.0 automate
+
+processor "Focus Accu" focus accu - spectral
+param "Decay" 0.5 0.01 1.0 prefix=-d
+param "Gliss" -0.05 -11.7 11.7 prefix=-g
+
+processor "Strange Waver" strange waver 2 spectral
+param "Rate" 1.0 0.1 32.0
+param "Stretch" 100.0 -1.0 2205.0
+param "Bottom freq" 100.0 20.0 4096.0
+param "Shape" 1.0 0.1 2.0
+
+# texture simple mode infile [infile2] outfile notedata outdur packing scatter tgrid
+# sndfirst sndlast mingain maxgain mindur maxdur minpich maxpich
+# [-aatten] [-pposition] [-sspread] [-rseed] [-w]
+processor "Texture Simple" texture simple 5 changes_duration envelope_time_scale="Out duration"
+param "Base pitch" 60.0 1.0 127.0 notefile
+param "Out duration" 5.0 1.0 60.0 skew=0.5
+param "Packing" 0.2 0.025 1.0 automate
+param "Scatter" 0.0 0.0 5.0 automate
+param "Time Grid" 0.0 0.0 500.0 automate
+param "N/A" 1.0 1.0 1.0
+param "N/A" 1.0 1.0 1.0
+param "Min volume" 64.0 1.0 127.0 automate
+param "Max volume" 64.0 1.0 127.0 automate
+param "Min duration" 0.1 0.02 5.0 automate
+param "Max duration" 0.5 0.02 5.0 automate
+param "Min pitch" 60.0 1.0 127.0 automate
+param "Max pitch" 60.0 1.0 127.0 automate
+
+# Seems to be a processor that is very finicky about the parameter values,
+# probably not worth adding here as the logic for the correct parameter values
+# would need to be reimplemented. Or perhaps extend scramble 2 is just very buggy...
+# extend scramble 2 infile outfile seglen scatter outdur [-wsplen] [-sseed] [-b] [-e]
+# processor "Extend Scramble" extend scramble 2 changes_duration
+# param "Segment length" 0.5 0.01 2.0
+# param "Scatter" 0.1 0.0 2.0
+# param "Output length" 5.0 0.5 15.0
+
+# gate.exe seems to crash right away when launched, so I guess there isn't much to do in the front end
+# about that.
+# gate gate mode infile outfile gatelevel
+# processor "Gate 2" gate gate 2 changes_duration
+# param "Threshold" -20.0 -96.0 0.0
+
+# envnu peakchop 1 insndfile outsndfile wsize pkwidth risetime tempo gain
+processor "Envnu Peakchop" envnu peakchop 1 changes_duration
+param "Window size" 50.0 1.0 64.0
+param "Peak Width" 20.0 0.0 1000.0
+param "Rise Time" 10.0 0.0 100.0
+param "Tempo" 90.0 20.0 3000.0 automate skew=0.3
+param "Gain" 1.0 0.0 1.0 automate
+)";
+
+// Texture needs the base pitch as a note data file instead of a number
+static std::pair<String,bool> write_note_file(parameter_info* parinfo)
+{
+    // Unique name, as parallel renders may write this at the same time
+    String filename=get_temp_audio_file_name("txt");
+    File txt_file(filename);
+    FileOutputStream* os=txt_file.createOutputStream();
+    if (os!=nullptr)
+    {
+        (*os) << String::formatted("%f\n",parinfo->m_current_value);
+        delete os;
+        return std::make_pair(filename,true);
+    }
+    return std::make_pair(String(),false);
+}
+
+static StringArray tokenize_descriptor_line(const String& line)
+{
+    return StringArray::fromTokens(line," \t","\"");
+}
+
+static String get_option_value(const String& option)
+{
+    return option.fromFirstOccurrenceOf("=",false,false).unquoted();
+}
+
+std::vector<CDP_processor_info> parse_processor_descriptors(const String& text, const String& source_name)
+{
+    std::vector<CDP_processor_info> result;
+    std::shared_ptr<StringArray> parameter_lines;
+    StringArray lines=StringArray::fromLines(text);
+    for (int i=0;i<lines.size();++i)
+    {
+        String line=lines[i].trim();
+        if (line.isEmpty()==true || line.startsWithChar('#')==true)
+            continue;
+        if (line.startsWith("processor ")==true)
+        {
+            parameter_lines=nullptr;
+            StringArray tokens=tokenize_descriptor_line(line);
+            if (tokens.size()<5)
+            {
+                Logger::writeToLog(source_name+":"+String(i+1)+" : incomplete processor description");
+                continue;
+            }
+            String mode=tokens[4]=="-" ? String() : tokens[4];
+            CDP_processor_info info(tokens[1].unquoted(),tokens[2],tokens[3],mode,
+                                    tokens.contains("spectral"),tokens.contains("changes_duration"),
+                                    tokens.contains("mono"));
+            for (int j=5;j<tokens.size();++j)
+                if (tokens[j].startsWith("envelope_time_scale=")==true)
+                    info.m_envelope_time_parameter=get_option_value(tokens[j]);
+            parameter_lines=std::make_shared<StringArray>();
+            info.m_pending_parameters=parameter_lines;
+            result.push_back(std::move(info));
+        }
+        else if (line.startsWith("param ")==true && parameter_lines!=nullptr)
+            parameter_lines->add(line);
+        else
+            Logger::writeToLog(source_name+":"+String(i+1)+" : ignored line "+line);
+    }
+    return result;
+}
+
+void load_processor_parameters(CDP_processor_info& proc)
+{
+    if (proc.m_pending_parameters==nullptr)
+        return;
+    auto lines=proc.m_pending_parameters;
+    proc.m_pending_parameters=nullptr;
+    for (auto& line : *lines)
+    {
+        StringArray tokens=tokenize_descriptor_line(line);
+        if (tokens.size()<5)
+        {
+            Logger::writeToLog("Incomplete parameter description for "+proc.m_title+" : "+line);
+            continue;
+        }
+        parameter_info par(tokens[1].unquoted(),tokens[2].getDoubleValue(),
+                           tokens[3].getDoubleValue(),tokens[4].getDoubleValue());
+        for (int i=5;i<tokens.size();++i)
+        {
+            const String& option=tokens[i];
+            if (option=="automate")
+                par.m_can_automate=true;
+            else if (option.startsWith("prefix=")==true)
+                par.m_cmd_prefix=get_option_value(option);
+            else if (option.startsWith("skew=")==true)
+            {
+                par.m_skewed=true;
+                par.m_skew=get_option_value(option).getDoubleValue();
+            }
+            else if (option.startsWith("step=")==true)
+                par.m_step=get_option_value(option).getDoubleValue();
+            else if (option=="marker")
+                par.m_notifs=parameter_info::waveformmarker;
+            else if (option=="notefile")
+                par.m_cmd_arg_formatter=write_note_file;
+            else
+                Logger::writeToLog("Unknown parameter option "+option+" for "+proc.m_title);
+        }
+        proc.m_parameters.push_back(par);
+    }
+    if (proc.m_envelope_time_parameter.isEmpty()==true)
+        return;
+    // The envelopes are stretched to the output duration instead of the input duration
+    for (int i=0;i<proc.m_parameters.size();++i)
+    {
+        if (proc.m_parameters[i].m_name!=proc.m_envelope_time_parameter)
+            continue;
+        for (auto& e : proc.m_parameters)
+        {
+            if (e.m_can_automate==true)
+            {
+                e.m_envelope_time_scaling_func=[i](CDP_processor_info* procinfo)
+                {
+                    return procinfo->m_parameters[i].m_current_value;
+                };
+            }
+        }
+        return;
+    }
+    Logger::writeToLog("No parameter "+proc.m_envelope_time_parameter+" for envelope time scaling in "+proc.m_title);
+}
+
+File get_user_processor_descriptor_file()
+{
+    return g_propsfile->getFile().getParentDirectory().getChildFile("cdp_processors.txt");
+}
+
+std::vector<CDP_processor_info> make_cdp_processors()
+{
+    std::vector<CDP_processor_info> result=parse_processor_descriptors(g_builtin_descriptors,"built in processors");
+    File userfile=get_user_processor_descriptor_file();
+    if (userfile.existsAsFile()==true)
+    {
+        auto userprocs=parse_processor_descriptors(userfile.loadFileAsString(),userfile.getFileName());
+        for (auto& e : userprocs)
+        {
+            int index=index_of_processor(result,e.m_title);
+            if (index>=0)
+                result[index]=std::move(e);
+            else
+                result.push_back(std::move(e));
+        }
+        Logger::writeToLog("Added "+String(userprocs.size())+" processors from "+userfile.getFullPathName());
+    }
+    std::sort(result.begin(),result.end(),
+              [](const CDP_processor_info& lhs, const CDP_processor_info &rhs)
+    {
+        return lhs.m_title<rhs.m_title;
+    });
+    return result;
+}
+
+int index_of_processor(const std::vector<CDP_processor_info>& procs, const String& title)
+{
+    for (int i=0;i<procs.size();++i)
+        if (procs[i].m_title==title)
+            return i;
+    return -1;
+}
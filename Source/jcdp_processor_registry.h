@@ -0,0 +1,53 @@
+/*
+This file is part of CDP Front-end.
+
+CDP front-end is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+CDP front-end is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef JCDP_PROCESSOR_REGISTRY_H
+#define JCDP_PROCESSOR_REGISTRY_H
+
+#include <vector>
+#include "JuceHeader.h"
+#include "jcdp_processor.h"
+
+// The CDP processors are described by text, one processor line followed by its parameter lines :
+//
+//   processor "<title>" <program> <subprogram> <mode or -> [spectral] [changes_duration] [mono]
+//             [envelope_time_scale="<parameter name>"]
+//   param "<name>" <default> <minimum> <maximum> [automate] [prefix=<cmd prefix>] [skew=<factor>]
+//             [step=<size>] [marker] [notefile]
+//
+// Empty lines and lines starting with # are ignored. The Pre volume and FFT parameters are
+// added by CDP_processor_info itself.
+
+// Only the processor lines are parsed, the parameter lines are kept for load_processor_parameters()
+std::vector<CDP_processor_info> parse_processor_descriptors(const String& text, const String& source_name);
+
+// Parses the pending parameter lines of the processor, does nothing if already done. Must be
+// called before the parameters are used.
+void load_processor_parameters(CDP_processor_info& proc);
+
+// Processors added by the user without rebuilding the front-end, in the settings folder
+File get_user_processor_descriptor_file();
+
+// All the CDP processors the front-end knows about, sorted by title. The built in descriptors
+// are extended and overridden by the user descriptor file when it exists. Shared by the REAPER
+// extension, the stand alone application and the command line renderer.
+std::vector<CDP_processor_info> make_cdp_processors();
+
+// Returns -1 if there's no processor with the title
+int index_of_processor(const std::vector<CDP_processor_info>& procs, const String& title);
+
+#endif // JCDP_PROCESSOR_REGISTRY_H
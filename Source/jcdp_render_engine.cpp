@@ -0,0 +1,196 @@
+/*
+This file is part of CDP Front-end.
+
+CDP front-end is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+CDP front-end is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "jcdp_render_engine.h"
+#include "jcdp_cdp_render.h"
+#include "jcdp_plugin_render.h"
+
+#undef min
+#undef max
+
+static int resolve_num_threads(int num_threads)
+{
+    if (num_threads<=0)
+        return SystemStats::getNumCpus();
+    return num_threads;
+}
+
+cdp_render_engine::cdp_render_engine(int num_threads) :
+    m_num_threads(resolve_num_threads(num_threads)),
+    m_state(std::make_shared<engine_state>(resolve_num_threads(num_threads)))
+{
+}
+
+cdp_render_engine::~cdp_render_engine()
+{
+    {
+        // Waits for a callback that is running, later ones see the flag
+        ScopedLock locker(m_state->m_callback_lock);
+        m_state->m_shutting_down=true;
+    }
+    // The running CDP processes are killed by the cancel checks of their renders. Joining them
+    // here could block the message thread, so the state is kept alive until they are done.
+    retire(std::move(m_state));
+}
+
+static CriticalSection g_retired_engines_lock;
+
+void cdp_render_engine::retire(std::shared_ptr<engine_state> state)
+{
+    static std::vector<std::shared_ptr<engine_state>> retired;
+    // Without a state to add, every retired engine is waited for
+    bool wait_for_all=state==nullptr;
+    std::vector<std::shared_ptr<engine_state>> finished;
+    {
+        ScopedLock locker(g_retired_engines_lock);
+        if (state!=nullptr)
+            retired.push_back(std::move(state));
+        for (int i=(int)retired.size()-1; i>=0; --i)
+        {
+            if (wait_for_all==true || retired[i]->m_pool.getNumJobs()==0)
+            {
+                finished.push_back(std::move(retired[i]));
+                retired.erase(retired.begin()+i);
+            }
+        }
+    }
+    for (auto& e : finished)
+    {
+        while (e->m_pool.getNumJobs()>0)
+            Thread::sleep(5);
+    }
+    // The idle threads of the finished pools are joined here, outside the lock
+}
+
+void cdp_render_engine::wait_for_retired_engines()
+{
+    retire(nullptr);
+}
+
+std::future<cdp_render_result> cdp_render_engine::submit(cdp_render_request request,
+                                                         cancel_func should_cancel,
+                                                         finished_func on_finished)
+{
+    auto promise=std::make_shared<std::promise<cdp_render_result>>();
+    auto shared_request=std::make_shared<cdp_render_request>(std::move(request));
+    // The pool is a member of the state, so the state outlives the jobs
+    engine_state* state=m_state.get();
+    state->m_pool.addJob([state,promise,shared_request,should_cancel,on_finished]()
+    {
+        // The callbacks of the requester may refer to objects that are destroyed together
+        // with the engine, so they are only called while the engine exists
+        cancel_func guarded_cancel=nullptr;
+        if (should_cancel)
+        {
+            guarded_cancel=[state,&should_cancel]()
+            {
+                ScopedLock locker(state->m_callback_lock);
+                return state->m_shutting_down==true || should_cancel();
+            };
+        }
+        cdp_render_result result=render(*state,*shared_request,guarded_cancel);
+        {
+            ScopedLock locker(state->m_callback_lock);
+            if (state->m_shutting_down==false)
+            {
+                if (on_finished)
+                    on_finished(result);
+            }
+            else if (result.ok()==true)
+            {
+                // Nobody is left to take the output
+                remove_file_if_exists(result.m_output_file);
+                result.m_output_file=String();
+                result.m_cancelled=true;
+            }
+        }
+        promise->set_value(result);
+    });
+    return promise->get_future();
+}
+
+cdp_render_result cdp_render_engine::render(cdp_render_request& request, cancel_func should_cancel)
+{
+    return render(*m_state,request,should_cancel);
+}
+
+cdp_render_result cdp_render_engine::render(engine_state& state, cdp_render_request& request, cancel_func should_cancel)
+{
+    auto cancelled=[&state,&should_cancel]()
+    {
+        return state.m_shutting_down==true || (should_cancel && should_cancel());
+    };
+    cdp_render_result result;
+    double t0=Time::getMillisecondCounterHiRes();
+    run_at_scope_end set_elapsed([&result,t0]()
+    {
+        result.m_elapsed_seconds=(Time::getMillisecondCounterHiRes()-t0)/1000.0;
+    });
+    if (cancelled()==true)
+    {
+        result.m_cancelled=true;
+        return result;
+    }
+    file_cleaner cleaner;
+    String infntouse=request.m_input_file;
+    if (request.m_cut_input==true && request.m_time_selection.isValid()==true)
+    {
+        auto cut_result=cut_file(infntouse,request.m_time_selection);
+        if (cut_result.first.isEmpty()==true)
+        {
+            result.m_error="CDP sfedit cut failed\n"+cut_result.second;
+            return result;
+        }
+        if (cut_result.first!=infntouse)
+            cleaner.add(cut_result.first);
+        infntouse=cut_result.first;
+    }
+    double prevolume=request.m_processor.m_parameters[0].m_current_value;
+    if (request.m_apply_pre_volume==true && fuzzy_is_zero(prevolume)==false)
+    {
+        infntouse=adjust_file_volume(infntouse,prevolume);
+        if (infntouse.isEmpty()==true)
+        {
+            result.m_error="CDP adjust volume failed";
+            return result;
+        }
+        cleaner.add(infntouse);
+    }
+    std::pair<String,String> render_result;
+#ifdef CDP_VST_ENABLED
+    if (request.m_processor.m_main_program=="vstplugin")
+            {
+        if (request.m_plugin_instance!=nullptr)
+            render_result=render_plugin_file(*request.m_plugin_instance,infntouse,cancelled);
+        else
+            render_result.second="Plugin instance missing for "+request.m_plugin_description.name;
+    }
+    else
+#endif
+    render_result=render_cdp_file(request.m_processor,infntouse,request.m_time_selection,
+                                  request.m_source_length,cleaner,&state.m_breakpoint_cache,cancelled);
+    if (cancelled()==true)
+    {
+        if (render_result.first.isNotEmpty())
+            cleaner.add(render_result.first);
+        result.m_cancelled=true;
+        return result;
+    }
+    result.m_output_file=render_result.first;
+    result.m_error=render_result.second;
+    return result;
+}
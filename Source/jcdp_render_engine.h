@@ -0,0 +1,108 @@
+/*
+This file is part of CDP Front-end.
+
+CDP front-end is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+CDP front-end is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef JCDP_RENDER_ENGINE_H
+#define JCDP_RENDER_ENGINE_H
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+#include "JuceHeader.h"
+#include "jcdp_utilities.h"
+#include "jcdp_processor.h"
+#include "jcdp_breakpoints.h"
+
+// Everything a render needs, copied from the GUI or the command line when the render is
+// requested, so the render doesn't depend on any widgets or on later edits
+struct cdp_render_request
+{
+    CDP_processor_info m_processor;
+    String m_input_file;
+    // The part of the input to render. The envelopes span the whole input, or m_source_length
+    // seconds if the input file was already cut from a longer source.
+    time_range m_time_selection;
+    double m_source_length=0.0;
+    // False when the input was already cut to the time selection, like REAPER take exports are
+    bool m_cut_input=true;
+    // False when the pre volume was already applied to the input
+    bool m_apply_pre_volume=true;
+#ifdef CDP_VST_ENABLED
+    // For the vstplugin processors, the plugin and its state at the time of the request
+    PluginDescription m_plugin_description;
+    MemoryBlock m_plugin_state;
+    // The instance the request is rendered with. Plugins are created on the message thread,
+    // see create_render_plugin_instance, so the requester makes it before submitting.
+    std::shared_ptr<AudioPluginInstance> m_plugin_instance;
+#endif
+};
+
+struct cdp_render_result
+{
+    // Owned by the receiver of the result
+    String m_output_file;
+    String m_error;
+    bool m_cancelled=false;
+    double m_elapsed_seconds=0.0;
+    bool ok() const { return m_output_file.isNotEmpty(); }
+};
+
+// Runs render requests on its own threads. The results are delivered through futures and
+// optionally through a callback, which is called on the render thread. The threads belong to
+// a state shared with the jobs, so destroying the engine doesn't wait for the renders.
+class cdp_render_engine
+{
+public:
+    using cancel_func=std::function<bool()>;
+    using finished_func=std::function<void(const cdp_render_result&)>;
+    // num_threads<=0 uses a thread per CPU
+    cdp_render_engine(int num_threads=0);
+    // Cancels the renders and returns without waiting for them. The callbacks aren't called
+    // after this returns and the outputs of the renders that still finish are removed.
+    ~cdp_render_engine();
+    cdp_render_engine(const cdp_render_engine&)=delete;
+    cdp_render_engine& operator=(const cdp_render_engine&)=delete;
+    std::future<cdp_render_result> submit(cdp_render_request request,
+                                          cancel_func should_cancel=nullptr,
+                                          finished_func on_finished=nullptr);
+    // Renders on the calling thread
+    cdp_render_result render(cdp_render_request& request, cancel_func should_cancel=nullptr);
+    int get_num_threads() const { return m_num_threads; }
+    // Renders queued or running
+    int get_num_pending() const { return m_state->m_pool.getNumJobs(); }
+    // Waits for the renders of the destroyed engines to wind down. Called once at exit, before
+    // JUCE is shut down.
+    static void wait_for_retired_engines();
+private:
+    struct engine_state
+    {
+        engine_state(int num_threads) : m_pool(num_threads) {}
+        // Shared by the renders, so that unchanged envelopes aren't exported again
+        breakpoint_file_cache m_breakpoint_cache;
+        std::atomic<bool> m_shutting_down{false};
+        // Held while the callbacks of the requests run, so that shutting down can't overlap them
+        CriticalSection m_callback_lock;
+        // Last, so that the jobs are gone before the rest of the state is destroyed
+        ThreadPool m_pool;
+    };
+    static cdp_render_result render(engine_state& state, cdp_render_request& request, cancel_func should_cancel);
+    static void retire(std::shared_ptr<engine_state> state);
+    int m_num_threads=1;
+    std::shared_ptr<engine_state> m_state;
+};
+
+#endif // JCDP_RENDER_ENGINE_H
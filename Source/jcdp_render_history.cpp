@@ -0,0 +1,96 @@
+/*
+This file is part of CDP Front-end.
+
+CDP front-end is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+CDP front-end is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "jcdp_render_history.h"
+#include "jcdp_processor.h"
+#include "jcdp_utilities.h"
+
+String render_history_entry::get_description() const
+{
+    String result=m_processor_title;
+    // The first parameter is the pre volume, which all the processors have
+    for (size_t i=1;i<m_parameters.size();++i)
+    {
+        const render_parameter_snapshot& par=m_parameters[i];
+        result+=(i==1 ? " : " : ", ")+par.m_name+" ";
+        if (par.m_automated==true)
+            result+="(automated)";
+        else result+=String(par.m_value,2);
+    }
+    return result;
+}
+
+render_history_entry make_render_history_entry(String fn, const CDP_processor_info& proc)
+{
+    render_history_entry entry;
+    entry.m_filename=fn;
+    entry.m_processor_title=proc.m_title;
+    entry.m_render_time=Time::getCurrentTime();
+    for (auto& par : proc.m_parameters)
+    {
+        render_parameter_snapshot snap;
+        snap.m_name=par.m_name;
+        snap.m_value=par.m_current_value;
+        snap.m_automated=par.m_automation_enabled;
+        if (par.m_automation_enabled==true)
+            snap.m_nodes=par.m_env.get_all_nodes();
+        entry.m_parameters.push_back(std::move(snap));
+    }
+    return entry;
+}
+
+render_history::~render_history()
+{
+    OnFileRemoved=nullptr;
+    m_capacity=0;
+    trim();
+}
+
+void render_history::add(render_history_entry entry)
+{
+    int index=find(entry.m_filename);
+    if (index>=0)
+        m_entries.erase(m_entries.begin()+index);
+    m_entries.push_front(std::move(entry));
+    trim();
+}
+
+int render_history::find(const String& fn) const
+{
+    for (int i=0;i<(int)m_entries.size();++i)
+        if (m_entries[i].m_filename==fn)
+            return i;
+    return -1;
+}
+
+void render_history::set_capacity(int capacity)
+{
+    m_capacity=jmax(1,capacity);
+    trim();
+}
+
+void render_history::trim()
+{
+    while ((int)m_entries.size()>m_capacity)
+    {
+        String fn=m_entries.back().m_filename;
+        m_entries.pop_back();
+        if (OnFileRemoved)
+            OnFileRemoved(fn);
+        remove_file_if_exists(fn);
+    }
+}
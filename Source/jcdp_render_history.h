@@ -0,0 +1,75 @@
+/*
+This file is part of CDP Front-end.
+
+CDP front-end is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+CDP front-end is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef JCDP_RENDER_HISTORY_H
+#define JCDP_RENDER_HISTORY_H
+
+#include <deque>
+#include <functional>
+#include <vector>
+#include "JuceHeader.h"
+#include "jcdp_envelope.h"
+
+struct CDP_processor_info;
+
+// The setting of one parameter at the time of a render
+struct render_parameter_snapshot
+{
+    String m_name;
+    double m_value=0.0;
+    bool m_automated=false;
+    // Only stored when the parameter was automated
+    nodes_t m_nodes;
+};
+
+struct render_history_entry
+{
+    String m_filename;
+    String m_processor_title;
+    std::vector<render_parameter_snapshot> m_parameters;
+    Time m_render_time;
+    // One line summary of the parameter values, for the status label
+    String get_description() const;
+};
+
+render_history_entry make_render_history_entry(String fn, const CDP_processor_info& proc);
+
+// The most recent rendered outputs, newest first. The history owns the files and deletes
+// them when they drop out of it or when the history is destroyed.
+class render_history
+{
+public:
+    render_history(int capacity=8) : m_capacity(jmax(1,capacity)) {}
+    ~render_history();
+    render_history(const render_history&)=delete;
+    render_history& operator=(const render_history&)=delete;
+    void add(render_history_entry entry);
+    int size() const { return (int)m_entries.size(); }
+    const render_history_entry& get(int index) const { return m_entries[index]; }
+    // Returns -1 if the file is not in the history
+    int find(const String& fn) const;
+    int get_capacity() const { return m_capacity; }
+    void set_capacity(int capacity);
+    // Called with the file name just before a file is deleted
+    std::function<void(const String&)> OnFileRemoved;
+private:
+    void trim();
+    std::deque<render_history_entry> m_entries;
+    int m_capacity=8;
+};
+
+#endif // JCDP_RENDER_HISTORY_H
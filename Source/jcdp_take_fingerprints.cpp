@@ -0,0 +1,179 @@
+/*
+This file is part of CDP Front-end.
+
+CDP front-end is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+CDP front-end is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "jcdp_take_fingerprints.h"
+#include "reaper_plugin_functions.h"
+#undef min
+#undef max
+
+static String get_accessor_hash(AudioAccessor* accessor)
+{
+    char hash[129];
+    memset(hash,0,129);
+    GetAudioAccessorHash(accessor,hash);
+    return String(hash);
+}
+
+take_fingerprint_service::take_fingerprint_service(int check_interval_ms, int max_checks_per_tick) :
+    m_check_interval(check_interval_ms), m_max_checks_per_tick(max_checks_per_tick)
+{
+}
+
+take_fingerprint_service::~take_fingerprint_service()
+{
+    for (auto& e : m_takes)
+        release(e);
+}
+
+void take_fingerprint_service::track(MediaItem_Take* take)
+{
+    if (take==nullptr || is_tracked(take)==true)
+        return;
+    tracked_take entry;
+    entry.m_take=take;
+    entry.m_accessor=CreateTakeAudioAccessor(take);
+    if (entry.m_accessor==nullptr)
+        return;
+    entry.m_hash=get_accessor_hash(entry.m_accessor);
+    entry.m_last_check=Time::getMillisecondCounterHiRes();
+    m_takes.push_back(entry);
+    if (isTimerRunning()==false)
+        startTimer(jmax(10,m_check_interval/10));
+}
+
+void take_fingerprint_service::untrack(MediaItem_Take* take)
+{
+    for (size_t i=0;i<m_takes.size();++i)
+    {
+        if (m_takes[i].m_take==take)
+        {
+            release(m_takes[i]);
+            m_takes.erase(m_takes.begin()+i);
+            break;
+        }
+    }
+    if (m_takes.empty()==true)
+        stopTimer();
+}
+
+bool take_fingerprint_service::is_tracked(MediaItem_Take* take) const
+{
+    return find(take)!=nullptr;
+}
+
+AudioAccessor* take_fingerprint_service::get_accessor(MediaItem_Take* take) const
+{
+    const tracked_take* entry=find(take);
+    if (entry!=nullptr)
+        return entry->m_accessor;
+    return nullptr;
+}
+
+String take_fingerprint_service::get_hash(MediaItem_Take* take) const
+{
+    const tracked_take* entry=find(take);
+    if (entry!=nullptr)
+        return entry->m_hash;
+    return String();
+}
+
+bool take_fingerprint_service::refresh(MediaItem_Take* take)
+{
+    for (auto& e : m_takes)
+    {
+        if (e.m_take==take && e.m_accessor!=nullptr && AudioAccessorValidateState(e.m_accessor)==true)
+        {
+            String hash=get_accessor_hash(e.m_accessor);
+            if (hash!=e.m_hash)
+            {
+                e.m_hash=hash;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+const take_fingerprint_service::tracked_take* take_fingerprint_service::find(MediaItem_Take* take) const
+{
+    for (auto& e : m_takes)
+        if (e.m_take==take)
+            return &e;
+    return nullptr;
+}
+
+void take_fingerprint_service::release(tracked_take& entry)
+{
+    if (entry.m_accessor!=nullptr)
+        DestroyAudioAccessor(entry.m_accessor);
+    entry.m_accessor=nullptr;
+}
+
+void take_fingerprint_service::timerCallback()
+{
+    if (m_takes.empty()==true)
+        return;
+    const double now=Time::getMillisecondCounterHiRes();
+    std::vector<std::pair<MediaItem_Take*,String>> changed;
+    int checks=0;
+    // Round robin, so that all the takes get their turn even when there are many
+    for (size_t n=0;n<m_takes.size() && checks<m_max_checks_per_tick;++n)
+    {
+        if (m_next_check>=m_takes.size())
+            m_next_check=0;
+        tracked_take& entry=m_takes[m_next_check];
+        if (now-entry.m_last_check<m_check_interval)
+        {
+            ++m_next_check;
+            continue;
+        }
+        ++checks;
+        entry.m_last_check=now;
+        if (ValidatePtr(entry.m_take,"MediaItem_Take*")==false)
+        {
+            // The take was deleted
+            release(entry);
+            m_takes.erase(m_takes.begin()+m_next_check);
+            continue;
+        }
+        ++m_next_check;
+        if (AudioAccessorValidateState(entry.m_accessor)==true)
+        {
+            String hash=get_accessor_hash(entry.m_accessor);
+            if (hash!=entry.m_hash)
+            {
+                entry.m_hash=hash;
+                changed.emplace_back(entry.m_take,hash);
+            }
+        }
+    }
+    // The callback may well track or untrack takes
+    if (OnTakeChanged)
+        for (auto& e : changed)
+            OnTakeChanged(e.first,e.second);
+}
+
+std::pair<String, String> pre_process_file_with_reaper_api(MediaItem_Take* take, take_fingerprint_service& fingerprints,
+                                                           time_range tr, double gain, bool makemono)
+{
+    // The take may have been edited since its last check
+    fingerprints.refresh(take);
+    AudioAccessor* accessor=fingerprints.get_accessor(take);
+    if (accessor==nullptr)
+        return pre_process_file_with_reaper_api(take,tr,gain,makemono);
+    return pre_process_file_with_reaper_api(take,accessor,fingerprints.get_hash(take),tr,gain,makemono);
+}
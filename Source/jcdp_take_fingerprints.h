@@ -0,0 +1,74 @@
+/*
+This file is part of CDP Front-end.
+
+CDP front-end is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+CDP front-end is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef JCDP_TAKE_FINGERPRINTS_H
+#define JCDP_TAKE_FINGERPRINTS_H
+
+#include <functional>
+#include <vector>
+#include "JuceHeader.h"
+#include "jcdp_utilities.h"
+
+// Keeps one AudioAccessor per tracked take and notices when the audio of the takes changes.
+// REAPER's accessors can only be used from the main thread, so instead of a worker thread
+// the checks are spread over timer ticks : each tick validates at most max_checks_per_tick
+// takes, and each take at most once per check interval. The accessor and hash can be
+// reused for exporting the take, so that no new accessor is needed just to name the file.
+class take_fingerprint_service : public Timer
+{
+public:
+    take_fingerprint_service(int check_interval_ms=1000, int max_checks_per_tick=4);
+    ~take_fingerprint_service();
+    take_fingerprint_service(const take_fingerprint_service&)=delete;
+    take_fingerprint_service& operator=(const take_fingerprint_service&)=delete;
+    // Starts tracking the take if it isn't yet
+    void track(MediaItem_Take* take);
+    void untrack(MediaItem_Take* take);
+    bool is_tracked(MediaItem_Take* take) const;
+    // Null if the take is not tracked
+    AudioAccessor* get_accessor(MediaItem_Take* take) const;
+    // Empty if the take is not tracked
+    String get_hash(MediaItem_Take* take) const;
+    // Checks the take right away instead of waiting for its turn, so that the accessor and
+    // hash are current. Returns true if the audio changed. The change is then the caller's to
+    // handle and OnTakeChanged isn't called for it.
+    bool refresh(MediaItem_Take* take);
+    // Called on the message thread with the new hash after the audio of a take changed
+    std::function<void(MediaItem_Take*, const String&)> OnTakeChanged;
+    void timerCallback();
+private:
+    struct tracked_take
+    {
+        MediaItem_Take* m_take=nullptr;
+        AudioAccessor* m_accessor=nullptr;
+        String m_hash;
+        double m_last_check=0.0;
+    };
+    const tracked_take* find(MediaItem_Take* take) const;
+    void release(tracked_take& entry);
+    std::vector<tracked_take> m_takes;
+    size_t m_next_check=0;
+    int m_check_interval=1000;
+    int m_max_checks_per_tick=4;
+};
+
+// As pre_process_file_with_reaper_api, but reuses the service's accessor and hash for
+// tracked takes
+std::pair<String, String> pre_process_file_with_reaper_api(MediaItem_Take* take, take_fingerprint_service& fingerprints,
+                                                           time_range tr, double gain, bool makemono);
+
+#endif // JCDP_TAKE_FINGERPRINTS_H
@@ -0,0 +1,290 @@
+/*
+This file is part of CDP Front-end.
+
+CDP front-end is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+CDP front-end is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "jcdp_thumbnail.h"
+#include "jcdp_utilities.h"
+
+#ifdef WIN32
+#undef min
+#undef max
+#endif
+
+extern std::unique_ptr<AudioFormatManager> g_format_manager;
+extern std::unique_ptr<ThreadPool> g_thumb_thread_pool;
+
+// The coarser levels are reduced from the first one, so that zoomed out views
+// don't have to go through millions of blocks when painting
+static const int c_num_levels=4;
+static const int c_level_factor=16;
+// Must be a multiple of the block size of the coarsest level
+static const int64 c_samples_per_chunk=1<<20;
+static const int c_read_size=65536;
+
+class chunked_thumbnail::chunk_job : public ThreadPoolJob
+{
+public:
+    chunk_job(chunked_thumbnail* owner, int chunk) :
+        ThreadPoolJob("thumbnail chunk"), m_owner(owner), m_chunk(chunk) {}
+    JobStatus runJob()
+    {
+        m_owner->scan_chunk(m_chunk,*this);
+        return jobHasFinished;
+    }
+    chunked_thumbnail* m_owner=nullptr;
+    int m_chunk=0;
+};
+
+class chunked_thumbnail::job_selector : public ThreadPool::JobSelector
+{
+public:
+    job_selector(chunked_thumbnail* owner) : m_owner(owner) {}
+    bool isJobSuitable(ThreadPoolJob* job)
+    {
+        chunk_job* cjob=dynamic_cast<chunk_job*>(job);
+        return cjob!=nullptr && cjob->m_owner==m_owner;
+    }
+private:
+    chunked_thumbnail* m_owner=nullptr;
+};
+
+inline int8 quantize_peak(float x)
+{
+    return (int8)bound_value(-127,roundToInt(x*127.0f),127);
+}
+
+std::shared_ptr<const thumbnail_peaks> thumbnail_cache::find(const File& file)
+{
+    const String path=file.getFullPathName();
+    const int64 mod_time=file.getLastModificationTime().toMilliseconds();
+    const int64 size=file.getSize();
+    ScopedLock locker(m_cs);
+    for (size_t i=0;i<m_entries.size();++i)
+    {
+        if (m_entries[i].m_path==path && m_entries[i].m_mod_time==mod_time && m_entries[i].m_size==size)
+        {
+            entry found=m_entries[i];
+            m_entries.erase(m_entries.begin()+i);
+            m_entries.push_back(found);
+            return found.m_peaks;
+        }
+    }
+    return nullptr;
+}
+
+void thumbnail_cache::add(const File& file, std::shared_ptr<const thumbnail_peaks> peaks)
+{
+    entry e;
+    e.m_path=file.getFullPathName();
+    e.m_mod_time=file.getLastModificationTime().toMilliseconds();
+    e.m_size=file.getSize();
+    e.m_peaks=peaks;
+    ScopedLock locker(m_cs);
+    m_entries.erase(std::remove_if(m_entries.begin(),m_entries.end(),
+                                   [&e](const entry& old) { return old.m_path==e.m_path; }),m_entries.end());
+    m_entries.push_back(e);
+    while ((int)m_entries.size()>m_max_entries)
+        m_entries.erase(m_entries.begin());
+}
+
+chunked_thumbnail::chunked_thumbnail(String fn, ThreadPool* pool, thumbnail_cache* cache) :
+    m_filename(fn), m_pool(pool), m_cache(cache)
+{
+    if (m_pool==nullptr)
+        m_pool=g_thumb_thread_pool.get();
+    if (m_cache!=nullptr)
+        m_peaks=m_cache->find(File(fn));
+    if (m_peaks!=nullptr)
+    {
+        m_num_chunks=(int)((m_peaks->length+c_samples_per_chunk-1)/c_samples_per_chunk);
+        m_chunk_ready.reset(new std::atomic<bool>[m_num_chunks]);
+        for (int i=0;i<m_num_chunks;++i)
+            m_chunk_ready[i]=true;
+        m_chunks_done=m_num_chunks;
+        return;
+    }
+    m_scanned_peaks=std::make_shared<thumbnail_peaks>();
+    m_peaks=m_scanned_peaks;
+    std::unique_ptr<AudioFormatReader> reader(g_format_manager->createReaderFor(File(fn)));
+    if (reader==nullptr || m_pool==nullptr)
+        return;
+    thumbnail_peaks& peaks=*m_scanned_peaks;
+    peaks.num_channels=reader->numChannels;
+    peaks.samplerate=reader->sampleRate;
+    peaks.length=reader->lengthInSamples;
+    int block_size=c_samples_per_block;
+    for (int i=0;i<c_num_levels;++i)
+    {
+        thumbnail_peak_level level;
+        level.block_size=block_size;
+        level.num_blocks=(peaks.length+block_size-1)/block_size;
+        level.mins.resize(level.num_blocks*peaks.num_channels);
+        level.maxs.resize(level.num_blocks*peaks.num_channels);
+        peaks.levels.push_back(std::move(level));
+        block_size*=c_level_factor;
+    }
+    m_num_chunks=(int)((peaks.length+c_samples_per_chunk-1)/c_samples_per_chunk);
+    m_chunk_ready.reset(new std::atomic<bool>[m_num_chunks]);
+    for (int i=0;i<m_num_chunks;++i)
+        m_chunk_ready[i]=false;
+    m_scan_start_time=Time::getMillisecondCounterHiRes();
+    for (int i=0;i<m_num_chunks;++i)
+        m_pool->addJob(new chunk_job(this,i),true);
+}
+
+chunked_thumbnail::~chunked_thumbnail()
+{
+    // The jobs check for exiting between reads, so waiting for them without a time limit is
+    // short. That also covers the jobs that are just finishing and may still be about to send
+    // the change message.
+    if (m_pool!=nullptr && m_scanned_peaks!=nullptr)
+    {
+        job_selector selector(this);
+        m_pool->removeAllJobs(true,-1,&selector);
+    }
+}
+
+double chunked_thumbnail::get_total_length() const
+{
+    if (m_peaks->samplerate<=0.0)
+        return 0.0;
+    return m_peaks->length/m_peaks->samplerate;
+}
+
+bool chunked_thumbnail::wait_until_loaded(int timeout_ms) const
+{
+    double t0=Time::getMillisecondCounterHiRes();
+    while (is_fully_loaded()==false)
+    {
+        if (Time::getMillisecondCounterHiRes()-t0>timeout_ms)
+            return false;
+        Thread::sleep(1);
+    }
+    return true;
+}
+
+void chunked_thumbnail::scan_chunk(int chunk, ThreadPoolJob& job)
+{
+    // If the file can't be read anymore, the chunk is just left empty
+    std::unique_ptr<AudioFormatReader> reader(g_format_manager->createReaderFor(File(m_filename)));
+    if (reader==nullptr)
+        m_read_failed=true;
+    thumbnail_peaks& peaks=*m_scanned_peaks;
+    const int numchannels=peaks.num_channels;
+    const int64 chunk_start=chunk*c_samples_per_chunk;
+    const int64 chunk_end=std::min(chunk_start+c_samples_per_chunk,peaks.length);
+    AudioSampleBuffer buf(numchannels,c_read_size);
+    thumbnail_peak_level& level0=peaks.levels[0];
+    for (int64 pos=chunk_start;pos<chunk_end && reader!=nullptr;pos+=c_read_size)
+    {
+        if (job.shouldExit()==true)
+            return;
+        const int numsamples=(int)std::min<int64>(c_read_size,chunk_end-pos);
+        if (reader->read(reinterpret_cast<int**>(buf.getArrayOfWritePointers()),numchannels,pos,numsamples,false)==false)
+        {
+            buf.clear();
+            m_read_failed=true;
+        }
+        for (int ch=0;ch<numchannels;++ch)
+        {
+            float* data=buf.getWritePointer(ch);
+            if (reader->usesFloatingPointData==false)
+                FloatVectorOperations::convertFixedToFloat(data,reinterpret_cast<const int*>(data),1.0f/0x7fffffff,numsamples);
+            int64 block=ch*level0.num_blocks+pos/c_samples_per_block;
+            for (int i=0;i<numsamples;i+=c_samples_per_block)
+            {
+                // findMinAndMax uses the SIMD implementations of FloatVectorOperations
+                auto minmax=FloatVectorOperations::findMinAndMax(data+i,std::min(c_samples_per_block,numsamples-i));
+                level0.mins[block]=quantize_peak(minmax.getStart());
+                level0.maxs[block]=quantize_peak(minmax.getEnd());
+                ++block;
+            }
+        }
+    }
+    for (int i=1;i<c_num_levels;++i)
+    {
+        const thumbnail_peak_level& src=peaks.levels[i-1];
+        thumbnail_peak_level& dest=peaks.levels[i];
+        const int64 block0=chunk_start/dest.block_size;
+        const int64 block1=(chunk_end+dest.block_size-1)/dest.block_size;
+        for (int ch=0;ch<numchannels;++ch)
+        {
+            for (int64 j=block0;j<block1;++j)
+            {
+                const int64 src0=ch*src.num_blocks+j*c_level_factor;
+                const int64 src1=ch*src.num_blocks+std::min((j+1)*c_level_factor,src.num_blocks);
+                dest.mins[ch*dest.num_blocks+j]=*std::min_element(src.mins.begin()+src0,src.mins.begin()+src1);
+                dest.maxs[ch*dest.num_blocks+j]=*std::max_element(src.maxs.begin()+src0,src.maxs.begin()+src1);
+            }
+        }
+    }
+    m_chunk_ready[chunk].store(true);
+    if (++m_chunks_done==m_num_chunks)
+    {
+        m_scan_time=Time::getMillisecondCounterHiRes()-m_scan_start_time;
+        // A file that couldn't be read completely is scanned again next time
+        if (m_cache!=nullptr && m_read_failed.load()==false)
+            m_cache->add(File(m_filename),m_peaks);
+    }
+    sendChangeMessage();
+}
+
+bool chunked_thumbnail::is_block_range_ready(const thumbnail_peak_level& level, int64 block0, int64 block1) const
+{
+    const int64 chunk0=block0*level.block_size/c_samples_per_chunk;
+    const int64 chunk1=((block1-1)*level.block_size)/c_samples_per_chunk;
+    for (int64 i=chunk0;i<=chunk1;++i)
+        if (m_chunk_ready[i].load()==false)
+            return false;
+    return true;
+}
+
+void chunked_thumbnail::draw_channels(Graphics& g, juce::Rectangle<int> area, double t0, double t1)
+{
+    const thumbnail_peaks& peaks=*m_peaks;
+    const int numchannels=peaks.num_channels;
+    if (numchannels==0 || peaks.levels.empty()==true || area.getWidth()<=0 || t1<=t0)
+        return;
+    const double samples_per_pixel=(t1-t0)*peaks.samplerate/area.getWidth();
+    int level_index=0;
+    while (level_index+1<c_num_levels && peaks.levels[level_index+1].block_size<=samples_per_pixel)
+        ++level_index;
+    const thumbnail_peak_level& level=peaks.levels[level_index];
+    const float lane_height=(float)area.getHeight()/numchannels;
+    for (int ch=0;ch<numchannels;++ch)
+    {
+        const float mid=area.getY()+lane_height*(ch+0.5f);
+        const float amp=lane_height*0.5f/127.0f;
+        const int64 offset=ch*level.num_blocks;
+        for (int i=0;i<area.getWidth();++i)
+        {
+            const double s0=t0*peaks.samplerate+i*samples_per_pixel;
+            int64 block0=(int64)(s0/level.block_size);
+            int64 block1=(int64)ceil((s0+samples_per_pixel)/level.block_size);
+            if (block0>=level.num_blocks)
+                break;
+            block0=std::max<int64>(block0,0);
+            block1=bound_value<int64>(block0+1,block1,level.num_blocks);
+            if (is_block_range_ready(level,block0,block1)==false)
+                continue;
+            int8 minv=*std::min_element(level.mins.begin()+offset+block0,level.mins.begin()+offset+block1);
+            int8 maxv=*std::max_element(level.maxs.begin()+offset+block0,level.maxs.begin()+offset+block1);
+            float top=mid-maxv*amp;
+            float bottom=mid-minv*amp;
+            g.drawVerticalLine(area.getX()+i,top,std::max(bottom,top+1.0f));
+        }
+    }
+}
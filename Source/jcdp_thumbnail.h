@@ -0,0 +1,107 @@
+/*
+This file is part of CDP Front-end.
+
+CDP front-end is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+CDP front-end is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef JCDP_THUMBNAIL_H
+#define JCDP_THUMBNAIL_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "JuceHeader.h"
+
+// Waveform overview for the WaveFormComponent. AudioThumbnail scans the source file in order
+// on a single thread, so long multichannel files take a long time to appear. Here the file is
+// split into chunks that are scanned concurrently on a thread pool, each job with its own reader,
+// and every finished chunk can be drawn right away.
+
+struct thumbnail_peak_level
+{
+    int block_size=0;
+    int64 num_blocks=0;
+    // min/max per block, 8 bits like in AudioThumbnail, indexed channel*num_blocks+block
+    std::vector<int8> mins;
+    std::vector<int8> maxs;
+};
+
+struct thumbnail_peaks
+{
+    int num_channels=0;
+    double samplerate=0.0;
+    int64 length=0;
+    std::vector<thumbnail_peak_level> levels;
+};
+
+// Keeps the peaks of the most recently scanned files, like AudioThumbnailCache did, so that
+// showing a file again doesn't scan it again. Files are told apart by their modification time
+// and size as well as their path.
+class thumbnail_cache
+{
+public:
+    thumbnail_cache(int max_entries) : m_max_entries(max_entries) {}
+    std::shared_ptr<const thumbnail_peaks> find(const File& file);
+    void add(const File& file, std::shared_ptr<const thumbnail_peaks> peaks);
+private:
+    struct entry
+    {
+        String m_path;
+        int64 m_mod_time=0;
+        int64 m_size=0;
+        std::shared_ptr<const thumbnail_peaks> m_peaks;
+    };
+    CriticalSection m_cs;
+    // The most recently used last
+    std::vector<entry> m_entries;
+    int m_max_entries=0;
+};
+
+class chunked_thumbnail : public ChangeBroadcaster
+{
+public:
+    static const int c_samples_per_block=64;
+    // The peaks of files fully scanned are put into the cache, if there is one
+    chunked_thumbnail(String fn, ThreadPool* pool=nullptr, thumbnail_cache* cache=nullptr);
+    ~chunked_thumbnail();
+    chunked_thumbnail(const chunked_thumbnail&)=delete;
+    chunked_thumbnail& operator=(const chunked_thumbnail&)=delete;
+    double get_total_length() const;
+    int get_num_channels() const { return m_peaks->num_channels; }
+    bool is_fully_loaded() const { return m_chunks_done.load()==m_num_chunks; }
+    bool wait_until_loaded(int timeout_ms) const;
+    // Milliseconds it took to scan the whole file, 0.0 until done
+    double get_scan_time() const { return m_scan_time.load(); }
+    void draw_channels(Graphics& g, juce::Rectangle<int> area, double t0, double t1);
+private:
+    class chunk_job;
+    class job_selector;
+    void scan_chunk(int chunk, ThreadPoolJob& job);
+    bool is_block_range_ready(const thumbnail_peak_level& level, int64 block0, int64 block1) const;
+    String m_filename;
+    ThreadPool* m_pool=nullptr;
+    thumbnail_cache* m_cache=nullptr;
+    std::shared_ptr<const thumbnail_peaks> m_peaks;
+    // The same peaks, written by the chunk jobs each to its own chunk. Null when the peaks
+    // came from the cache.
+    std::shared_ptr<thumbnail_peaks> m_scanned_peaks;
+    int m_num_chunks=0;
+    std::unique_ptr<std::atomic<bool>[]> m_chunk_ready;
+    std::atomic<int> m_chunks_done{0};
+    std::atomic<bool> m_read_failed{false};
+    std::atomic<double> m_scan_time{0.0};
+    double m_scan_start_time=0.0;
+};
+
+#endif // JCDP_THUMBNAIL_H
@@ -116,14 +116,26 @@ std::pair<String, String> pre_process_file_with_reaper_api(MediaItem_Take* take,
 {
 	if (take != nullptr)
 	{
-		PCM_source* src = (PCM_source*)GetSetMediaItemTakeInfo(take, "P_SOURCE", nullptr);
 		auto accessor = make_audio_accessor(take);
-		
-		if (accessor != nullptr && src!=nullptr)
+		if (accessor != nullptr)
 		{
 			char accessor_hash[129];
 			memset(accessor_hash, 0, 129);
 			GetAudioAccessorHash(accessor.get(), accessor_hash);
+			return pre_process_file_with_reaper_api(take, accessor.get(), String(accessor_hash), tr, gain, makemono);
+		}
+	}
+	return std::make_pair(String(), String());
+}
+
+std::pair<String, String> pre_process_file_with_reaper_api(MediaItem_Take* take, AudioAccessor* accessor,
+	String accessor_hash, time_range tr, double gain, bool makemono)
+{
+	if (take != nullptr)
+	{
+		PCM_source* src = (PCM_source*)GetSetMediaItemTakeInfo(take, "P_SOURCE", nullptr);
+		if (accessor != nullptr && src!=nullptr)
+		{
 			char projpathbuf[4096];
 			GetProjectPath(projpathbuf, 4096);
 			if (strlen(projpathbuf) == 0)
@@ -134,13 +146,13 @@ std::pair<String, String> pre_process_file_with_reaper_api(MediaItem_Take* take,
 				String timerangehash;
 				size_t trhash = combine_hashes(tr.start(),tr.end());
 				timerangehash = String((int64)trhash);
-				outfilename = String(projpathbuf) + "/" + c_file_prefix + String(accessor_hash) + "_" + timerangehash + ".wav";
+				outfilename = String(projpathbuf) + "/" + c_file_prefix + accessor_hash + "_" + timerangehash + ".wav";
 			} else
-				outfilename=String(projpathbuf) + "/" + c_file_prefix + String(accessor_hash) + ".wav";
+				outfilename=String(projpathbuf) + "/" + c_file_prefix + accessor_hash + ".wav";
 			if (does_file_exist(outfilename) == true && fuzzy_compare(1.0,gain)==true)
 				return std::make_pair(outfilename, String());
 			//readbg() << accessor_hash << "\n";
-			double accessor_len = GetAudioAccessorEndTime(accessor.get());
+			double accessor_len = GetAudioAccessorEndTime(accessor);
 			if (tr.isValid() == true)
 				accessor_len = tr.length();
 			std::unique_ptr<PCM_sink> sink;
@@ -166,7 +178,7 @@ std::pair<String, String> pre_process_file_with_reaper_api(MediaItem_Take* take,
 				while (counter < source_end)
 				{
 					int samples_to_read = std::min(int64_t(outsamplerate*(source_end - counter)), int64_t(diskbufsize));
-					GetAudioAccessorSamples(accessor.get(), outsamplerate, outnumchans, counter, samples_to_read, disk_in_buf.data());
+					GetAudioAccessorSamples(accessor, outsamplerate, outnumchans, counter, samples_to_read, disk_in_buf.data());
 					disk_out_buf.init_from_interleaved(disk_in_buf, [gain](double x, size_t) { return gain*x; });
 					sink->WriteDoubles(disk_out_buf.get(), samples_to_read, outnumchans, 0, 1);
 					counter += (double)diskbufsize / outsamplerate;
@@ -301,51 +313,4 @@ std::streamsize readbgbuf::xsputn(const char *buffer, std::streamsize n) {
     std::string buf(buffer, buffer + n);
     ShowConsoleMsg(buf.c_str());
     return n;
-}
-
-ReaperTakeAccessorWrapper::ReaperTakeAccessorWrapper(MediaItem_Take* take)
-	: m_take(take)
-{
-	memset(&m_hash, 0, 128);
-	if (m_take != nullptr)
-	{
-		m_accessor=CreateTakeAudioAccessor(m_take);
-		update_hash();
-	}
-}
-
-ReaperTakeAccessorWrapper::~ReaperTakeAccessorWrapper()
-{
-	if (m_accessor != nullptr)
-	{
-		DestroyAudioAccessor(m_accessor);
-	}
-}
-
-ReaperTakeAccessorWrapper::ReaperTakeAccessorWrapper(ReaperTakeAccessorWrapper&& other)
-	: m_take(other.m_take), m_accessor(other.m_accessor)
-{
-	std::copy(std::begin(other.m_hash), std::end(other.m_hash), std::begin(m_hash));
-	other.m_take = nullptr;
-	other.m_accessor = nullptr;
-}
-
-void ReaperTakeAccessorWrapper::update_hash()
-{
-	if (m_accessor != nullptr)
-	{
-		GetAudioAccessorHash(m_accessor, m_hash);
-	}
-}
-
-bool ReaperTakeAccessorWrapper::has_changed()
-{
-	if (m_accessor != nullptr)
-	{
-		char temp[128];
-		memset(temp, 0, 128);
-		GetAudioAccessorHash(m_accessor, temp);
-		return !std::equal(std::begin(m_hash), std::end(m_hash), std::begin(temp));
-	}
-	return false;
 }
\ No newline at end of file
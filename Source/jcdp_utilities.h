@@ -231,6 +231,11 @@ public:
         for (auto& e : arr)
             m_files.push_back({e,ignore_safety_check});
     }
+    // Holds a reference to a shared resource, like a cached file, until the cleanup
+    void keep_alive(std::shared_ptr<void> obj)
+    {
+        m_keep_alive.push_back(std::move(obj));
+    }
 private:
     struct entry
     {
@@ -240,6 +245,7 @@ private:
         bool ignore_safety_check=false;
     };
     std::vector<entry> m_files;
+    std::vector<std::shared_ptr<void>> m_keep_alive;
 };
 
 struct run_at_scope_end
@@ -298,23 +304,6 @@ struct audio_source_info
 audio_source_info get_audio_source_info(String fn);
 audio_source_info get_audio_source_info_cached(String fn);
 
-class ReaperTakeAccessorWrapper
-{
-public:
-	ReaperTakeAccessorWrapper() {}
-	ReaperTakeAccessorWrapper(MediaItem_Take* take);
-	~ReaperTakeAccessorWrapper();
-	bool has_changed();
-	ReaperTakeAccessorWrapper(const ReaperTakeAccessorWrapper&) = delete;
-	ReaperTakeAccessorWrapper& operator=(const ReaperTakeAccessorWrapper&) = delete;
-	ReaperTakeAccessorWrapper(ReaperTakeAccessorWrapper&& other);
-private:
-	MediaItem_Take* m_take = nullptr;
-	AudioAccessor* m_accessor = nullptr;
-	char m_hash[128];
-	void update_hash();
-};
-
 namespace jcdp
 {
 
@@ -552,8 +541,9 @@ public:
         return String();
     }
 
-    // All must succeed, otherwise returns string with the output of some failed process
-    String wait_for_finished(int wait_ms)
+    // All must succeed, otherwise returns string with the output of some failed process.
+    // When should_cancel returns true, the processes still running are killed.
+    String wait_for_finished(int wait_ms, std::function<bool()> should_cancel=nullptr)
     {
         int success_count=0;
         int count=m_processes.size();
@@ -574,6 +564,12 @@ public:
             }
             if (success_count==count)
                 return String();
+            if (should_cancel && should_cancel()==true)
+            {
+                for (auto& e : m_processes)
+                    e->kill();
+                return "Cancelled";
+            }
             double t1=Time::getMillisecondCounterHiRes();
             if (t1-t0>wait_ms)
                 return "Wait time exceeded";
@@ -631,6 +627,9 @@ private:
 
 String preprocess_file(String infn, time_range tr, double gain, bool makemono);
 std::pair<String, String> pre_process_file_with_reaper_api(MediaItem_Take* take, time_range tr, double gain, bool makemono);
+// Uses an existing accessor and its hash instead of creating a new accessor
+std::pair<String, String> pre_process_file_with_reaper_api(MediaItem_Take* take, AudioAccessor* accessor,
+	String accessor_hash, time_range tr, double gain, bool makemono);
 
 #ifdef WIN32
 #include "Windows.h"
@@ -24,8 +24,14 @@ along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
 #undef max
 #endif
 
-extern std::unique_ptr<AudioThumbnailCache> g_thumb_cache;
 extern std::unique_ptr<AudioFormatManager> g_format_manager;
+extern std::unique_ptr<thumbnail_cache> g_thumb_cache;
+
+// The thumbnail stores min/max pairs for blocks of this many samples, so when zoomed
+// in closer than that, the waveform is drawn from the actual samples instead
+static const int c_thumb_samples_per_block=chunked_thumbnail::c_samples_per_block;
+// Zoom level (in pixels per sample) at which the individual samples are drawn as lollipops
+static const double c_lollipop_pixels_per_sample=6.0;
 
 WaveFormComponent::WaveFormComponent(bool usetimer) :
     m_waveformcolour(Colours::darkcyan)
@@ -53,11 +59,12 @@ void WaveFormComponent::paint(Graphics &g)
 	bool file_is_set = false;
 	if (m_thumb!=nullptr)
     {
-        double soundlen=m_thumb->getTotalLength();
+        double soundlen=m_thumb->get_total_length();
 		if (soundlen > 0.0)
 		{
 			file_is_set = true;
-			m_thumb->drawChannels(g, rect, soundlen*m_view_start, soundlen*m_view_end, 1.0);
+			if (draw_sample_view(g, rect, soundlen*m_view_start, soundlen*m_view_end) == false)
+				m_thumb->draw_channels(g, rect, soundlen*m_view_start, soundlen*m_view_end);
 			g.setColour(Colours::white);
 			String text;
 			if (m_render_elapsed_time > 0.0)
@@ -132,14 +139,122 @@ void WaveFormComponent::set_file(String fn)
 {
     m_audio_fn=fn;
     File thumbfile(fn);
-    m_thumb_source=new FileInputSource(thumbfile);
     delete m_thumb;
-    m_thumb=new AudioThumbnail(64,*g_format_manager,*g_thumb_cache);
-    m_thumb->setSource(m_thumb_source);
+    m_thumb=new chunked_thumbnail(fn,nullptr,g_thumb_cache.get());
     m_thumb->addChangeListener(this);
+    m_mapped_reader.reset();
+    m_sample_view_range=Range<int64>();
+    AudioFormat* format=g_format_manager->findFormatForFileExtension(thumbfile.getFileExtension());
+    if (format!=nullptr)
+        m_mapped_reader.reset(format->createMemoryMappedReader(thumbfile));
     repaint();
 }
 
+bool WaveFormComponent::read_sample_view(Range<int64> samples)
+{
+    if (samples==m_sample_view_range)
+        return true;
+    m_sample_view_range=Range<int64>();
+    // Formats that can't be memory mapped are read with a temporary reader, so that
+    // the file isn't kept open (the rendered files get deleted when they are replaced)
+    std::unique_ptr<AudioFormatReader> stream_reader;
+    AudioFormatReader* reader=nullptr;
+    if (m_mapped_reader!=nullptr && m_mapped_reader->mapSectionOfFile(samples)==true)
+        reader=m_mapped_reader.get();
+    if (reader==nullptr)
+    {
+        stream_reader.reset(g_format_manager->createReaderFor(File(m_audio_fn)));
+        reader=stream_reader.get();
+    }
+    if (reader==nullptr)
+        return false;
+    const int numsamples=(int)samples.getLength();
+    const int numchans=(int)reader->numChannels;
+    m_sample_view_buffer.setSize(numchans,numsamples,false,false,true);
+    bool ok=reader->read(reinterpret_cast<int**>(m_sample_view_buffer.getArrayOfWritePointers()),
+                         numchans,samples.getStart(),numsamples,false);
+    if (ok==true && reader->usesFloatingPointData==false)
+    {
+        for (int i=0;i<numchans;++i)
+        {
+            float* data=m_sample_view_buffer.getWritePointer(i);
+            FloatVectorOperations::convertFixedToFloat(data,reinterpret_cast<const int*>(data),1.0f/0x7fffffff,numsamples);
+        }
+    }
+    if (m_mapped_reader!=nullptr)
+        m_mapped_reader->mapSectionOfFile(Range<int64>()); // don't keep the file mapped between repaints
+    if (ok==true)
+        m_sample_view_range=samples;
+    return ok;
+}
+
+bool WaveFormComponent::draw_sample_view(Graphics& g, juce::Rectangle<int> rect, double t0, double t1)
+{
+    if (rect.getWidth()<=0 || t1<=t0)
+        return false;
+    auto info=get_audio_source_info_cached(m_audio_fn);
+    if (info.samplerate<=0 || info.num_channels<=0)
+        return false;
+    const double samples_per_pixel=(t1-t0)*info.samplerate/rect.getWidth();
+    if (samples_per_pixel>=c_thumb_samples_per_block)
+        return false;
+    const int64 file_len=info.m_length_frames;
+    const int64 first_sample=bound_value<int64>(0,(int64)floor(t0*info.samplerate),file_len);
+    const int64 last_sample=bound_value<int64>(0,(int64)ceil(t1*info.samplerate)+1,file_len);
+    if (last_sample-first_sample<2)
+        return false;
+    if (read_sample_view(Range<int64>(first_sample,last_sample))==false)
+        return false;
+    const int numsamples=m_sample_view_buffer.getNumSamples();
+    const int numchans=m_sample_view_buffer.getNumChannels();
+    const float lane_height=(float)rect.getHeight()/numchans;
+    auto x_of_sample=[&](int64 index)
+    {
+        return (float)scale_value_from_range_to_range((double)index/info.samplerate,
+                                                      t0,t1,rect.getX(),rect.getRight());
+    };
+    for (int ch=0;ch<numchans;++ch)
+    {
+        const float* data=m_sample_view_buffer.getReadPointer(ch);
+        const float mid=rect.getY()+lane_height*(ch+0.5f);
+        const float amp=lane_height*0.5f;
+        if (samples_per_pixel>1.0)
+        {
+            // Exact peaks of the samples under each pixel column
+            for (int i=0;i<rect.getWidth();++i)
+            {
+                int64 s0=(int64)(t0*info.samplerate+i*samples_per_pixel)-first_sample;
+                int64 s1=(int64)(t0*info.samplerate+(i+1)*samples_per_pixel)-first_sample+1;
+                s0=bound_value<int64>(0,s0,numsamples-1);
+                s1=bound_value<int64>(s0+1,s1,numsamples);
+                auto minmax=FloatVectorOperations::findMinAndMax(data+s0,(int)(s1-s0));
+                float top=mid-minmax.getEnd()*amp;
+                float bottom=mid-minmax.getStart()*amp;
+                g.drawVerticalLine(rect.getX()+i,top,std::max(bottom,top+1.0f));
+            }
+        } else
+        {
+            Path path;
+            path.startNewSubPath(x_of_sample(first_sample),mid-data[0]*amp);
+            for (int i=1;i<numsamples;++i)
+                path.lineTo(x_of_sample(first_sample+i),mid-data[i]*amp);
+            g.strokePath(path,PathStrokeType(1.0f));
+            if (1.0/samples_per_pixel>=c_lollipop_pixels_per_sample)
+            {
+                const float dotsize=4.0f;
+                for (int i=0;i<numsamples;++i)
+                {
+                    float x=x_of_sample(first_sample+i);
+                    float y=mid-data[i]*amp;
+                    g.drawLine(x,mid,x,y);
+                    g.fillEllipse(x-dotsize/2,y-dotsize/2,dotsize,dotsize);
+                }
+            }
+        }
+    }
+    return true;
+}
+
 void WaveFormComponent::mouseDown(const MouseEvent &event)
 {
     if (m_thumb==nullptr)
@@ -171,7 +286,7 @@ void WaveFormComponent::mouseDown(const MouseEvent &event)
     }
 
     m_hot_area=get_hot_area(event);
-    double soundlen=m_thumb->getTotalLength();
+    double soundlen=m_thumb->get_total_length();
     double selx0=scale_value_from_range_to_range((double)event.x,
                                                  0.0,
                                                  (double)getWidth(),
@@ -262,7 +377,7 @@ void WaveFormComponent::mouseDrag(const MouseEvent &event)
             return;
         }
     }
-    double soundlen=m_thumb->getTotalLength();
+    double soundlen=m_thumb->get_total_length();
     double selx0=scale_value_from_range_to_range((double)event.x,
                                                  0.0,
                                                  (double)getWidth(),
@@ -324,14 +439,29 @@ bool WaveFormComponent::keyPressed(const KeyPress &key)
         return false;
     if (m_edit_mode==em_envelope && m_env!=nullptr && key==KeyPress::deleteKey)
     {
-        double soundlen=m_thumb->getTotalLength();
+        double soundlen=m_thumb->get_total_length();
         double norm_env_start=1.0/soundlen*m_envelope_time_range.start();
         double norm_env_end=1.0/soundlen*m_envelope_time_range.end();
+        m_env->m_env.begin_edit_step();
         m_env->m_env.delete_nodes_in_time_range(norm_env_start,norm_env_end);
+        m_env->m_env.end_edit_step();
         repaint();
         sendChangeMessage();
         return true;
     }
+    if (m_edit_mode==em_envelope && m_env!=nullptr)
+    {
+        const bool undo_key=key==KeyPress('z',ModifierKeys::commandModifier,0);
+        const bool redo_key=key==KeyPress('z',ModifierKeys::commandModifier|ModifierKeys::shiftModifier,0) ||
+                key==KeyPress('y',ModifierKeys::commandModifier,0);
+        if ((undo_key==true && m_env->m_env.undo()==true) || (redo_key==true && m_env->m_env.redo()==true))
+        {
+            repaint();
+            sendChangeMessage();
+        }
+        if (undo_key==true || redo_key==true)
+            return true;
+    }
     if (m_edit_mode==em_waveform && key==KeyPress::deleteKey && CutFileFunc)
     {
         CutFileFunc(m_waveform_time_range);
@@ -354,7 +484,7 @@ void WaveFormComponent::set_parameter(parameter_info *env)
         m_env_editor->EnvelopeLength=[this]()
         {
 			if (m_thumb != nullptr)
-				return m_thumb->getTotalLength();
+				return m_thumb->get_total_length();
 			return 0.0;
 		};
     }
@@ -391,7 +521,7 @@ WaveFormComponent::hot_area WaveFormComponent::get_hot_area(const MouseEvent &ev
         return ha_none;
     if (m_thumb!=nullptr)
     {
-        double soundlen=m_thumb->getTotalLength();
+        double soundlen=m_thumb->get_total_length();
         //double selx0=getWidth()/soundlen*get_active_time_range().start();
         //double selx1=getWidth()/soundlen*get_active_time_range().end();
         double selx0=scale_value_from_range_to_range(get_active_time_range().start(),
@@ -427,39 +557,48 @@ void envelope_editor::paint(Graphics &g, juce::Rectangle<int> r)
     g.saveState();
     g.setColour(m_envelope_colour);
     const float nodesize=8.0f;
-    for (int i=0;i<m_parameter->m_env.GetNumNodes()-1;++i)
-    {
-        const envelope_node& node0=m_parameter->m_env.GetNodeAtIndex(i);
-        const envelope_node& node1=m_parameter->m_env.GetNodeAtIndex(i+1);
-        float xcor0=scale_value_from_range_to_range(node0.Time,
-                                                    m_view_range.first,m_view_range.second,
-                                                    0.0,(double)r.getWidth());
-        float xcor1=scale_value_from_range_to_range(node1.Time,
-                                                    m_view_range.first,m_view_range.second,
-                                                    0.0,(double)r.getWidth());
-        float ycor0=(1.0-node0.Value)*r.getHeight();
-        float ycor1=(1.0-node1.Value)*r.getHeight();
-        double value_delta=node1.Value-node0.Value;
-        int num_sub_segments=std::max((int)((node1.Time-node0.Time)*r.getWidth()/8),8);
-        //g.drawText(String(num_sub_segments),xcor0,10,50,20,Justification::left);
-        for (int j=0;j<num_sub_segments;++j)
+    const breakpoint_envelope& env=m_parameter->m_env;
+    const envelope_node_arrays& nodes=env.get_node_arrays();
+    auto x_of_time=[this,&r](double t)
+    {
+        return (float)scale_value_from_range_to_range(t,m_view_range.first,m_view_range.second,
+                                                      0.0,(double)r.getWidth());
+    };
+    if (nodes.size()>1)
+    {
+        // Evaluate the curve about once per pixel over the visible part between the first and last nodes
+        const double t0=std::max(nodes.time(0),m_view_range.first);
+        const double t1=std::min(nodes.time(nodes.size()-1),m_view_range.second);
+        if (t0<t1)
         {
-            float offset0=(xcor1-xcor0)/num_sub_segments*j;
-            float offset1=(xcor1-xcor0)/num_sub_segments*(j+1);
-            double to_shaping=1.0/(num_sub_segments)*j;
-            double shaped=node0.Value+value_delta*get_shaped_value(to_shaping,0,node0.ShapeParam1,0.0);
-            float ycor2=(1.0-shaped)*r.getHeight();
-            to_shaping=1.0/num_sub_segments*(j+1);
-            shaped=node0.Value+value_delta*get_shaped_value(to_shaping,0,node0.ShapeParam1,0.0);
-            float ycor3=(1.0-shaped)*r.getHeight();
-            g.drawLine(xcor0+offset0,ycor2,xcor0+offset1,ycor3);
+            const float xcor0=x_of_time(t0);
+            const float xcor1=x_of_time(t1);
+            const int num_points=std::max((int)(xcor1-xcor0)+2,2);
+            m_paint_values.resize(num_points);
+            env.evaluate_block(t0,(t1-t0)/(num_points-1),m_paint_values.data(),num_points);
+            Path path;
+            path.preallocateSpace(3*num_points);
+            for (int i=0;i<num_points;++i)
+            {
+                float xcor=xcor0+(xcor1-xcor0)*i/(num_points-1);
+                float ycor=(1.0f-m_paint_values[i])*r.getHeight();
+                if (i==0)
+                    path.startNewSubPath(xcor,ycor);
+                else
+                    path.lineTo(xcor,ycor);
+            }
+            g.strokePath(path,PathStrokeType(1.0f));
         }
-
         if (m_draw_handles==true)
         {
-            g.drawEllipse(xcor0-nodesize/2,ycor0-nodesize/2,nodesize,nodesize,1.0f);
-            if (i==m_parameter->m_env.GetNumNodes()-2)
-                g.drawEllipse(xcor1-nodesize/2,ycor1-nodesize/2,nodesize,nodesize,1.0f);
+            const double margin=(m_view_range.second-m_view_range.first)*nodesize/std::max(r.getWidth(),1);
+            for (int i=nodes.lower_bound(m_view_range.first-margin);
+                 i<nodes.size() && nodes.time(i)<=m_view_range.second+margin;++i)
+            {
+                float xcor=x_of_time(nodes.time(i));
+                float ycor=(1.0-nodes.value(i))*r.getHeight();
+                g.drawEllipse(xcor-nodesize/2,ycor-nodesize/2,nodesize,nodesize,1.0f);
+            }
         }
     }
     g.setColour(Colours::white);
@@ -478,12 +617,15 @@ void envelope_editor::on_mouse_event(ISubComponent::mouse_event_type evtype, con
     {
         m_mouse_down=true;
         m_hot_node=-1;
+        // Everything done until the mouse is released is undone as one step
+        m_parameter->m_env.begin_edit_step();
         handle_click(event);
     }
     if (evtype==met_release)
     {
         m_mouse_down=false;
         m_hot_node=-1;
+        m_parameter->m_env.end_edit_step();
     }
     if (evtype==met_drag)
     {
@@ -511,8 +653,9 @@ void envelope_editor::handle_click(const MouseEvent &e)
                                                     0.0,(double)m_parent->getWidth(),
                                                     m_view_range.first,m_view_range.second);
         double value=(1.0/m_parent->getHeight()*e.y);
+        m_hit_index.update(m_parameter->m_env,m_view_range,m_parent->getWidth());
         m_parameter->m_env.AddNode(envelope_node(time,1.0-value));
-        m_parameter->m_env.SortNodes();
+        m_hit_index.node_inserted(m_parameter->m_env,time);
         m_hot_node=get_hot_node(e.x,e.y);
         m_dirty=true;
         return;
@@ -524,8 +667,10 @@ void envelope_editor::handle_click(const MouseEvent &e)
     {
         if (m_parameter->m_env.GetNumNodes()>2)
         {
+            double removed_time=m_parameter->m_env.GetNodeAtIndex(m_hot_node).Time;
+            m_hit_index.update(m_parameter->m_env,m_view_range,m_parent->getWidth());
             m_parameter->m_env.DeleteNode(m_hot_node);
-            m_parameter->m_env.SortNodes();
+            m_hit_index.node_removed(m_parameter->m_env,removed_time);
             m_hot_node=-1;
             m_dirty=true;
         } else
@@ -565,7 +710,9 @@ void envelope_editor::handle_drag(const MouseEvent &e)
         double delta=1.0/200*e.getDistanceFromDragStartX();
         envelope_node new_node=m_parameter->m_env.GetNodeAtIndex(m_hot_segment);
         new_node.ShapeParam1=bound_value(0.0,m_segment_par1+delta,1.0);
+        m_hit_index.update(m_parameter->m_env,m_view_range,m_parent->getWidth());
         m_parameter->m_env.SetNode(m_hot_segment,new_node);
+        m_hit_index.node_moved(m_parameter->m_env,new_node.Time,new_node.Time);
         m_dirty=true;
         return;
     }
@@ -587,8 +734,10 @@ void envelope_editor::handle_drag(const MouseEvent &e)
             new_node=envelope_node(0.0,values.first,shap_p1);
         if (m_hot_node==m_parameter->m_env.GetNumNodes()-1)
             new_node=envelope_node(1.0,values.first,shap_p1);
-        m_parameter->m_env.SetNode(m_hot_node,new_node);
-        m_parameter->m_env.SortNodes();
+        double old_time=m_parameter->m_env.GetNodeAtIndex(m_hot_node).Time;
+        m_hit_index.update(m_parameter->m_env,m_view_range,m_parent->getWidth());
+        m_hot_node=m_parameter->m_env.move_node(m_hot_node,new_node);
+        m_hit_index.node_moved(m_parameter->m_env,old_time,new_node.Time);
         show_bubble(e.x,e.y,new_node);
         m_dirty=true;
     }
@@ -614,13 +763,110 @@ void envelope_editor::handle_move(const MouseEvent &e)
 
 int envelope_editor::get_hot_node(int x, int y)
 {
-    for (int i=0;i<m_parameter->m_env.GetNumNodes();++i)
+    m_hit_index.update(m_parameter->m_env,m_view_range,m_parent->getWidth());
+    return m_hit_index.find_node(m_parameter->m_env,x,y,m_parent->getHeight());
+}
+
+int envelope_editor::get_hot_segment(int x, int)
+{
+    m_hit_index.update(m_parameter->m_env,m_view_range,m_parent->getWidth());
+    return m_hit_index.find_segment(m_parameter->m_env,x);
+}
+
+double envelope_hit_index::x_of_time(double t) const
+{
+    return scale_value_from_range_to_range(t,m_view_range.first,m_view_range.second,0.0,(double)m_width);
+}
+
+int envelope_hit_index::column_of_time(double t) const
+{
+    double x=x_of_time(t);
+    if (x<0.0)
+        return 0;
+    if (x>=m_width)
+        return m_width+1;
+    return (int)x+1;
+}
+
+int envelope_hit_index::first_node_at_or_right_of(const breakpoint_envelope& env, double x) const
+{
+    const std::vector<double>& times=env.get_node_arrays().times();
+    auto it=std::lower_bound(times.begin(),times.end(),x,[this](double a, double b)
     {
-        const envelope_node& node=m_parameter->m_env.GetNodeAtIndex(i);
-        double xcor=scale_value_from_range_to_range(node.Time,
-                                                    m_view_range.first,m_view_range.second,
-                                                    0.0,(double)m_parent->getWidth());
-        double ycor=m_parent->getHeight()*(1.0-node.Value);
+        return x_of_time(a)<b;
+    });
+    return it-times.begin();
+}
+
+void envelope_hit_index::update(const breakpoint_envelope& env, std::pair<double,double> view_range, int width)
+{
+    if (m_env==&env && m_revision==env.get_revision() && m_view_range==view_range && m_width==width)
+        return;
+    m_env=&env;
+    m_revision=env.get_revision();
+    m_view_range=view_range;
+    m_width=std::max(width,0);
+    m_column_starts.resize(m_width+3);
+    m_column_starts[0]=0;
+    for (int k=1;k<m_width+2;++k)
+        m_column_starts[k]=first_node_at_or_right_of(env,k-1);
+    m_column_starts[m_width+2]=env.GetNumNodes();
+}
+
+void envelope_hit_index::shift_columns(int first_column, int last_column, int delta)
+{
+    for (int k=first_column;k<=last_column;++k)
+        m_column_starts[k]+=delta;
+}
+
+void envelope_hit_index::node_inserted(const breakpoint_envelope& env, double time)
+{
+    if (m_env!=&env)
+        return;
+    shift_columns(column_of_time(time)+1,m_width+2,1);
+    m_revision=env.get_revision();
+}
+
+void envelope_hit_index::node_removed(const breakpoint_envelope& env, double time)
+{
+    if (m_env!=&env)
+        return;
+    shift_columns(column_of_time(time)+1,m_width+2,-1);
+    m_revision=env.get_revision();
+}
+
+void envelope_hit_index::node_moved(const breakpoint_envelope& env, double old_time, double new_time)
+{
+    if (m_env!=&env)
+        return;
+    int old_column=column_of_time(old_time);
+    int new_column=column_of_time(new_time);
+    if (new_column>old_column)
+        shift_columns(old_column+1,new_column,-1);
+    if (new_column<old_column)
+        shift_columns(new_column+1,old_column,1);
+    m_revision=env.get_revision();
+}
+
+int envelope_hit_index::find_node(const breakpoint_envelope& env, int x, int y, int height) const
+{
+    // Node hit areas are 10 pixels wide, so look a bit beyond that on both sides.
+    // The columns outside the view may hold any number of nodes, so those are binary searched instead.
+    const int x0=x-6;
+    const int x1=x+6;
+    int first=0;
+    int last=0;
+    if (x0>=0 && x0<=m_width)
+        first=m_column_starts[x0+1];
+    else first=first_node_at_or_right_of(env,x0);
+    if (x1>=-1 && x1<m_width)
+        last=m_column_starts[x1+2];
+    else last=first_node_at_or_right_of(env,x1+1);
+    for (int i=first;i<last;++i)
+    {
+        const envelope_node& node=env.GetNodeAtIndex(i);
+        double xcor=x_of_time(node.Time);
+        double ycor=height*(1.0-node.Value);
         juce::Rectangle<int> test_rect(xcor-5,ycor-5,10,10);
         if (test_rect.contains(x,y)==true)
             return i;
@@ -628,24 +874,24 @@ int envelope_editor::get_hot_node(int x, int y)
     return -1;
 }
 
-int envelope_editor::get_hot_segment(int x, int y)
+int envelope_hit_index::find_segment(const breakpoint_envelope& env, int x) const
 {
-    for (int i=0;i<m_parameter->m_env.GetNumNodes()-1;++i)
-    {
-        const envelope_node& node1=m_parameter->m_env.GetNodeAtIndex(i);
-        const envelope_node& node2=m_parameter->m_env.GetNodeAtIndex(i+1);
-        double xcor1=scale_value_from_range_to_range(node1.Time,
-                                                    m_view_range.first,m_view_range.second,
-                                                    0.0,(double)m_parent->getWidth());
-        double xcor2=scale_value_from_range_to_range(node2.Time,
-                                                    m_view_range.first,m_view_range.second,
-                                                    0.0,(double)m_parent->getWidth());
-        if (x>=xcor1 && x<=xcor2)
-        {
-            return i;
-        }
-    }
-    return -1;
+    const int numnodes=env.GetNumNodes();
+    if (numnodes<2)
+        return -1;
+    int right_index=0;
+    if (x>=0 && x<=m_width)
+        right_index=m_column_starts[x+1];
+    else right_index=first_node_at_or_right_of(env,x);
+    if (right_index>=numnodes)
+        return -1;
+    if (right_index==0)
+    {
+        if (x_of_time(env.GetNodeAtIndex(0).Time)==x)
+            return 0;
+        return -1;
+    }
+    return right_index-1;
 }
 
 void zoom_scrollbar::mouseDown(const MouseEvent &e)
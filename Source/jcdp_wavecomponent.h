@@ -21,6 +21,7 @@ along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
 #include "JuceHeader.h"
 #include "jcdp_utilities.h"
 #include "jcdp_envelope.h"
+#include "jcdp_thumbnail.h"
 
 class zoom_scrollbar : public Component
 {
@@ -65,6 +66,34 @@ public:
     virtual bool is_state_dirty() const=0;
 };
 
+// Maps the pixel columns of the current view to ranges of envelope node indices,
+// so that hit testing only needs to look at the nodes near the mouse position.
+// Rebuilt lazily when the envelope revision, view range or width changes and
+// updated incrementally for the edits done by the envelope editor itself.
+class envelope_hit_index
+{
+public:
+    void invalidate() { m_env=nullptr; }
+    void update(const breakpoint_envelope& env, std::pair<double,double> view_range, int width);
+    void node_inserted(const breakpoint_envelope& env, double time);
+    void node_removed(const breakpoint_envelope& env, double time);
+    void node_moved(const breakpoint_envelope& env, double old_time, double new_time);
+    int find_node(const breakpoint_envelope& env, int x, int y, int height) const;
+    int find_segment(const breakpoint_envelope& env, int x) const;
+private:
+    double x_of_time(double t) const;
+    int column_of_time(double t) const;
+    int first_node_at_or_right_of(const breakpoint_envelope& env, double x) const;
+    void shift_columns(int first_column, int last_column, int delta);
+    const breakpoint_envelope* m_env=nullptr;
+    int m_revision=-1;
+    std::pair<double,double> m_view_range{0.0,1.0};
+    int m_width=0;
+    // m_column_starts[k] is the number of nodes left of pixel k-1,
+    // index 0 being for the nodes left of the view and m_width+1 for the nodes right of it
+    std::vector<int> m_column_starts;
+};
+
 class envelope_editor : public ISubComponent
 {
 public:
@@ -74,7 +103,7 @@ public:
     bool is_hot();
     parameter_info* get_envelope() const { return m_parameter; }
     bool is_state_dirty() const { return m_dirty; }
-    void set_envelope(parameter_info* env) { m_parameter=env; }
+    void set_envelope(parameter_info* env) { m_parameter=env; m_hit_index.invalidate(); }
     Colour m_envelope_colour;
     bool m_draw_handles=false;
     BubbleMessageComponent* m_bubble=nullptr;
@@ -91,6 +120,8 @@ private:
     int get_hot_segment(int x, int y);
     int m_hot_node=-1;
     int m_hot_segment=-1;
+    envelope_hit_index m_hit_index;
+    std::vector<float> m_paint_values;
     double m_segment_par1=0.0;
     bool m_dirty=false;
     std::pair<double, double> envelope_value_from_y_coord(int y,bool snap=false);
@@ -141,8 +172,7 @@ public:
     void focusLost(FocusChangeType);
     Colour m_waveformcolour;
     File* m_thumb_file;
-    FileInputSource* m_thumb_source;
-    AudioThumbnail* m_thumb=nullptr;
+    chunked_thumbnail* m_thumb=nullptr;
     void set_show_handle(bool b)
     {
         m_has_handle=b;
@@ -195,6 +225,12 @@ private:
     double m_view_start=0.0;
     double m_view_end=1.0;
 	StringArray m_parameter_names;
+    // Deep zoom drawing straight from the audio file, used when the thumbnail resolution isn't enough
+    bool draw_sample_view(Graphics& g, juce::Rectangle<int> rect, double t0, double t1);
+    bool read_sample_view(Range<int64> samples);
+    std::unique_ptr<MemoryMappedAudioFormatReader> m_mapped_reader;
+    AudioSampleBuffer m_sample_view_buffer;
+    Range<int64> m_sample_view_range;
 };
 
 
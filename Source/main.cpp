@@ -34,6 +34,9 @@ along with CDP front-end.  If not, see <http://www.gnu.org/licenses/>.
 #undef max
 
 #include "jcdp_utilities.h"
+#include "jcdp_item_tracker.h"
+#include "jcdp_processor_registry.h"
+#include "jcdp_plugin_scanner.h"
 
 int g_registered_command1=0;
 int g_registered_command2=0;
@@ -54,101 +57,14 @@ HINSTANCE g_hInst;
 HWND g_reaper_mainwnd;
 
 std::unique_ptr<AudioFormatManager> g_format_manager;
-std::unique_ptr<AudioThumbnailCache> g_thumb_cache;
+std::unique_ptr<ThreadPool> g_thumb_thread_pool;
+std::unique_ptr<thumbnail_cache> g_thumb_cache;
 std::unique_ptr<PropertiesFile> g_propsfile;
 File g_cdp_binaries_dir;
 File g_stand_alone_render_dir;
 
 bool g_is_running_as_plugin=false;
 
-CDP_processor_info init_texture_simple()
-{
-    /*
-    texture simple mode infile [infile2] outfile notedata outdur packing scatter tgrid
-    sndfirst sndlast mingain maxgain mindur maxdur minpich maxpich
-    [-aatten] [-pposition] [-sspread] [-rseed] [-w]
-    */
-    CDP_processor_info info("Texture Simple","texture","simple","5",false,true);
-    parameter_info notedataparam("Base pitch",60.0,1.0,127.0);
-    notedataparam.m_cmd_arg_formatter=[](parameter_info* parinfo)
-    {
-        String parname="basepitch";
-        String filename=get_audio_render_path()+"/"+c_file_prefix+parname+String(Time::currentTimeMillis())+".txt";
-        File txt_file(filename);
-        FileOutputStream* os=txt_file.createOutputStream();
-        if (os!=nullptr)
-        {
-            (*os) << String::formatted("%f\n",parinfo->m_current_value);
-            delete os;
-            return std::make_pair(filename,true);
-        }
-        return std::make_pair(String(),false);
-    };
-    info.m_parameters.push_back(notedataparam);
-    parameter_info outdurpar{"Out duration",5.0,1.0,60.0};
-    outdurpar.m_skewed=true;
-    outdurpar.m_skew=0.50;
-    info.m_parameters.push_back(outdurpar);
-    info.m_parameters.push_back({"Packing",0.2,0.025,1.0,true});
-    info.m_parameters.push_back({"Scatter",0.0,0.00,5.0,true});
-    info.m_parameters.push_back({"Time Grid",0.0,0.0,500.0,true});
-    info.m_parameters.push_back({"N/A",1.0,1.00,1.0});
-    info.m_parameters.push_back({"N/A",1.0,1.00,1.0});
-    info.m_parameters.push_back({"Min volume",64.0,1.00,127.0,true});
-    info.m_parameters.push_back({"Max volume",64.0,1.00,127.0,true});
-    info.m_parameters.push_back({"Min duration",0.1,0.02,5.0,true});
-    info.m_parameters.push_back({"Max duration",0.5,0.02,5.0,true});
-    info.m_parameters.push_back({"Min pitch",60,1.0,127.0,true});
-    info.m_parameters.push_back({"Max pitch",60,1.0,127.0,true});
-    for (auto& e : info.m_parameters)
-    {
-        if (e.m_can_automate==true)
-        {
-            e.m_envelope_time_scaling_func=[](CDP_processor_info* procinfo)
-            {
-                return procinfo->m_parameters[2].m_current_value;
-            };
-        }
-    }
-    return info;
-}
-
-void check_and_fix_environment()
-{
-#ifdef WIN32
-    char buf[1024];
-    auto result=GetEnvironmentVariableA("CDP_SOUND_EXT",buf,1024);
-    if (result==0)
-    {
-        Logger::writeToLog("CDP sound file extension environment variable not set");
-        SetEnvironmentVariableA("CDP_SOUND_EXT","wav");
-        result=GetEnvironmentVariableA("CDP_SOUND_EXT",buf,1024);
-        if (result!=0)
-        {
-            Logger::writeToLog("Set CDP_SOUND_EXT for the process!");
-        }
-    }
-    result=GetEnvironmentVariableA("CDP_NOCLIP_FLOATS",buf,1024);
-    if (result==0)
-    {
-        Logger::writeToLog("CDP_NOCLIP_FLOATS environment variable not set");
-        SetEnvironmentVariableA("CDP_NOCLIP_FLOATS","1");
-        result=GetEnvironmentVariableA("CDP_NOCLIP_FLOATS",buf,1024);
-        if (result!=0)
-        {
-            Logger::writeToLog("Set CDP_NOCLIP_FLOATS for the process!");
-        }
-    }
-#else
-    if (putenv(strdup("CDP_SOUND_EXT=wav"))!=0)
-        Logger::writeToLog("Could not set CDP_SOUND_EXT environment variable");
-    if (putenv(strdup("CDP_NOCLIP_FLOATS=1"))!=0)
-        Logger::writeToLog("Could not set CDP_NOCLIP_FLOATS environment variable");
-#endif
-}
-
-
-
 File get_cdp_binaries_location(PropertiesFile* propfile)
 {
 	const char* respath = GetResourcePath();
@@ -204,6 +120,7 @@ public:
     {
     }
 #ifdef CDP_VST_ENABLED
+	// Lists the plugins found by the previous scans right away, the scan itself runs in the background
 	void initPluginHosting()
 	{
 		File pardir = g_propsfile->getFile().getParentDirectory();
@@ -212,43 +129,98 @@ public:
 		{
 			juce::XmlDocument doc(plugscanfile);
 			XmlElement* elem = doc.getDocumentElement();
-			m_pluginlist.recreateFromXml(*elem);
+			if (elem != nullptr)
+				m_pluginlist.recreateFromXml(*elem);
 			delete elem;
 			if (m_pluginlist.getNumTypes() > 0)
 			{
 				Logger::writeToLog("previous plugin scan results loaded");
 			}
+			// Plugins that have been uninstalled since are not listed anymore
+			int num_removed = 0;
+			for (int i = m_pluginlist.getNumTypes() - 1; i >= 0; --i)
+			{
+				if (File(m_pluginlist.getType(i)->fileOrIdentifier).exists() == false)
+				{
+					m_pluginlist.removeType(i);
+					++num_removed;
+				}
+			}
+			if (num_removed > 0)
+			{
+				std::unique_ptr<XmlElement> xml(m_pluginlist.createXml());
+				xml->writeToFile(plugscanfile, "");
+			}
 		}
-		VSTPluginFormat vstformat;
-		
-		PluginDirectoryScanner plugdirscan(m_pluginlist, vstformat,
-			FileSearchPath("C:/Program Files/VST_Plugins_x64;C:/Program Files/VSTPlugins"), 
-			true, File::nonexistent);
-		String foo;
-		while (plugdirscan.scanNextFile(true, foo) == true)
-		{
-			//Logger::writeToLog(foo);
-		}
-		int count = 0;
 		for (auto& plug : m_pluginlist)
+			m_proc_infos.push_back(make_plugin_processor(*plug));
+	}
+	CDP_processor_info make_plugin_processor(const PluginDescription& desc)
+	{
+		CDP_processor_info info("VST/"+desc.name, "vstplugin", "", "", false, false);
+		info.m_pluginname = desc.name;
+		info.m_plugin_identifier = desc.createIdentifierString();
+		return info;
+	}
+	void start_plugin_scan()
+	{
+		File pardir = g_propsfile->getFile().getParentDirectory();
+		FileSearchPath searchpath(g_propsfile->getValue("vst_search_paths",
+			"C:/Program Files/VST_Plugins_x64;C:/Program Files/VSTPlugins"));
+#ifdef WIN32
+		File helper = g_cdp_binaries_dir.getSiblingFile("jcdp_cli.exe");
+#else
+		File helper = g_cdp_binaries_dir.getSiblingFile("jcdp_cli");
+#endif
+		if (g_propsfile->containsKey("plugin_scan_helper") == true)
+			helper = File(g_propsfile->getValue("plugin_scan_helper"));
+		m_plugin_scanner = jcdp::make_unique<background_plugin_scanner>(pardir.getChildFile("pluginscanstate.xml"),
+			searchpath, helper);
+		Component::SafePointer<cdp_main_dialog> safe_dlg(m_dlg.get());
+		m_plugin_scanner->OnPluginsFound = [this, safe_dlg](const std::vector<PluginDescription>& found)
 		{
-			CDP_processor_info info("VST/"+plug->name, "vstplugin", "", "", false, false);
-			info.m_pluginname = plug->name;
-			info.m_plugin_id = count;
-			m_proc_infos.push_back(info);
-			++count;
-		}
-		
-		XmlElement* xml = m_pluginlist.createXml();
-		xml->writeToFile(plugscanfile,"");
-		delete xml;
+			MessageManager::callAsync([this, safe_dlg, found]()
+			{
+				if (safe_dlg == nullptr)
+					return;
+				std::vector<CDP_processor_info> procs;
+				for (auto& desc : found)
+				{
+					// Updated plugins are already listed
+					bool is_new = m_pluginlist.getTypeForIdentifierString(desc.createIdentifierString()) == nullptr;
+					m_pluginlist.addType(desc);
+					if (is_new == true)
+						procs.push_back(make_plugin_processor(desc));
+				}
+				safe_dlg->add_processors(std::move(procs));
+			});
+		};
+		m_plugin_scanner->OnFinished = [this, safe_dlg](int num_scanned)
+		{
+			if (num_scanned == 0)
+				return;
+			// Runs after the plugins found have been added to the list, which is saved before the
+			// scan state so that the state never claims files whose plugins were not saved
+			MessageManager::callAsync([this, safe_dlg]()
+			{
+				if (safe_dlg == nullptr || m_plugin_scanner == nullptr)
+					return;
+				File plugscanfile = g_propsfile->getFile().getParentDirectory().getChildFile("plugininfos.xml");
+				std::unique_ptr<XmlElement> xml(m_pluginlist.createXml());
+				if (xml->writeToFile(plugscanfile, "") == true)
+					m_plugin_scanner->save_state();
+			});
+		};
+		m_plugin_scanner->startThread(Thread::lowPriority);
 	}
 #endif
     void initialise(const String&)
     {
+        double t0=Time::getMillisecondCounterHiRes();
         g_format_manager=jcdp::make_unique<AudioFormatManager>();
         g_format_manager->registerBasicFormats();
-        g_thumb_cache=jcdp::make_unique<AudioThumbnailCache>(32);
+        g_thumb_thread_pool=jcdp::make_unique<ThreadPool>(SystemStats::getNumCpus());
+        g_thumb_cache=jcdp::make_unique<thumbnail_cache>(32);
         if (g_is_running_as_plugin==false)
             m_audio_delegate=jcdp::make_unique<juce_audio_preview>(g_format_manager.get());
         else
@@ -274,165 +246,8 @@ public:
 #ifdef CDP_VST_ENABLED
 		initPluginHosting();
 #endif
-		CDP_processor_info info=CDP_processor_info("Modify Brassage Brassage","modify","brassage","6",false,true);
-        info.m_parameters.push_back({"Velocity",0.5,0.01,2.0,true,"",true,0.75,0.01});
-        info.m_parameters.push_back({"Density",2.0,0.1,10.0,true});
-        info.m_parameters.push_back({"Grain size",50.0,2.0,500.0,true});
-        info.m_parameters.push_back({"Pitch shift",-6.0,-24.0,24.0,true});
-        info.m_parameters.push_back({"Amplitude",0.75,0.01,1.0,true});
-        info.m_parameters.push_back({"Space",0.5,0.0,1.0,true});
-        info.m_parameters.push_back({"Fade in",5.0,1.00,20.0,true});
-        info.m_parameters.push_back({"Fade out",5.0,1.00,20.0,true});
-        m_proc_infos.push_back(info);
-        
-		// modify brassage 7 infile outfile velocity density hvelocity hdensity
-//grainsize   pitchshift   amp  space   bsplice   esplice
-//hgrainsize hpitchshift hamp hspace hbsplice hesplice
-		
-		info = CDP_processor_info("Modify Brassage Full Monty", "modify", "brassage", "7", false, true);
-		info.m_parameters.push_back({ "Velocity low",0.5,0.01,2.0,true,"",true,0.75,0.01 });
-		info.m_parameters.push_back({ "Density low",2.0,0.1,10.0,true });
-		info.m_parameters.push_back({ "Velocity high",0.55,0.01,2.0,true,"",true,0.75,0.01 });
-		info.m_parameters.push_back({ "Density high",2.0,0.1,10.0,true });
-		info.m_parameters.push_back({ "Grain size low",50.0,2.0,500.0,true });
-		info.m_parameters.push_back({ "Pitch shift low",-6.0,-24.0,24.0,true });
-		info.m_parameters.push_back({ "Amplitude low",0.75,0.01,1.0,true });
-		info.m_parameters.push_back({ "Space low",0.1,0.0,1.0,true });
-		info.m_parameters.push_back({ "Fade in low",5.0,1.00,20.0,true });
-		info.m_parameters.push_back({ "Fade out low",5.0,1.00,20.0,true });
-		info.m_parameters.push_back({ "Grain size high",5.0,1.00,20.0,true });
-		info.m_parameters.push_back({ "Pitch shift high",-2.0,-24.0,24.0,true });
-		info.m_parameters.push_back({ "Amplitude high",0.75,0.01,1.0,true });
-		info.m_parameters.push_back({ "Space high",0.9,0.0,1.0,true });
-		info.m_parameters.push_back({ "Fade in high",5.0,1.00,20.0,true });
-		info.m_parameters.push_back({ "Fade out high",5.0,1.00,20.0,true });
-		m_proc_infos.push_back(info);
-
-
-        info=CDP_processor_info("Modify Radical Shred","modify","radical","2",false,false);
-        info.m_parameters.push_back({"Iterations",1.0,1.0,32.0});
-        info.m_parameters.push_back({"Chunk length",0.1,0.05,2.0});
-        m_proc_infos.push_back(info);
-
-        info=CDP_processor_info("Modify Speed","modify","speed","2",false,true);
-        info.m_parameters.push_back({"Semitones",0.0,-24.0,24.0,true});
-        m_proc_infos.push_back(info);
-
-        info=CDP_processor_info("Modify Stack","modify","stack","",false,true);
-        info.m_parameters.push_back({"Transpose",-12.0,-12.0,12.0});
-        info.m_parameters.push_back({"Num layers",2.0,2.0,8.0});
-        info.m_parameters.push_back({"Lean",1.0,0.1,2.0});
-        parameter_info attackparinfo("Attack offset",0.0,0.0,1.0);
-        attackparinfo.m_notifs=parameter_info::waveformmarker;
-        info.m_parameters.push_back(attackparinfo);
-        info.m_parameters.push_back({"Gain",1.0,0.1,2.0});
-        info.m_parameters.push_back({"Duration",1.0,0.01,1.0});
-        m_proc_infos.push_back(info);
-
-        info=CDP_processor_info("Distort Repeat","distort","repeat","",false,true,true);
-        info.m_parameters.push_back({"Multiplier",2.0,2.0,16.0,true});
-        info.m_parameters.push_back({"Cycle cnt",1.0,1.0,8.0,true,"-c"});
-        m_proc_infos.push_back(info);
-
-        // grain timewarp infile outfile timestretch_ratio [-blen] [-lgate] [-hminhole] [-twinsize] [-x]
-
-        info=CDP_processor_info("Grain Timewarp","grain","timewarp","",false,true,true);
-        info.m_parameters.push_back({"Ratio",0.5,0.1,2.0,true});
-        m_proc_infos.push_back(info);
-
-        info=CDP_processor_info("Distort Pitch","distort","pitch","",false,true,true);
-        info.m_parameters.push_back({"Pitch amount",0.2,0.01,8.0,true});
-        info.m_parameters.push_back({"Cycle cnt",32.0,2.0,128.0,true,"-c"});
-        m_proc_infos.push_back(info);
-
-        info=CDP_processor_info("Distort Interpolate","distort","interpolate","",false,true,true);
-        info.m_parameters.push_back({"Multiplier",4.0,2.00,64.0,true});
-        m_proc_infos.push_back(info);
-
-        info=CDP_processor_info("Envel Warp Exaggerate","envel","warp","3",false,false);
-        info.m_parameters.push_back({"Window size",20.0,5.0,100.0});
-        info.m_parameters.push_back({"Amount",0.75,0.05,4.0,true,"",true,0.5,0.01});
-        m_proc_infos.push_back(info);
-
-        info=CDP_processor_info("Blur Blur","blur","blur","",true,false);
-        info.m_parameters.push_back({"Blur amount",50.0,1.0,1000.0,true,"",true,0.3});
-        m_proc_infos.push_back(info);
-
-        info=CDP_processor_info("Blur Noise","blur","noise","",true,false);
-        info.m_parameters.push_back({"Noise amount",0.2,0.0,1.0,true});
-        m_proc_infos.push_back(info);
-
-        // blur suppress infile outfile N
-
-        info=CDP_processor_info("Blur Suppress","blur","suppress","",true,false);
-        info.m_parameters.push_back({"Amount",4.0,1.0,16.0,true});
-        m_proc_infos.push_back(info);
-
-        info=CDP_processor_info("Stretch Time","stretch","time","1",true,true);
-        info.m_parameters.push_back({"Time factor",2.0,1.0,64.0,true,"",true,0.25,0.01});
-        m_proc_infos.push_back(info);
-
-        info=CDP_processor_info("Stretch Spectrum","stretch","spectrum","1",true,false);
-        info.m_parameters.push_back({"Freq divide",64.0,64,10000.0,false,"",true,0.25,10.0});
-        info.m_parameters.push_back({"Max stretch",2.0,0.1,2.0,false,"",false,1.0,0.01});
-        info.m_parameters.push_back({"Exponent",0.5,0.1,2.0,false,"",false,1.0,0.01});
-        info.m_parameters.push_back({"Depth",1.0,0.0,1.0,true,"-d",false,1.0,0.01});
-        m_proc_infos.push_back(info);
-
-        info=CDP_processor_info("Focus Step","focus","step","",true,false);
-        info.m_parameters.push_back({"Step duration",0.5,0.1,1.0});
-        m_proc_infos.push_back(info);
-
-        info=CDP_processor_info("Repitch Transpose","repitch","transpose","3",true,false);
-        info.m_parameters.push_back({"Semitones",0.0,-24.0,24.0,true});
-        m_proc_infos.push_back(info);
-
-        info=CDP_processor_info("Focus Accu","focus","accu","",true,false);
-        info.m_parameters.push_back({"Decay",0.5,0.01,1.0,false,"-d"});
-        info.m_parameters.push_back({"Gliss",-0.05,-11.7,11.7,false,"-g"});
-        m_proc_infos.push_back(info);
-
-        info=CDP_processor_info("Strange Waver","strange","waver","2",true,false);
-        info.m_parameters.push_back({"Rate",1.0,0.1,32.0});
-        info.m_parameters.push_back({"Stretch",100.0,-1.0,2205.0});
-        info.m_parameters.push_back({"Bottom freq",100.0,20.0,4096.0});
-        info.m_parameters.push_back({"Shape",1.0,0.1,2.0});
-        m_proc_infos.push_back(info);
-
-        m_proc_infos.push_back(init_texture_simple());
-        /*
-        // Seems to be a processor that is very finicky about the parameter values,
-        // probably not worth adding here as the logic for the correct parameter values
-        // would need to be reimplemented. Or perhaps extend scramble 2 is just very buggy...
-        // extend scramble 2 infile outfile seglen scatter outdur [-wsplen] [-sseed] [-b] [-e]
-        info=CDP_processor_info("Extend Scramble","extend","scramble","2",false,true);
-        info.m_parameters.push_back({"Segment length",0.5,0.01,2.0});
-        info.m_parameters.push_back({"Scatter",0.1,0.0,2.0});
-        info.m_parameters.push_back({"Output length",5.0,0.5,15.0});
-        m_proc_infos.push_back(info);
-        */
-
-        /*
-        // gate.exe seems to crash right away when launched, so I guess there isn't much to do in the front end
-        // about that.
-        // gate gate mode infile outfile gatelevel
-        info=CDP_processor_info("Gate 2","gate","gate","2",false,true);
-        info.m_parameters.push_back({"Threshold",-20.0,-96.0,0.0});
-        m_proc_infos.push_back(info);
-        */
-
-        //envnu peakchop 1 insndfile outsndfile wsize pkwidth risetime tempo gain
-
-        info=CDP_processor_info("Envnu Peakchop","envnu","peakchop","1",false,true);
-        info.m_parameters.push_back({"Window size",50.0,1.0,64.0});
-        info.m_parameters.push_back({"Peak Width",20.0,0.0,1000.0});
-        info.m_parameters.push_back({"Rise Time",10.0,0.0,100.0});
-        info.m_parameters.push_back({"Tempo",90.0,20.0,3000.0,true,"",true,0.3});
-        info.m_parameters.push_back({"Gain",1.0,0.0,1.0,true});
-
-
-        m_proc_infos.push_back(info);
-
+        auto cdp_procs=make_cdp_processors();
+        m_proc_infos.insert(m_proc_infos.end(),cdp_procs.begin(),cdp_procs.end());
         std::sort(m_proc_infos.begin(),m_proc_infos.end(),
                   [](const CDP_processor_info& lhs, const CDP_processor_info &rhs)
         {
@@ -440,6 +255,9 @@ public:
         });
 
         m_dlg=jcdp::make_unique<cdp_main_dialog>(m_audio_delegate.get(),&m_proc_infos,&m_pluginlist);
+#ifdef CDP_VST_ENABLED
+        start_plugin_scan();
+#endif
         if (g_is_running_as_plugin==true)
         {
 #ifdef WIN32
@@ -457,7 +275,8 @@ public:
             DockWindowActivate(hwnd);
             g_old_window_proc=(WNDPROC)SetWindowLongPtr(hwnd,GWL_WNDPROC,(LONG_PTR)my_window_proc);
 #endif
-            startTimer(500);
+            // Polling is cheap unless something changed, see reaper_item_tracker
+            startTimer(100);
         }
         m_dlg->setBounds(10,60,800,600);
         String rstr=g_propsfile->getValue("windowrect");
@@ -472,9 +291,13 @@ public:
 			m_dlg->setVisible(true);
 			m_dlg->toFront(true);
 		}
+        Logger::writeToLog("CDP front-end initialised in "+String(Time::getMillisecondCounterHiRes()-t0,1)+" ms");
     }
     void shutdown()
     {
+#ifdef CDP_VST_ENABLED
+        m_plugin_scanner=nullptr;
+#endif
         //if (g_is_running_as_plugin==false)
             g_propsfile->setValue("windowrect",m_dlg->getBounds().toString());
         g_format_manager.reset();
@@ -498,44 +321,44 @@ public:
     void poll_reaper_items()
     {
 #ifdef BUILD_CDP_FRONTEND_PLUGIN
-		if (m_dlg->isVisible()==true)
+		if (m_dlg->isVisible()==false)
+        {
+            // Everything is looked at again once the window is shown
+            m_item_tracker.invalidate();
+            return;
+        }
+        if (m_item_tracker.update()==false)
+            return;
+        for (const reaper_item_fingerprint& fp : m_item_tracker.get_changed_items())
         {
-            int num_items=CountSelectedMediaItems(0);
-            for (int i=0;i<num_items;++i)
+            PCM_source* source=fp.m_source;
+            if (source)
             {
-                MediaItem* item=GetSelectedMediaItem(0,i);
-                MediaItem_Take* take=GetActiveTake(item);
-                PCM_source* source=(PCM_source*)GetSetMediaItemTakeInfo(take,"P_SOURCE",nullptr);
-                if (source)
+                String source_fn(source->GetFileName());
+                if (has_supported_media_type(source)==true)
                 {
-                    String source_fn(source->GetFileName());
-                    if (has_supported_media_type(source)==true)
-                    {
-                        m_dlg->setEnabled(true);
-                        m_dlg->update_status_label();
-                        double source_len=source->GetLength();
-                        double take_startoffset=*(double*)GetSetMediaItemTakeInfo(take,"D_STARTOFFS",nullptr);
-                        double item_length=*(double*)GetSetMediaItemInfo(item,"D_LENGTH",nullptr);
-                        double take_end_offset=take_startoffset+item_length;
-                        time_range trange(0.0,item_length);
-                        if (fuzzy_is_zero(take_startoffset) && fuzzy_compare(item_length,source_len))
-                            trange=time_range();
-
-                        if (source_fn!=m_dlg->m_in_fn
-                                || (m_dlg->m_custom_time_set==false && m_dlg->get_input_time_range()!=trange))
+                    m_dlg->setEnabled(true);
+                    m_dlg->update_status_label();
+                    double source_len=source->GetLength();
+                    double item_length=fp.m_item_length;
+                    time_range trange(0.0,item_length);
+                    if (fuzzy_is_zero(fp.m_take_start_offset) && fuzzy_compare(item_length,source_len))
+                        trange=time_range();
+
+                    if (source_fn!=m_dlg->m_in_fn
+                            || (m_dlg->m_custom_time_set==false && m_dlg->get_input_time_range()!=trange))
 
+                    {
+                        if (m_dlg->m_follow_item_selection==true)
                         {
-                            if (m_dlg->m_follow_item_selection==true)
-                            {
-                                m_dlg->set_reaper_take(take);
-                            }
+                            m_dlg->set_reaper_take(fp.m_take);
                         }
-                    } else
-                    {
-                        m_dlg->setEnabled(false);
-                        m_dlg->m_status_label->setText("UNSUPPORTED MEDIA TYPE",dontSendNotification);
-                        //m_dlg->setName(source_fn+" (unsupported media type)");
                     }
+                } else
+                {
+                    m_dlg->setEnabled(false);
+                    m_dlg->m_status_label->setText("UNSUPPORTED MEDIA TYPE",dontSendNotification);
+                    //m_dlg->setName(source_fn+" (unsupported media type)");
                 }
             }
         }
@@ -577,6 +400,11 @@ public:
     std::vector<CDP_processor_info> m_proc_infos;
 	KnownPluginList m_pluginlist;
     std::unique_ptr<cdp_main_dialog> m_dlg;
+    reaper_item_tracker m_item_tracker;
+#ifdef CDP_VST_ENABLED
+    // Last, so that the scan has stopped before the plugin list and the dialog are destroyed
+    std::unique_ptr<background_plugin_scanner> m_plugin_scanner;
+#endif
 };
 
 std::unique_ptr<CDP_holder> g_holder;
@@ -776,6 +604,8 @@ REAPER_PLUGIN_DLL_EXPORT int REAPER_PLUGIN_ENTRYPOINT(REAPER_PLUGIN_HINSTANCE hI
     {
         g_holder->shutdown();
         g_holder.reset();
+        cdp_render_engine::wait_for_retired_engines();
+        g_thumb_thread_pool.reset();
         g_thumb_cache.reset();
         shutdownJuce_GUI();
         delete g_kbdhook;
@@ -794,6 +624,8 @@ int main(int argc, char** argv)
 	check_and_fix_environment();
     juce::JUCEApplicationBase::createInstance = &juce_CreateApplication;
     int rc=juce::JUCEApplicationBase::main();
+    cdp_render_engine::wait_for_retired_engines();
+    g_thumb_thread_pool.reset();
     g_thumb_cache.reset();
     return rc;
 }